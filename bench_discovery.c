@@ -0,0 +1,234 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <enet/enet.h>
+#include <enet/time.h>
+#include "common.h"
+
+
+// Discovery flood benchmark
+// Measures how long a chat line takes to come back from a server on this
+// machine, first with no other traffic and then while scans flood the
+// server's listen port. Start the server first, with its output discarded
+// since it logs every scan:
+//   ./server > /dev/null &
+//   ./bench_discovery [scans per second [seconds per phase]]
+#define MAX_SAMPLES 100000
+// How often a chat line is sent, in milliseconds
+#define CHAT_INTERVAL 10
+
+typedef struct
+{
+	enet_uint32 latencies[MAX_SAMPLES];
+	int count;
+	int scansSent;
+	int scansAnswered;
+} Phase;
+bool find_server(ENetSocket scanner, ENetAddress *addr);
+void run_phase(
+	ENetHost *client, ENetPeer *peer, ENetSocket flooder, const ENetAddress *listenaddr,
+	int scanRate, enet_uint32 duration, Phase *phase);
+int compare_latencies(const void *a, const void *b);
+void print_phase(const char *name, Phase *phase, enet_uint32 duration);
+
+
+int main(int argc, char *argv[])
+{
+	const int scanRate = argc > 1 ? atoi(argv[1]) : 20000;
+	const enet_uint32 duration = (enet_uint32)(argc > 2 ? atof(argv[2]) * 1000 : 5000);
+	if (scanRate < 0)
+	{
+		fprintf(stderr, "usage: %s [scans per second [seconds per phase]]\n", argv[0]);
+		return 1;
+	}
+	if (enet_initialize() != 0)
+	{
+		fprintf(stderr, "An error occurred while initializing ENet\n");
+		return 1;
+	}
+	atexit(enet_deinitialize);
+
+	ENetSocket flooder = enet_socket_create(ENET_SOCKET_TYPE_DATAGRAM);
+	if (flooder == ENET_SOCKET_NULL ||
+		enet_socket_set_option(flooder, ENET_SOCKOPT_NONBLOCK, 1) != 0)
+	{
+		fprintf(stderr, "Failed to create socket\n");
+		return 1;
+	}
+	ENetAddress listenaddr;
+	enet_address_set_host(&listenaddr, "127.0.0.1");
+	listenaddr.port = LISTEN_PORT;
+	ENetAddress addr = listenaddr;
+	if (!find_server(flooder, &addr))
+	{
+		fprintf(stderr, "No server answered on port %d\n", LISTEN_PORT);
+		return 1;
+	}
+
+	ENetHost *client = enet_host_create(NULL, 1, 2, 0, 0);
+	if (client == NULL)
+	{
+		fprintf(stderr, "Failed to open ENet client\n");
+		return 1;
+	}
+	ENetPeer *peer = enet_host_connect(client, &addr, 2, 0);
+	ENetEvent event;
+	if (peer == NULL || enet_host_service(client, &event, 5000) <= 0 ||
+		event.type != ENET_EVENT_TYPE_CONNECT)
+	{
+		fprintf(stderr, "Failed to connect to server on port %d\n", addr.port);
+		return 1;
+	}
+
+	static Phase quiet, flood;
+	run_phase(client, peer, flooder, &listenaddr, 0, duration, &quiet);
+	run_phase(client, peer, flooder, &listenaddr, scanRate, duration, &flood);
+	print_phase("quiet", &quiet, duration);
+	print_phase("flood", &flood, duration);
+
+	enet_peer_disconnect_now(peer, 0);
+	enet_host_destroy(client);
+	enet_socket_destroy(flooder);
+	return 0;
+}
+
+// Scan the listen port once and take the chat port from the reply
+bool find_server(ENetSocket scanner, ENetAddress *addr)
+{
+	char data = 42;
+	ENetBuffer sendbuf;
+	sendbuf.data = &data;
+	sendbuf.dataLength = 1;
+	if (enet_socket_send(scanner, addr, &sendbuf, 1) != 1)
+	{
+		return false;
+	}
+	enet_uint32 condition = ENET_SOCKET_WAIT_RECEIVE;
+	if (enet_socket_wait(scanner, &condition, 1000) != 0 ||
+		!(condition & ENET_SOCKET_WAIT_RECEIVE))
+	{
+		return false;
+	}
+	enet_uint8 reply[ENET_PROTOCOL_MAXIMUM_MTU];
+	ENetBuffer recvbuf;
+	recvbuf.data = reply;
+	recvbuf.dataLength = sizeof reply;
+	ServerInfo info;
+	const int recvlen = enet_socket_receive(scanner, addr, &recvbuf, 1);
+	if (recvlen <= 0 || !server_info_read(&info, reply, (size_t)recvlen))
+	{
+		return false;
+	}
+	addr->port = info.port;
+	return true;
+}
+
+// Send a chat line every CHAT_INTERVAL and time how long each takes to come
+// back, while sending scanRate scans a second and draining their replies
+void run_phase(
+	ENetHost *client, ENetPeer *peer, ENetSocket flooder, const ENetAddress *listenaddr,
+	int scanRate, enet_uint32 duration, Phase *phase)
+{
+	enet_uint32 sendTimes[MAX_SAMPLES];
+	int sent = 0;
+	char data = 42;
+	ENetBuffer scanbuf;
+	scanbuf.data = &data;
+	scanbuf.dataLength = 1;
+	enet_uint8 reply[ENET_PROTOCOL_MAXIMUM_MTU];
+	ENetBuffer replybuf;
+	replybuf.data = reply;
+	replybuf.dataLength = sizeof reply;
+
+	const enet_uint32 start = enet_time_get();
+	for (;;)
+	{
+		const enet_uint32 elapsed = enet_time_get() - start;
+		if (elapsed >= duration)
+		{
+			break;
+		}
+
+		// Keep to the scan rate, sending what is due in one go
+		const int scansDue = (int)((double)scanRate * elapsed / 1000);
+		while (phase->scansSent < scansDue &&
+			enet_socket_send(flooder, listenaddr, &scanbuf, 1) == 1)
+		{
+			phase->scansSent++;
+		}
+		ENetAddress from;
+		while (enet_socket_receive(flooder, &from, &replybuf, 1) > 0)
+		{
+			phase->scansAnswered++;
+		}
+
+		if (sent < MAX_SAMPLES && elapsed >= (enet_uint32)sent * CHAT_INTERVAL)
+		{
+			char line[32];
+			snprintf(line, sizeof line, "bench %d", sent);
+			ENetPacket *packet = enet_packet_create(
+				line, strlen(line) + 1, ENET_PACKET_FLAG_RELIABLE);
+			if (packet != NULL && enet_peer_send(peer, 0, packet) == 0)
+			{
+				sendTimes[sent++] = enet_time_get_microseconds();
+			}
+			else if (packet != NULL)
+			{
+				enet_packet_destroy(packet);
+			}
+		}
+
+		// Lines may arrive together, each null-terminated
+		ENetEvent event;
+		while (enet_host_service(client, &event, scanRate > 0 ? 0 : 1) > 0)
+		{
+			if (event.type != ENET_EVENT_TYPE_RECEIVE)
+			{
+				continue;
+			}
+			const enet_uint32 now = enet_time_get_microseconds();
+			const char *s = (const char *)event.packet->data;
+			const char *end = s + event.packet->dataLength;
+			while (s < end)
+			{
+				const char *found = strstr(s, "says: bench ");
+				int index;
+				if (found != NULL &&
+					sscanf(found, "says: bench %d", &index) == 1 &&
+					index >= 0 && index < sent && phase->count < MAX_SAMPLES)
+				{
+					phase->latencies[phase->count++] = now - sendTimes[index];
+				}
+				s += strlen(s) + 1;
+			}
+			enet_packet_destroy(event.packet);
+		}
+	}
+}
+
+int compare_latencies(const void *a, const void *b)
+{
+	const enet_uint32 x = *(const enet_uint32 *)a;
+	const enet_uint32 y = *(const enet_uint32 *)b;
+	return x < y ? -1 : x > y;
+}
+
+void print_phase(const char *name, Phase *phase, enet_uint32 duration)
+{
+	if (phase->count == 0)
+	{
+		printf("%s: no chat lines came back\n", name);
+		return;
+	}
+	qsort(phase->latencies, phase->count, sizeof phase->latencies[0], compare_latencies);
+	printf("%s: %.0f scans/s sent, %.0f answered/s; chat round trip median %u us, "
+		"99th percentile %u us, max %u us over %d lines\n",
+		name,
+		phase->scansSent * 1000.0 / duration,
+		phase->scansAnswered * 1000.0 / duration,
+		phase->latencies[phase->count / 2],
+		phase->latencies[phase->count * 99 / 100],
+		phase->latencies[phase->count - 1],
+		phase->count);
+}
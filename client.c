@@ -1,7 +1,9 @@
 #include <stdbool.h>
 #include <stdio.h>
+#include <string.h>
 
 #include <enet/enet.h>
+#include <enet/time.h>
 #include "common.h"
 #include "rlutil.h"
 
@@ -10,22 +12,48 @@
 // The client sends string messages to the server, and the server passes
 // them on to all clients
 
-ENetHost *start_client(ENetPeer **peer, const int timeout_seconds);
+// How a scan for servers is sent and decides it has heard enough
+typedef struct
+{
+	// Send the probe to the discovery group instead of broadcasting it,
+	// so only hosts running a server receive it
+	bool multicast;
+	// Give up after this long even if servers are still replying
+	enet_uint32 timeoutMs;
+	// Stop as soon as this many servers have replied; 0 waits for all
+	int maxReplies;
+	// Stop once no new server has replied for this long
+	enet_uint32 quietMs;
+	// Resend the probe after this long in case it was lost,
+	// doubling the wait each time
+	enet_uint32 resendMs;
+} ScanPolicy;
+ENetHost *start_client(ENetPeer **peer, const ScanPolicy *policy);
 void send_string(ENetPeer *peer, char *s);
+void print_lines(const ENetPacket *packet);
 void stop_client(ENetHost *host, ENetPeer *peer);
 #define CONNECTION_WAIT_MS 5000
 // Arbitrary max number of servers to scan for
 #define MAX_SERVERS 10
+// Servers on a healthy LAN reply within a few milliseconds, so a short
+// quiet period is enough to know everyone has answered
+static const ScanPolicy default_scan = { false, 5000, 0, 50, 100 };
 
 
 int main(int argc, char *argv[])
 {
 	// TODO: optionally connect directly to IP
-	(void)argc;
-	(void)argv;
+	ScanPolicy scan = default_scan;
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "-m") == 0 || strcmp(argv[i], "--multicast") == 0)
+		{
+			scan.multicast = true;
+		}
+	}
 	// Start client
 	ENetPeer *peer;
-	ENetHost *host = start_client(&peer, 5);
+	ENetHost *host = start_client(&peer, &scan);
 	if (host == NULL)
 	{
 		return 1;
@@ -39,7 +67,7 @@ int main(int argc, char *argv[])
 	int check;
 	do
 	{
-		Sleep(1);
+		msleep(1);
 		const int k = nb_getch();
 		if (k == KEY_ENTER || k == '\r')
 		{
@@ -72,7 +100,8 @@ int main(int argc, char *argv[])
 			switch (event.type)
 			{
 			case ENET_EVENT_TYPE_RECEIVE:
-				printf("%s\n", event.packet->data);
+				print_lines(event.packet);
+				enet_packet_destroy(event.packet);
 				break;
 			case ENET_EVENT_TYPE_DISCONNECT:
 				printf("Lost connection with server\n");
@@ -94,9 +123,9 @@ int main(int argc, char *argv[])
 	return 0;
 }
 
-int find_servers(ServerInfo *server_infos, ENetAddress *addrs, int max_servers, int timeout_seconds);
+int find_servers(ServerInfo *server_infos, ENetAddress *addrs, int max_servers, const ScanPolicy *policy);
 
-ENetHost *start_client(ENetPeer **peer, const int timeout_seconds)
+ENetHost *start_client(ENetPeer **peer, const ScanPolicy *policy)
 {
 	if (enet_initialize() != 0)
 	{
@@ -107,28 +136,38 @@ ENetHost *start_client(ENetPeer **peer, const int timeout_seconds)
 	// Scan for servers on LAN
 	ServerInfo sinfos[MAX_SERVERS];
 	ENetAddress addrs[MAX_SERVERS];
-	int n_servers = find_servers(sinfos, addrs, MAX_SERVERS, timeout_seconds);
+	int n_servers = find_servers(sinfos, addrs, MAX_SERVERS, policy);
 	if (n_servers == 0)
 	{
 		fprintf(stderr, "No servers found\n");
 		return NULL;
 	}
 
-	// If there's more than one server, present a menu and let the user pick
+	// Suggest the least loaded server
 	int server_index = 0;
+	for (int i = 1; i < n_servers; i++)
+	{
+		if (sinfos[i].load < sinfos[server_index].load)
+		{
+			server_index = i;
+		}
+	}
+
+	// If there's more than one server, present a menu and let the user pick
 	if (n_servers > 1)
 	{
 		for (int i = 0; i < n_servers; i++)
 		{
 			char buf[256];
 			enet_address_get_host_ip(&addrs[i], buf, sizeof buf);
-			printf("%d - %s (%s:%d)\n", i, sinfos[i].hostname, buf, addrs[i].port);
+			printf("%d - %s (%s:%d) load %d%%\n",
+				i, sinfos[i].hostname, buf, addrs[i].port, sinfos[i].load);
 		}
-		printf("Connect to server? [0] ");
+		printf("Connect to server? [%d] ", server_index);
 		for (;;)
 		{
 			char input[256];
-			if (fgets(input, sizeof input, stdin) == NULL)
+			if (fgets(input, sizeof input, stdin) == NULL || input[0] == '\n')
 			{
 				break;
 			}
@@ -173,7 +212,7 @@ ENetHost *start_client(ENetPeer **peer, const int timeout_seconds)
 
 // Scan for servers on LAN using UDP broadcast
 // Return how many servers we found
-int find_servers(ServerInfo *server_infos, ENetAddress *addrs, int max_servers, int timeout_seconds)
+int find_servers(ServerInfo *server_infos, ENetAddress *addrs, int max_servers, const ScanPolicy *policy)
 {
 	ENetSocket scanner = enet_socket_create(ENET_SOCKET_TYPE_DATAGRAM);
 	if (scanner == ENET_SOCKET_NULL)
@@ -181,61 +220,125 @@ int find_servers(ServerInfo *server_infos, ENetAddress *addrs, int max_servers,
 		fprintf(stderr, "Failed to create socket\n");
 		return 0;
 	}
-	if (enet_socket_set_option(scanner, ENET_SOCKOPT_BROADCAST, 1) != 0)
+	ENetAddress scanaddr;
+	if (policy->multicast)
 	{
-		fprintf(stderr, "Failed to enable broadcast socket\n");
-		return 0;
+		// Looping the probe back lets a server on this machine hear it too
+		if (enet_address_set_host(&scanaddr, DISCOVERY_GROUP) != 0 ||
+			enet_socket_set_option(scanner, ENET_SOCKOPT_MULTICAST_TTL, DISCOVERY_TTL) != 0 ||
+			enet_socket_set_option(scanner, ENET_SOCKOPT_MULTICAST_LOOP, 1) != 0)
+		{
+			fprintf(stderr, "Failed to set up multicast socket\n");
+			enet_socket_destroy(scanner);
+			return 0;
+		}
+	}
+	else
+	{
+		if (enet_socket_set_option(scanner, ENET_SOCKOPT_BROADCAST, 1) != 0)
+		{
+			fprintf(stderr, "Failed to enable broadcast socket\n");
+			enet_socket_destroy(scanner);
+			return 0;
+		}
+		scanaddr.host = ENET_HOST_BROADCAST;
 	}
-	ENetAddress scanaddr;
-	scanaddr.host = ENET_HOST_BROADCAST;
 	scanaddr.port = LISTEN_PORT;
 	// Send a dummy payload
 	char data = 42;
 	ENetBuffer sendbuf;
 	sendbuf.data = &data;
 	sendbuf.dataLength = 1;
-	if (enet_socket_send(scanner, &scanaddr, &sendbuf, 1) != (int)sendbuf.dataLength)
-	{
-		fprintf(stderr, "Failed to scan for LAN servers\n");
-		return 0;
-	}
+
 	// Wait for replies, which will give us server addresses to choose from
+	printf("Scanning for server...\n");
+	const enet_uint32 start = enet_time_get();
+	const enet_uint32 stop = start + policy->timeoutMs;
+	enet_uint32 resend = policy->resendMs;
+	enet_uint32 next_probe = start;
+	enet_uint32 last_reply = start;
 	int sinfo_index = 0;
-	for (int i = 0; i < timeout_seconds && sinfo_index < max_servers; i++)
+	while (sinfo_index < max_servers &&
+		(policy->maxReplies <= 0 || sinfo_index < policy->maxReplies))
 	{
-		printf("Scanning for server...\n");
-		ENetSocketSet set;
-		ENET_SOCKETSET_EMPTY(set);
-		ENET_SOCKETSET_ADD(set, scanner);
-		while (enet_socketset_select(scanner, &set, NULL, 0) > 0)
+		const enet_uint32 now = enet_time_get();
+		if (!ENET_TIME_LESS(now, stop) ||
+			(sinfo_index > 0 && now - last_reply >= policy->quietMs))
+		{
+			break;
+		}
+		if (!ENET_TIME_LESS(now, next_probe))
 		{
-			ENetBuffer recvbuf;
-			recvbuf.data = &server_infos[sinfo_index];
-			recvbuf.dataLength = sizeof server_infos[0];
-			const int recvlen = enet_socket_receive(scanner, &addrs[sinfo_index], &recvbuf, 1);
-			if (recvlen > 0)
+			if (enet_socket_send(scanner, &scanaddr, &sendbuf, 1) != (int)sendbuf.dataLength)
 			{
-				if (recvlen != sizeof(ServerInfo))
-				{
-					fprintf(stderr, "Unexpected reply from scan\n");
-					return 0;
-				}
-				// The server itself runs on a different port,
-				// so take it from the message
-				addrs[sinfo_index].port = server_infos[sinfo_index].port;
-				char buf[256];
-				enet_address_get_host_ip(&addrs[sinfo_index], buf, sizeof buf);
-				printf("Found server '%s' at %s:%d\n", server_infos[sinfo_index].hostname, buf, addrs[sinfo_index].port);
-				sinfo_index++;
+				fprintf(stderr, "Failed to scan for LAN servers\n");
+				break;
 			}
+			next_probe = now + resend;
+			resend *= 2;
 		}
-		Sleep(1000);
-	}
-	if (enet_socket_shutdown(scanner, ENET_SOCKET_SHUTDOWN_READ_WRITE) != 0)
-	{
-		fprintf(stderr, "Failed to shutdown listen socket\n");
-		return 0;
+
+		// Sleep until a reply arrives or we next need to do something
+		enet_uint32 deadline = ENET_TIME_LESS(next_probe, stop) ? next_probe : stop;
+		if (sinfo_index > 0 && ENET_TIME_LESS(last_reply + policy->quietMs, deadline))
+		{
+			deadline = last_reply + policy->quietMs;
+		}
+		enet_uint32 condition = ENET_SOCKET_WAIT_RECEIVE;
+		if (enet_socket_wait(scanner, &condition, ENET_TIME_LESS(now, deadline) ? deadline - now : 0) != 0)
+		{
+			fprintf(stderr, "Failed to wait for replies\n");
+			break;
+		}
+		if (!(condition & ENET_SOCKET_WAIT_RECEIVE))
+		{
+			continue;
+		}
+
+		// Replies from newer servers may carry more than we know how to
+		// read; take the whole datagram, since a truncated one is reported
+		// as an error, and parse only the part we understand
+		enet_uint8 reply[ENET_PROTOCOL_MAXIMUM_MTU];
+		ENetBuffer recvbuf;
+		recvbuf.data = reply;
+		recvbuf.dataLength = sizeof reply;
+		const int recvlen = enet_socket_receive(scanner, &addrs[sinfo_index], &recvbuf, 1);
+		if (recvlen <= 0)
+		{
+			continue;
+		}
+		if (!server_info_read(&server_infos[sinfo_index], reply, (size_t)recvlen))
+		{
+			fprintf(stderr, "Unexpected reply from scan\n");
+			continue;
+		}
+		// The server itself runs on a different port,
+		// so take it from the message
+		addrs[sinfo_index].port = server_infos[sinfo_index].port;
+		// Servers answer every probe we resend, so skip ones we have
+		bool seen = false;
+		for (int i = 0; i < sinfo_index; i++)
+		{
+			if (addrs[i].host == addrs[sinfo_index].host &&
+				addrs[i].port == addrs[sinfo_index].port)
+			{
+				seen = true;
+				break;
+			}
+		}
+		if (seen)
+		{
+			continue;
+		}
+		char buf[256];
+		enet_address_get_host_ip(&addrs[sinfo_index], buf, sizeof buf);
+		printf("Found server '%s' at %s:%d (%d/%d clients)\n",
+			server_infos[sinfo_index].hostname, buf, addrs[sinfo_index].port,
+			server_infos[sinfo_index].clients, server_infos[sinfo_index].maxClients);
+		last_reply = enet_time_get();
+		sinfo_index++;
 	}
+	// The scanner never connects, so there is nothing to shut down
 	enet_socket_destroy(scanner);
 	return sinfo_index;
 }
@@ -250,6 +353,20 @@ void send_string(ENetPeer *peer, char *s)
 	}
 }
 
+// The server may pack several null-terminated chat lines into one packet
+void print_lines(const ENetPacket *packet)
+{
+	const char *line = (const char *)packet->data;
+	const char *end = line + packet->dataLength;
+	while (line < end)
+	{
+		const char *nul = memchr(line, '\0', (size_t)(end - line));
+		const size_t len = nul != NULL ? (size_t)(nul - line) : (size_t)(end - line);
+		printf("%.*s\n", (int)len, line);
+		line += len + 1;
+	}
+}
+
 void stop_client(ENetHost *host, ENetPeer *peer)
 {
 	printf("Client closing\n");
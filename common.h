@@ -1,11 +1,92 @@
 #pragma once
+#include <stdbool.h>
+#include <string.h>
+
 // The port that both client and server will use for discovery
 #define LISTEN_PORT 34567
+// The multicast group servers listen on, so that scans using it only
+// reach hosts running a server; an organisation-local address by default
+#define DISCOVERY_GROUP "239.255.43.21"
+// Hops a multicast scan may cross; 1 keeps it on the local network
+#define DISCOVERY_TTL 1
 
 // The reply that the server will send to the client scan
-// Note that numeric types should be set to network byte order
 typedef struct
 {
-	char hostname[1024];
+	char hostname[256];
 	enet_uint16 port;
+	enet_uint16 clients;
+	enet_uint16 maxClients;
+	// Rough measure of how busy the server is, from 0 (idle) to 100
+	enet_uint8 load;
 } ServerInfo;
+
+// On the wire the reply is, with numbers in network byte order:
+//   magic "LANC", version (1 byte), length of the fixed fields (1 byte),
+//   the fixed fields: port, clients, maxClients (2 bytes each), load (1 byte),
+//   hostname length (1 byte) and the hostname without a terminator.
+// Newer versions may append fixed fields, counted in their length, or
+// anything after the hostname; readers skip what they do not know.
+#define SERVER_INFO_MAGIC "LANC"
+#define SERVER_INFO_VERSION 1
+#define SERVER_INFO_FIXED_SIZE 7
+// The largest reply this version writes; newer replies may be longer, so
+// readers should not use it to size their receive buffer
+#define SERVER_INFO_MAX_SIZE (4 + 2 + SERVER_INFO_FIXED_SIZE + 1 + 255)
+
+// Serialise a reply into buf, which should hold SERVER_INFO_MAX_SIZE bytes
+// Return the number of bytes written
+static inline size_t server_info_write(
+	const ServerInfo *info, enet_uint8 *buf, size_t size)
+{
+	size_t nameLength = strlen(info->hostname);
+	if (nameLength > 255)
+	{
+		nameLength = 255;
+	}
+	const size_t len = 4 + 2 + SERVER_INFO_FIXED_SIZE + 1 + nameLength;
+	if (len > size)
+	{
+		return 0;
+	}
+	enet_uint8 *p = buf;
+	memcpy(p, SERVER_INFO_MAGIC, 4);
+	p += 4;
+	*p++ = SERVER_INFO_VERSION;
+	*p++ = SERVER_INFO_FIXED_SIZE;
+	*p++ = (enet_uint8)(info->port >> 8);
+	*p++ = (enet_uint8)info->port;
+	*p++ = (enet_uint8)(info->clients >> 8);
+	*p++ = (enet_uint8)info->clients;
+	*p++ = (enet_uint8)(info->maxClients >> 8);
+	*p++ = (enet_uint8)info->maxClients;
+	*p++ = info->load;
+	*p++ = (enet_uint8)nameLength;
+	memcpy(p, info->hostname, nameLength);
+	return len;
+}
+
+// Parse a reply from a server
+// Return whether it was a valid reply of a version we understand
+static inline bool server_info_read(
+	ServerInfo *info, const enet_uint8 *buf, size_t len)
+{
+	if (len < 4 + 2 || memcmp(buf, SERVER_INFO_MAGIC, 4) != 0 ||
+		buf[4] < SERVER_INFO_VERSION || buf[5] < SERVER_INFO_FIXED_SIZE)
+	{
+		return false;
+	}
+	const enet_uint8 *p = buf + 6;
+	const enet_uint8 *name = p + buf[5];
+	if (name >= buf + len || name + 1 + name[0] > buf + len)
+	{
+		return false;
+	}
+	info->port = (enet_uint16)((p[0] << 8) | p[1]);
+	info->clients = (enet_uint16)((p[2] << 8) | p[3]);
+	info->maxClients = (enet_uint16)((p[4] << 8) | p[5]);
+	info->load = p[6];
+	memcpy(info->hostname, name + 1, name[0]);
+	info->hostname[name[0]] = '\0';
+	return true;
+}
@@ -0,0 +1,298 @@
+/**
+ @file congestion.c
+ @brief ENet congestion control: the packet throttle and a model based alternative
+*/
+#define ENET_BUILDING_LIB 1
+#include <string.h>
+#include "enet/utility.h"
+#include "enet/time.h"
+#include "enet/enet.h"
+
+static void
+enet_throttle_on_acknowledge (void * context, ENetPeer * peer, enet_uint32 bytes, enet_uint32 roundTripTime)
+{
+    (void) context;
+    (void) bytes;
+
+    enet_peer_throttle (peer, roundTripTime);
+}
+
+static enet_uint32
+enet_throttle_congestion_window (void * context, ENetPeer * peer)
+{
+    (void) context;
+
+    return (peer -> packetThrottle * peer -> windowSize) / ENET_PEER_PACKET_THROTTLE_SCALE;
+}
+
+/** Sets up the packet throttle as a congestion control: the reliable window shrinks and grows
+    with the throttle, which follows the round trip time, see enet_peer_throttle_configure().
+*/
+void
+enet_congestion_control_throttle (ENetCongestionControl * congestionControl)
+{
+    memset (congestionControl, 0, sizeof (ENetCongestionControl));
+
+    congestionControl -> onAcknowledge = enet_throttle_on_acknowledge;
+    congestionControl -> congestionWindow = enet_throttle_congestion_window;
+}
+
+/* A simplified BBR: rather than reacting to round trip times growing, it keeps a model of the
+   path, the highest delivery rate seen in recent rounds and the lowest round trip time, and
+   paces datagrams at that rate while keeping about two round trips' worth of data in transit.
+   A round lasts the lowest round trip time, as the acknowledgements do not say which send they
+   answer, but at least a millisecond, as hosts are serviced no more finely than that. */
+
+enum
+{
+   ENET_BBR_GAIN_SCALE              = 1000,
+   ENET_BBR_STARTUP_GAIN            = 2885,   /* 2 / ln 2, enough to double the rate every round */
+   ENET_BBR_DRAIN_GAIN              = 347,    /* 1 / ENET_BBR_STARTUP_GAIN */
+   ENET_BBR_WINDOW_GAIN             = 2000,
+   ENET_BBR_BANDWIDTH_ROUNDS        = 10,
+   ENET_BBR_FULL_BANDWIDTH_ROUNDS   = 3,
+   ENET_BBR_STARTUP_LOSS_SCALE      = 50,     /* leave startup once more than 1 / 50 of a round is lost */
+   ENET_BBR_CYCLE_LENGTH            = 8,
+   ENET_BBR_ROUND_TRIP_TIME_EXPIRY  = 10000,
+   ENET_BBR_PROBE_ROUND_TRIP_TIME   = 200,
+   ENET_BBR_INITIAL_WINDOW          = 10,     /* in datagrams, before the first delivery rate sample */
+   ENET_BBR_MINIMUM_WINDOW          = 4,
+   ENET_BBR_MINIMUM_ROUND           = 1000    /* in microseconds */
+};
+
+typedef enum _ENetBBRMode
+{
+   ENET_BBR_MODE_STARTUP,
+   ENET_BBR_MODE_DRAIN,
+   ENET_BBR_MODE_PROBE_BANDWIDTH,
+   ENET_BBR_MODE_PROBE_ROUND_TRIP_TIME
+} ENetBBRMode;
+
+typedef struct _ENetBBRPeer
+{
+   ENetBBRMode mode;
+   enet_uint32 bandwidthSamples [ENET_BBR_BANDWIDTH_ROUNDS];  /**< delivery rate of each recent round, in bytes per second */
+   enet_uint32 bandwidth;                                     /**< highest of the bandwidth samples */
+   enet_uint32 fullBandwidth;
+   enet_uint32 fullBandwidthRounds;
+   enet_uint32 round;
+   enet_uint32 roundStart;                                    /**< enet_time_get_microseconds() when the round began */
+   enet_uint32 roundDelivered;
+   enet_uint32 roundLost;
+   enet_uint32 roundTripTime;                                 /**< lowest round trip time, in microseconds, sampled since roundTripTimeStamp */
+   enet_uint32 roundTripTimeStamp;
+   enet_uint32 probeRoundTripTimeEnd;
+   enet_uint32 cycleIndex;
+   int         hasRoundTripTime;
+   int         fullBandwidthReached;
+} ENetBBRPeer;
+
+static const enet_uint32 enet_bbr_cycle_gains [ENET_BBR_CYCLE_LENGTH] = { 1250, 750, 1000, 1000, 1000, 1000, 1000, 1000 };
+
+#define ENET_BBR_PEER(context, peer) (& ((ENetBBRPeer *) (context)) [(peer) - (peer) -> host -> peers])
+
+static enet_uint32
+enet_bbr_bandwidth_delay_product (const ENetBBRPeer * bbr)
+{
+    enet_uint32 roundTripTime = ENET_MAX (bbr -> roundTripTime, ENET_BBR_MINIMUM_ROUND);
+
+    return (bbr -> bandwidth / 1000) * (roundTripTime / 1000) + (bbr -> bandwidth / 1000) * (roundTripTime % 1000) / 1000;
+}
+
+/* Returns in bytes per second the rate of delivering bytes over time microseconds. */
+static enet_uint32
+enet_bbr_delivery_rate (enet_uint32 bytes, enet_uint32 time)
+{
+    if (time >= 1000000)
+    {
+       time /= 1000;
+
+       return (bytes / time) * 1000 + (bytes % time) * 1000 / time;
+    }
+
+    return (bytes / time) * 1000000 + (bytes % time) * 1000 / time * 1000;
+}
+
+static void
+enet_bbr_reset (void * context, ENetPeer * peer)
+{
+    memset (ENET_BBR_PEER (context, peer), 0, sizeof (ENetBBRPeer));
+}
+
+static void
+enet_bbr_end_round (ENetBBRPeer * bbr, ENetPeer * peer, enet_uint32 elapsedTime)
+{
+    enet_uint32 sample = enet_bbr_delivery_rate (bbr -> roundDelivered, elapsedTime),
+                sampleIndex;
+
+    /* With nothing waiting to be sent, the round only shows how much the application sent. */
+    if (sample > bbr -> bandwidthSamples [bbr -> round % ENET_BBR_BANDWIDTH_ROUNDS] ||
+        ! enet_list_empty (& peer -> outgoingReliableCommands))
+      bbr -> bandwidthSamples [bbr -> round % ENET_BBR_BANDWIDTH_ROUNDS] = sample;
+
+    bbr -> bandwidth = 0;
+    for (sampleIndex = 0; sampleIndex < ENET_BBR_BANDWIDTH_ROUNDS; ++ sampleIndex)
+    {
+       if (bbr -> bandwidthSamples [sampleIndex] > bbr -> bandwidth)
+         bbr -> bandwidth = bbr -> bandwidthSamples [sampleIndex];
+    }
+
+    switch (bbr -> mode)
+    {
+    case ENET_BBR_MODE_STARTUP:
+       if (bbr -> roundLost * ENET_BBR_STARTUP_LOSS_SCALE > bbr -> roundDelivered + bbr -> roundLost)
+         bbr -> fullBandwidthReached = 1;
+       else
+       if (bbr -> bandwidth >= bbr -> fullBandwidth / 4 * 5)
+       {
+          bbr -> fullBandwidth = bbr -> bandwidth;
+          bbr -> fullBandwidthRounds = 0;
+       }
+       else
+       if (++ bbr -> fullBandwidthRounds >= ENET_BBR_FULL_BANDWIDTH_ROUNDS)
+         bbr -> fullBandwidthReached = 1;
+
+       if (bbr -> fullBandwidthReached)
+         bbr -> mode = ENET_BBR_MODE_DRAIN;
+       break;
+
+    case ENET_BBR_MODE_PROBE_BANDWIDTH:
+       bbr -> cycleIndex = (bbr -> cycleIndex + 1) % ENET_BBR_CYCLE_LENGTH;
+       break;
+
+    default:
+       break;
+    }
+
+    ++ bbr -> round;
+    bbr -> roundDelivered = 0;
+    bbr -> roundLost = 0;
+}
+
+static void
+enet_bbr_on_acknowledge (void * context, ENetPeer * peer, enet_uint32 bytes, enet_uint32 roundTripTime)
+{
+    ENetBBRPeer * bbr = ENET_BBR_PEER (context, peer);
+    enet_uint32 serviceTime = peer -> host -> serviceTime,
+                elapsedTime;
+
+    if (! bbr -> hasRoundTripTime)
+      bbr -> roundStart = peer -> host -> serviceTimeMicroseconds;
+
+    if (! bbr -> hasRoundTripTime || roundTripTime <= bbr -> roundTripTime)
+    {
+       bbr -> roundTripTime = roundTripTime;
+       bbr -> roundTripTimeStamp = serviceTime;
+       bbr -> hasRoundTripTime = 1;
+    }
+    else
+    if (ENET_TIME_DIFFERENCE (serviceTime, bbr -> roundTripTimeStamp) >= ENET_BBR_ROUND_TRIP_TIME_EXPIRY &&
+        bbr -> mode != ENET_BBR_MODE_PROBE_ROUND_TRIP_TIME)
+    {
+       /* Let the queue drain so that the path's round trip time can be seen again. */
+       bbr -> mode = ENET_BBR_MODE_PROBE_ROUND_TRIP_TIME;
+       bbr -> probeRoundTripTimeEnd = serviceTime + ENET_BBR_PROBE_ROUND_TRIP_TIME;
+       bbr -> roundTripTime = roundTripTime;
+       bbr -> roundTripTimeStamp = serviceTime;
+    }
+
+    if (bbr -> mode == ENET_BBR_MODE_PROBE_ROUND_TRIP_TIME &&
+        ENET_TIME_GREATER_EQUAL (serviceTime, bbr -> probeRoundTripTimeEnd))
+      bbr -> mode = bbr -> fullBandwidthReached ? ENET_BBR_MODE_PROBE_BANDWIDTH : ENET_BBR_MODE_STARTUP;
+
+    bbr -> roundDelivered += bytes;
+
+    elapsedTime = peer -> host -> serviceTimeMicroseconds - bbr -> roundStart;
+    if (elapsedTime >= ENET_MAX (bbr -> roundTripTime, ENET_BBR_MINIMUM_ROUND))
+    {
+       enet_bbr_end_round (bbr, peer, elapsedTime);
+
+       bbr -> roundStart = peer -> host -> serviceTimeMicroseconds;
+    }
+
+    if (bbr -> mode == ENET_BBR_MODE_DRAIN &&
+        peer -> reliableDataInTransit <= enet_bbr_bandwidth_delay_product (bbr))
+    {
+       bbr -> mode = ENET_BBR_MODE_PROBE_BANDWIDTH;
+       bbr -> cycleIndex = 2;
+    }
+}
+
+static void
+enet_bbr_on_loss (void * context, ENetPeer * peer, enet_uint32 bytes)
+{
+    ENET_BBR_PEER (context, peer) -> roundLost += bytes;
+}
+
+static enet_uint32
+enet_bbr_congestion_window (void * context, ENetPeer * peer)
+{
+    ENetBBRPeer * bbr = ENET_BBR_PEER (context, peer);
+    enet_uint32 window;
+
+    if (bbr -> bandwidth == 0)
+      return ENET_BBR_INITIAL_WINDOW * peer -> mtu;
+
+    if (bbr -> mode == ENET_BBR_MODE_PROBE_ROUND_TRIP_TIME)
+      return ENET_BBR_MINIMUM_WINDOW * peer -> mtu;
+
+    window = enet_bbr_bandwidth_delay_product (bbr) / ENET_BBR_GAIN_SCALE *
+               (bbr -> mode == ENET_BBR_MODE_PROBE_BANDWIDTH ? ENET_BBR_WINDOW_GAIN : ENET_BBR_STARTUP_GAIN);
+
+    return ENET_MAX (window, ENET_BBR_MINIMUM_WINDOW * peer -> mtu);
+}
+
+static enet_uint32
+enet_bbr_pacing_rate (void * context, ENetPeer * peer)
+{
+    ENetBBRPeer * bbr = ENET_BBR_PEER (context, peer);
+    enet_uint32 gain;
+
+    switch (bbr -> mode)
+    {
+    case ENET_BBR_MODE_STARTUP: gain = ENET_BBR_STARTUP_GAIN; break;
+    case ENET_BBR_MODE_DRAIN: gain = ENET_BBR_DRAIN_GAIN; break;
+    case ENET_BBR_MODE_PROBE_BANDWIDTH: gain = enet_bbr_cycle_gains [bbr -> cycleIndex]; break;
+    default: gain = ENET_BBR_GAIN_SCALE; break;
+    }
+
+    return bbr -> bandwidth / ENET_BBR_GAIN_SCALE * gain;
+}
+
+static void
+enet_bbr_destroy (void * context)
+{
+    enet_free (context);
+}
+
+/** @defgroup host ENet host functions
+    @{
+*/
+
+/** Sets the congestion control the host should use to a simplified BBR, which paces datagrams
+    at the delivery rate it measures rather than sending them in bursts.
+    @param host host to enable BBR for
+    @returns 0 on success, < 0 on failure
+*/
+int
+enet_host_congestion_control_with_bbr (ENetHost * host)
+{
+    ENetCongestionControl congestionControl;
+
+    memset (& congestionControl, 0, sizeof (congestionControl));
+    congestionControl.context = enet_malloc (host -> peerCount * sizeof (ENetBBRPeer));
+    if (congestionControl.context == NULL)
+      return -1;
+    memset (congestionControl.context, 0, host -> peerCount * sizeof (ENetBBRPeer));
+
+    congestionControl.reset = enet_bbr_reset;
+    congestionControl.onAcknowledge = enet_bbr_on_acknowledge;
+    congestionControl.onLoss = enet_bbr_on_loss;
+    congestionControl.congestionWindow = enet_bbr_congestion_window;
+    congestionControl.pacingRate = enet_bbr_pacing_rate;
+    congestionControl.destroy = enet_bbr_destroy;
+    enet_host_congestion_control (host, & congestionControl);
+    return 0;
+}
+
+/** @} */
@@ -105,6 +105,14 @@ SOURCE=.\compress.c
 # End Source File
 # Begin Source File
 
+SOURCE=.\congestion.c
+# End Source File
+# Begin Source File
+
+SOURCE=.\group.c
+# End Source File
+# Begin Source File
+
 SOURCE=.\packet.c
 # End Source File
 # Begin Source File
@@ -117,6 +125,10 @@ SOURCE=.\protocol.c
 # End Source File
 # Begin Source File
 
+SOURCE=.\timer.c
+# End Source File
+# Begin Source File
+
 SOURCE=.\unix.c
 # End Source File
 # Begin Source File
@@ -137,6 +149,10 @@ SOURCE=.\include\enet\list.h
 # End Source File
 # Begin Source File
 
+SOURCE=.\include\enet\timer.h
+# End Source File
+# Begin Source File
+
 SOURCE=.\include\enet\callbacks.h
 # End Source File
 # Begin Source File
@@ -0,0 +1,171 @@
+/**
+ @file  group.c
+ @brief ENet peer group functions
+*/
+#include <string.h>
+#define ENET_BUILDING_LIB 1
+#include "enet/enet.h"
+
+/** @defgroup group ENet group functions
+    @{
+*/
+
+/** Creates an empty group of peers of a host.
+    @param host host whose peers may be added to the group
+    @returns the group on success, NULL on failure
+    @remarks The group must be destroyed with enet_group_destroy() before its host.
+*/
+ENetGroup *
+enet_group_create (ENetHost * host)
+{
+    ENetGroup * group = (ENetGroup *) enet_malloc (sizeof (ENetGroup));
+    if (group == NULL)
+      return NULL;
+
+    group -> host = host;
+    group -> members = NULL;
+    group -> memberCount = 0;
+    group -> memberCapacity = 0;
+
+    return group;
+}
+
+/** Destroys a group, leaving its peers connected.
+    @param group group to destroy
+*/
+void
+enet_group_destroy (ENetGroup * group)
+{
+    if (group == NULL)
+      return;
+
+    if (group -> members != NULL)
+      enet_free (group -> members);
+    enet_free (group);
+}
+
+static size_t
+enet_group_find_peer (ENetGroup * group, ENetPeer * peer)
+{
+    enet_uint16 peerIndex = (enet_uint16) (peer - group -> host -> peers);
+    size_t memberIndex;
+
+    for (memberIndex = 0; memberIndex < group -> memberCount; ++ memberIndex)
+    {
+       if (group -> members [memberIndex].peerIndex == peerIndex)
+         break;
+    }
+
+    return memberIndex;
+}
+
+static void
+enet_group_remove_member (ENetGroup * group, size_t memberIndex)
+{
+    group -> members [memberIndex] = group -> members [-- group -> memberCount];
+}
+
+/** Adds a connected peer to a group.
+    @param group group to add the peer to
+    @param peer peer to add, which must belong to the group's host
+    @returns 0 on success or if the peer is already in the group, < 0 on failure
+*/
+int
+enet_group_add_peer (ENetGroup * group, ENetPeer * peer)
+{
+    size_t memberIndex;
+
+    if (peer -> host != group -> host || peer -> state != ENET_PEER_STATE_CONNECTED)
+      return -1;
+
+    memberIndex = enet_group_find_peer (group, peer);
+    if (memberIndex < group -> memberCount)
+    {
+       group -> members [memberIndex].connectID = peer -> connectID;
+
+       return 0;
+    }
+
+    if (group -> memberCount >= group -> memberCapacity)
+    {
+       size_t memberCapacity = group -> memberCapacity ? group -> memberCapacity * 2 : 8;
+       ENetGroupMember * members = (ENetGroupMember *) enet_malloc (memberCapacity * sizeof (ENetGroupMember));
+       if (members == NULL)
+         return -1;
+
+       if (group -> members != NULL)
+       {
+          memcpy (members, group -> members, group -> memberCount * sizeof (ENetGroupMember));
+
+          enet_free (group -> members);
+       }
+
+       group -> members = members;
+       group -> memberCapacity = memberCapacity;
+    }
+
+    group -> members [group -> memberCount].connectID = peer -> connectID;
+    group -> members [group -> memberCount].peerIndex = (enet_uint16) (peer - group -> host -> peers);
+    ++ group -> memberCount;
+
+    return 0;
+}
+
+/** Removes a peer from a group, if it is in it.
+    @param group group to remove the peer from
+    @param peer peer to remove
+*/
+void
+enet_group_remove_peer (ENetGroup * group, ENetPeer * peer)
+{
+    size_t memberIndex;
+
+    if (peer -> host != group -> host)
+      return;
+
+    memberIndex = enet_group_find_peer (group, peer);
+    if (memberIndex < group -> memberCount)
+      enet_group_remove_member (group, memberIndex);
+}
+
+/** Queues a packet to be sent to all peers in a group.
+    @param group group on which to broadcast the packet
+    @param channelID channel on which to broadcast
+    @param packet packet to broadcast
+    @remarks Only the group's members are visited. Members that are no longer connected, or
+    whose peer has been reused for another connection, are removed from the group.
+*/
+void
+enet_group_broadcast (ENetGroup * group, enet_uint8 channelID, ENetPacket * packet)
+{
+    ENetProtocol command;
+    size_t memberIndex = 0;
+
+    enet_peer_setup_send_command (& command, channelID, packet);
+
+    while (memberIndex < group -> memberCount)
+    {
+       ENetGroupMember * member = & group -> members [memberIndex];
+       ENetPeer * peer = & group -> host -> peers [member -> peerIndex];
+
+       if (peer -> connectID != member -> connectID ||
+           (peer -> state != ENET_PEER_STATE_CONNECTED && peer -> state != ENET_PEER_STATE_DISCONNECT_LATER))
+       {
+          enet_group_remove_member (group, memberIndex);
+
+          continue;
+       }
+
+       if (peer -> state == ENET_PEER_STATE_CONNECTED &&
+           packet -> dataLength <= group -> host -> maximumPacketSize)
+         enet_peer_send_command (peer, channelID, packet, & command);
+
+       ++ memberIndex;
+    }
+
+    if (packet -> referenceCount == 0)
+      enet_packet_destroy (packet);
+}
+
+/** @} */
+
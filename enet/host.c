@@ -5,6 +5,10 @@
 #define ENET_BUILDING_LIB 1
 #include <string.h>
 #include "enet/enet.h"
+#include "enet/utility.h"
+#include "enet/time.h"
+
+#define ENET_RECEIVE_SLAB_DATA(slab) ((enet_uint8 *) ((ENetReceiveSlab *) (slab) + 1))
 
 /** @defgroup host ENet host functions
     @{
@@ -30,6 +34,7 @@ enet_host_create (const ENetAddress * address, size_t peerCount, size_t channelL
 {
     ENetHost * host;
     ENetPeer * currentPeer;
+    size_t datagramIndex, bucketIndex;
 
     if (peerCount > ENET_PROTOCOL_MAXIMUM_PEER_ID)
       return NULL;
@@ -48,12 +53,63 @@ enet_host_create (const ENetAddress * address, size_t peerCount, size_t channelL
     }
     memset (host -> peers, 0, peerCount * sizeof (ENetPeer));
 
+    for (host -> addressBucketMask = 1; host -> addressBucketMask < peerCount; host -> addressBucketMask <<= 1)
+      ;
+    host -> addressBuckets = (ENetList *) enet_malloc (host -> addressBucketMask * sizeof (ENetList));
+    if (host -> addressBuckets == NULL)
+    {
+       enet_free (host -> peers);
+       enet_free (host);
+
+       return NULL;
+    }
+    for (bucketIndex = 0; bucketIndex < host -> addressBucketMask; ++ bucketIndex)
+      enet_list_clear (& host -> addressBuckets [bucketIndex]);
+    -- host -> addressBucketMask;
+
+    host -> receivedBatchData = (enet_uint8 *) enet_malloc (ENET_HOST_RECEIVE_BATCH_SIZE * ENET_PROTOCOL_MAXIMUM_MTU);
+    if (host -> receivedBatchData == NULL)
+    {
+       enet_free (host -> addressBuckets);
+       enet_free (host -> peers);
+       enet_free (host);
+
+       return NULL;
+    }
+
+    host -> outgoingDatagrams = (ENetOutgoingDatagram *) enet_malloc (ENET_HOST_SEND_BATCH_SIZE * sizeof (ENetOutgoingDatagram));
+    if (host -> outgoingDatagrams == NULL)
+    {
+       enet_free (host -> receivedBatchData);
+       enet_free (host -> addressBuckets);
+       enet_free (host -> peers);
+       enet_free (host);
+
+       return NULL;
+    }
+
+    host -> sendBuffers = (ENetBuffer *) enet_malloc (ENET_HOST_SEND_BATCH_SIZE * ENET_BUFFER_MAXIMUM * sizeof (ENetBuffer));
+    if (host -> sendBuffers == NULL)
+    {
+       enet_free (host -> outgoingDatagrams);
+       enet_free (host -> receivedBatchData);
+       enet_free (host -> addressBuckets);
+       enet_free (host -> peers);
+       enet_free (host);
+
+       return NULL;
+    }
+
     host -> socket = enet_socket_create (ENET_SOCKET_TYPE_DATAGRAM);
     if (host -> socket == ENET_SOCKET_NULL || (address != NULL && enet_socket_bind (host -> socket, address) < 0))
     {
        if (host -> socket != ENET_SOCKET_NULL)
          enet_socket_destroy (host -> socket);
 
+       enet_free (host -> sendBuffers);
+       enet_free (host -> outgoingDatagrams);
+       enet_free (host -> receivedBatchData);
+       enet_free (host -> addressBuckets);
        enet_free (host -> peers);
        enet_free (host);
 
@@ -91,11 +147,37 @@ enet_host_create (const ENetAddress * address, size_t peerCount, size_t channelL
     host -> receivedAddress.port = 0;
     host -> receivedData = NULL;
     host -> receivedDataLength = 0;
+    host -> receivedDatagramCount = 0;
+    host -> receivedDatagramIndex = 0;
+
+    for (datagramIndex = 0; datagramIndex < ENET_HOST_RECEIVE_BATCH_SIZE; ++ datagramIndex)
+    {
+       host -> receivedBuffers [datagramIndex].data = & host -> receivedBatchData [datagramIndex * ENET_PROTOCOL_MAXIMUM_MTU];
+       host -> receivedBuffers [datagramIndex].dataLength = ENET_PROTOCOL_MAXIMUM_MTU;
+       host -> receivedDatagrams [datagramIndex].buffers = & host -> receivedBuffers [datagramIndex];
+       host -> receivedDatagrams [datagramIndex].bufferCount = 1;
+       host -> receivedDatagrams [datagramIndex].segmentSize = 0;
+    }
+    host -> receivedSegmentOffset = 0;
+    host -> receivedSlab = NULL;
+
+    host -> sendDatagramCount = 0;
+    host -> sendBufferCount = 0;
+    host -> outgoingDatagramCount = 0;
+    host -> segmentationOffload = 0;
+    host -> zeroCopyReceive = 0;
+    host -> connectCookies = 0;
+    memset (host -> cookieSecret, 0, sizeof (host -> cookieSecret));
+    enet_timer_wheel_clear (& host -> timerWheel, enet_time_get ());
      
     host -> totalSentData = 0;
     host -> totalSentPackets = 0;
     host -> totalReceivedData = 0;
     host -> totalReceivedPackets = 0;
+    host -> totalSendCalls = 0;
+    host -> totalReceiveCalls = 0;
+    host -> totalCommandPoolHits = 0;
+    host -> totalCommandPoolMisses = 0;
 
     host -> connectedPeers = 0;
     host -> bandwidthLimitedPeers = 0;
@@ -108,9 +190,20 @@ enet_host_create (const ENetAddress * address, size_t peerCount, size_t channelL
     host -> compressor.decompress = NULL;
     host -> compressor.destroy = NULL;
 
+    enet_congestion_control_throttle (& host -> congestionControl);
+
     host -> intercept = NULL;
 
     enet_list_clear (& host -> dispatchQueue);
+    enet_list_clear (& host -> serviceQueue);
+
+    enet_list_clear (& host -> freePeers);
+
+    enet_list_clear (& host -> outgoingCommandPool);
+    enet_list_clear (& host -> incomingCommandPool);
+    host -> outgoingCommandPoolSize = 0;
+    host -> incomingCommandPoolSize = 0;
+    host -> commandPoolLimit = ENET_HOST_DEFAULT_COMMAND_POOL_SIZE;
 
     for (currentPeer = host -> peers;
          currentPeer < & host -> peers [host -> peerCount];
@@ -128,7 +221,12 @@ enet_host_create (const ENetAddress * address, size_t peerCount, size_t channelL
        enet_list_clear (& currentPeer -> outgoingUnreliableCommands);
        enet_list_clear (& currentPeer -> dispatchedCommands);
 
+       enet_timer_setup (& currentPeer -> pingTimer, ENET_TIMER_TYPE_PING, currentPeer);
+       enet_timer_setup (& currentPeer -> pacingTimer, ENET_TIMER_TYPE_PACING, currentPeer);
+
        enet_peer_reset (currentPeer);
+
+       enet_list_insert (enet_list_end (& host -> freePeers), & currentPeer -> freeList);
     }
 
     return host;
@@ -141,6 +239,7 @@ void
 enet_host_destroy (ENetHost * host)
 {
     ENetPeer * currentPeer;
+    size_t datagramIndex;
 
     if (host == NULL)
       return;
@@ -157,6 +256,26 @@ enet_host_destroy (ENetHost * host)
     if (host -> compressor.context != NULL && host -> compressor.destroy)
       (* host -> compressor.destroy) (host -> compressor.context);
 
+    if (host -> congestionControl.context != NULL && host -> congestionControl.destroy)
+      (* host -> congestionControl.destroy) (host -> congestionControl.context);
+
+    while (! enet_list_empty (& host -> outgoingCommandPool))
+      enet_free (enet_list_remove (enet_list_begin (& host -> outgoingCommandPool)));
+
+    while (! enet_list_empty (& host -> incomingCommandPool))
+      enet_free (enet_list_remove (enet_list_begin (& host -> incomingCommandPool)));
+
+    for (datagramIndex = 0; datagramIndex < ENET_HOST_RECEIVE_BATCH_SIZE; ++ datagramIndex)
+    {
+       if (host -> receivedSlabs [datagramIndex] != NULL)
+         enet_receive_slab_release (host -> receivedSlabs [datagramIndex]);
+    }
+
+    enet_free (host -> sendBuffers);
+    enet_free (host -> outgoingDatagrams);
+    if (host -> receivedBatchData != NULL)
+      enet_free (host -> receivedBatchData);
+    enet_free (host -> addressBuckets);
     enet_free (host -> peers);
     enet_free (host);
 }
@@ -174,7 +293,7 @@ ENetPeer *
 enet_host_connect (ENetHost * host, const ENetAddress * address, size_t channelCount, enet_uint32 data)
 {
     ENetPeer * currentPeer;
-    ENetChannel * channel;
+    ENetChannel * channel, * channels;
     ENetProtocol command;
 
     if (channelCount < ENET_PROTOCOL_MINIMUM_CHANNEL_COUNT)
@@ -183,23 +302,17 @@ enet_host_connect (ENetHost * host, const ENetAddress * address, size_t channelC
     if (channelCount > ENET_PROTOCOL_MAXIMUM_CHANNEL_COUNT)
       channelCount = ENET_PROTOCOL_MAXIMUM_CHANNEL_COUNT;
 
-    for (currentPeer = host -> peers;
-         currentPeer < & host -> peers [host -> peerCount];
-         ++ currentPeer)
-    {
-       if (currentPeer -> state == ENET_PEER_STATE_DISCONNECTED)
-         break;
-    }
-
-    if (currentPeer >= & host -> peers [host -> peerCount])
+    if (enet_list_empty (& host -> freePeers))
       return NULL;
 
-    currentPeer -> channels = (ENetChannel *) enet_malloc (channelCount * sizeof (ENetChannel));
-    if (currentPeer -> channels == NULL)
+    channels = (ENetChannel *) enet_malloc (channelCount * sizeof (ENetChannel));
+    if (channels == NULL)
       return NULL;
+
+    currentPeer = enet_host_allocate_peer (host, address);
+    currentPeer -> channels = channels;
     currentPeer -> channelCount = channelCount;
     currentPeer -> state = ENET_PEER_STATE_CONNECTING;
-    currentPeer -> address = * address;
     currentPeer -> connectID = ++ host -> randomSeed;
 
     if (host -> outgoingBandwidth == 0)
@@ -224,14 +337,18 @@ enet_host_connect (ENetHost * host, const ENetAddress * address, size_t channelC
         channel -> incomingReliableSequenceNumber = 0;
         channel -> incomingUnreliableSequenceNumber = 0;
 
-        enet_list_clear (& channel -> incomingReliableCommands);
+        channel -> incomingReliableRing = NULL;
+        channel -> incomingReliableRingMask = 0;
+        channel -> incomingReliableCount = 0;
+        channel -> sentReliableRing = NULL;
+        channel -> sentReliableRingMask = 0;
         enet_list_clear (& channel -> incomingUnreliableCommands);
 
         channel -> usedReliableWindows = 0;
         memset (channel -> reliableWindows, 0, sizeof (channel -> reliableWindows));
     }
         
-    command.header.command = ENET_PROTOCOL_COMMAND_CONNECT | ENET_PROTOCOL_COMMAND_FLAG_ACKNOWLEDGE;
+    command.header.command = ENET_PROTOCOL_COMMAND_CONNECT | ENET_PROTOCOL_COMMAND_FLAG_ACKNOWLEDGE | ENET_PROTOCOL_COMMAND_FLAG_SELECTIVE_ACKNOWLEDGE;
     command.header.channelID = 0xFF;
     command.connect.outgoingPeerID = ENET_HOST_TO_NET_16 (currentPeer -> incomingPeerID);
     command.connect.incomingSessionID = currentPeer -> incomingSessionID;
@@ -256,20 +373,36 @@ enet_host_connect (ENetHost * host, const ENetAddress * address, size_t channelC
     @param host host on which to broadcast the packet
     @param channelID channel on which to broadcast
     @param packet packet to broadcast
+    @remarks The send command is built once and queued to every connected peer the packet fits
+    without fragmenting; only peers that need it fragmented go through enet_peer_send().
 */
 void
 enet_host_broadcast (ENetHost * host, enet_uint8 channelID, ENetPacket * packet)
 {
     ENetPeer * currentPeer;
+    ENetProtocol command;
+    size_t peersRemaining = host -> connectedPeers;
+
+    if (packet -> dataLength > host -> maximumPacketSize)
+      peersRemaining = 0;
+
+    enet_peer_setup_send_command (& command, channelID, packet);
 
     for (currentPeer = host -> peers;
-         currentPeer < & host -> peers [host -> peerCount];
+         currentPeer < & host -> peers [host -> peerCount] && peersRemaining > 0;
          ++ currentPeer)
     {
        if (currentPeer -> state != ENET_PEER_STATE_CONNECTED)
-         continue;
+       {
+          if (currentPeer -> state == ENET_PEER_STATE_DISCONNECT_LATER)
+            -- peersRemaining;
+
+          continue;
+       }
+
+       -- peersRemaining;
 
-       enet_peer_send (currentPeer, channelID, packet);
+       enet_peer_send_command (currentPeer, channelID, packet, & command);
     }
 
     if (packet -> referenceCount == 0)
@@ -292,6 +425,24 @@ enet_host_compress (ENetHost * host, const ENetCompressor * compressor)
       host -> compressor.context = NULL;
 }
 
+/** Sets the congestion control the host should use for its peers.
+    @param host host to set the congestion control for
+    @param congestionControl callbacks for the congestion control; if NULL, then the packet throttle is used
+    @remarks The new congestion control starts without knowledge of peers already connected.
+    @sa enet_peer_throttle_configure()
+*/
+void
+enet_host_congestion_control (ENetHost * host, const ENetCongestionControl * congestionControl)
+{
+    if (host -> congestionControl.context != NULL && host -> congestionControl.destroy)
+      (* host -> congestionControl.destroy) (host -> congestionControl.context);
+
+    if (congestionControl)
+      host -> congestionControl = * congestionControl;
+    else
+      enet_congestion_control_throttle (& host -> congestionControl);
+}
+
 /** Limits the maximum allowed channels of future incoming connections.
     @param host host to limit
     @param channelLimit the maximum number of channels allowed; if 0, then this is equivalent to ENET_PROTOCOL_MAXIMUM_CHANNEL_COUNT
@@ -309,6 +460,362 @@ enet_host_channel_limit (ENetHost * host, size_t channelLimit)
 }
 
 
+/** Moves the receive buffers of a host into new storage of the given size, either a single
+    block for the whole batch or a receive slab per datagram, keeping any datagrams that are
+    still waiting in the batch.
+    @returns 0 on success, < 0 on failure
+*/
+static int
+enet_host_setup_receive_buffers (ENetHost * host, size_t bufferSize, int zeroCopy)
+{
+    ENetReceiveSlab * slabs [ENET_HOST_RECEIVE_BATCH_SIZE];
+    enet_uint8 * batchData = NULL;
+    size_t datagramIndex;
+
+    if (zeroCopy)
+    {
+       for (datagramIndex = 0; datagramIndex < ENET_HOST_RECEIVE_BATCH_SIZE; ++ datagramIndex)
+       {
+          slabs [datagramIndex] = enet_receive_slab_create (bufferSize);
+          if (slabs [datagramIndex] == NULL)
+          {
+             while (datagramIndex > 0)
+               enet_receive_slab_release (slabs [-- datagramIndex]);
+
+             return -1;
+          }
+       }
+    }
+    else
+    {
+       batchData = (enet_uint8 *) enet_malloc (ENET_HOST_RECEIVE_BATCH_SIZE * bufferSize);
+       if (batchData == NULL)
+         return -1;
+    }
+
+    for (datagramIndex = 0; datagramIndex < ENET_HOST_RECEIVE_BATCH_SIZE; ++ datagramIndex)
+    {
+       ENetBuffer * buffer = & host -> receivedBuffers [datagramIndex];
+       enet_uint8 * data = zeroCopy ? ENET_RECEIVE_SLAB_DATA (slabs [datagramIndex]) : & batchData [datagramIndex * bufferSize];
+
+       if (datagramIndex < host -> receivedDatagramCount)
+         memcpy (data, buffer -> data, host -> receivedDatagrams [datagramIndex].dataLength);
+
+       if (host -> receivedSlabs [datagramIndex] != NULL)
+         enet_receive_slab_release (host -> receivedSlabs [datagramIndex]);
+
+       host -> receivedSlabs [datagramIndex] = zeroCopy ? slabs [datagramIndex] : NULL;
+
+       buffer -> data = data;
+       buffer -> dataLength = bufferSize;
+    }
+
+    if (host -> receivedBatchData != NULL)
+      enet_free (host -> receivedBatchData);
+
+    host -> receivedBatchData = batchData;
+    host -> zeroCopyReceive = zeroCopy;
+
+    return 0;
+}
+
+/** Enables or disables UDP segmentation offload for a host.
+    @param host host to adjust
+    @param enable non-zero to enable segmentation offload, 0 to disable it
+    @returns 0 on success, < 0 if segmentation offload is not supported for the host's socket
+    @remarks When enabled, consecutive equally sized datagrams to the same peer, such as the
+    fragments of a large packet, are handed to the kernel as a single buffer (UDP_SEGMENT), and
+    datagrams coalesced by the kernel on receive (UDP_GRO) are split again before being handled.
+    Each receive buffer of the host grows to ENET_HOST_SEGMENT_BUFFER_SIZE bytes to hold them.
+*/
+int
+enet_host_segmentation_offload (ENetHost * host, int enable)
+{
+    if (! enable)
+    {
+       enet_socket_set_option (host -> socket, ENET_SOCKOPT_UDP_GRO, 0);
+
+       host -> segmentationOffload = 0;
+
+       return 0;
+    }
+
+    if (enet_socket_set_option (host -> socket, ENET_SOCKOPT_UDP_GRO, 1) < 0)
+      return -1;
+
+    if (host -> receivedBuffers [0].dataLength < ENET_HOST_SEGMENT_BUFFER_SIZE &&
+        enet_host_setup_receive_buffers (host, ENET_HOST_SEGMENT_BUFFER_SIZE, host -> zeroCopyReceive) < 0)
+    {
+       enet_socket_set_option (host -> socket, ENET_SOCKOPT_UDP_GRO, 0);
+
+       return -1;
+    }
+
+    host -> segmentationOffload = 1;
+
+    return 0;
+}
+
+/** Enables or disables receiving packets in place for a host.
+    @param host host to adjust
+    @param enable non-zero to deliver received packets without copying them, 0 to copy them
+    @returns 0 on success, < 0 on failure
+    @remarks When enabled, each datagram is read into its own reference counted receive slab, and
+    unfragmented packets that arrive in order in an uncompressed datagram point into that slab
+    instead of a copy of it; such packets have ENET_PACKET_FLAG_RECEIVE_SLAB set.  A slab that
+    packets still point into is replaced before the socket is next read, and freed once the last of
+    those packets is destroyed, so received packets should be destroyed promptly.  The reference
+    counts are not atomic, so such packets must be destroyed on the thread servicing the host.
+*/
+int
+enet_host_zero_copy_receive (ENetHost * host, int enable)
+{
+    enable = enable ? 1 : 0;
+    if (enable == host -> zeroCopyReceive)
+      return 0;
+
+    return enet_host_setup_receive_buffers (host, host -> receivedBuffers [0].dataLength, enable);
+}
+
+/** Requires connecting peers to echo a cookie before a host commits any state to them.
+    @param host host to adjust
+    @param secret ENET_HOST_COOKIE_SECRET_SIZE bytes the cookies are keyed with, which should come
+    from a good random source and stay private to the host, or NULL to accept connects directly
+    @remarks A connect without a valid cookie is answered with a cookie bound to the address it came
+    from, its connect ID and the time, and otherwise ignored, so a flood of connects from spoofed
+    addresses neither takes up peers nor scans them.  The connecting peer resends its connect with
+    the cookie echoed, which must arrive within ENET_HOST_COOKIE_LIFETIME milliseconds of the cookie
+    being issued.  Peers built from ENet versions that do not know cookies cannot connect to a host
+    requiring them.
+*/
+void
+enet_host_connect_cookies (ENetHost * host, const enet_uint8 * secret)
+{
+    if (secret == NULL)
+    {
+       host -> connectCookies = 0;
+
+       return;
+    }
+
+    memcpy (host -> cookieSecret, secret, sizeof (host -> cookieSecret));
+    host -> connectCookies = 1;
+}
+
+/** Replaces the receive slabs of a host that delivered packets still point into, so that
+    the next batch of datagrams cannot overwrite them.
+    @returns 0 on success, < 0 on failure
+*/
+int
+enet_host_renew_receive_slabs (ENetHost * host)
+{
+    size_t datagramIndex;
+
+    for (datagramIndex = 0; datagramIndex < ENET_HOST_RECEIVE_BATCH_SIZE; ++ datagramIndex)
+    {
+       ENetReceiveSlab * slab = host -> receivedSlabs [datagramIndex];
+
+       if (slab == NULL || slab -> referenceCount <= 1)
+         continue;
+
+       slab = enet_receive_slab_create (slab -> dataLength);
+       if (slab == NULL)
+         return -1;
+
+       enet_receive_slab_release (host -> receivedSlabs [datagramIndex]);
+
+       host -> receivedSlabs [datagramIndex] = slab;
+       host -> receivedBuffers [datagramIndex].data = ENET_RECEIVE_SLAB_DATA (slab);
+    }
+
+    return 0;
+}
+
+/** Returns the time at which the host next needs to be serviced.
+    @param host host to query
+    @returns a time no later than the earliest of the pending retransmit timeouts, the peers' ping
+    times and the next bandwidth throttle, in the same time base as enet_time_get(); a time no later
+    than the current time is
+    returned if events, received data or outgoing commands are already waiting to be serviced
+    @remarks This lets an external event loop wait on the host's socket until the returned time
+    instead of polling enet_host_service().
+*/
+enet_uint32
+enet_host_next_deadline (ENetHost * host)
+{
+    enet_uint32 deadline = host -> bandwidthThrottleEpoch + ENET_HOST_BANDWIDTH_THROTTLE_INTERVAL;
+
+    if (! enet_list_empty (& host -> dispatchQueue) ||
+        ! enet_list_empty (& host -> serviceQueue) ||
+        host -> receivedDatagramIndex < host -> receivedDatagramCount)
+      return host -> serviceTime;
+
+    return enet_timer_wheel_next_expiry (& host -> timerWheel, deadline);
+}
+
+/** Preallocates outgoing and incoming commands for a host so that bursts of traffic
+    can be queued without going through enet_malloc().
+    @param host host to reserve commands for
+    @param commandCount number of commands of each kind to keep available; the host also keeps
+    up to this many freed commands of each kind for reuse, or ENET_HOST_DEFAULT_COMMAND_POOL_SIZE
+    if that is greater
+    @returns 0 on success, < 0 if the commands could not be allocated
+    @remarks this is typically called right after enet_host_create(); when ENet is built with
+    ENET_NO_POOL commands are always allocated individually and this does nothing
+*/
+int
+enet_host_reserve_commands (ENetHost * host, size_t commandCount)
+{
+#ifndef ENET_NO_POOL
+    host -> commandPoolLimit = ENET_MAX (commandCount, (size_t) ENET_HOST_DEFAULT_COMMAND_POOL_SIZE);
+
+    while (host -> outgoingCommandPoolSize < commandCount)
+    {
+        ENetOutgoingCommand * outgoingCommand = (ENetOutgoingCommand *) enet_malloc (sizeof (ENetOutgoingCommand));
+        if (outgoingCommand == NULL)
+          return -1;
+
+        enet_list_insert (enet_list_begin (& host -> outgoingCommandPool), outgoingCommand);
+        ++ host -> outgoingCommandPoolSize;
+    }
+
+    while (host -> incomingCommandPoolSize < commandCount)
+    {
+        ENetIncomingCommand * incomingCommand = (ENetIncomingCommand *) enet_malloc (sizeof (ENetIncomingCommand));
+        if (incomingCommand == NULL)
+          return -1;
+
+        enet_list_insert (enet_list_begin (& host -> incomingCommandPool), incomingCommand);
+        ++ host -> incomingCommandPoolSize;
+    }
+#else
+    (void) host;
+    (void) commandCount;
+#endif
+
+    return 0;
+}
+
+ENetOutgoingCommand *
+enet_host_allocate_outgoing_command (ENetHost * host)
+{
+#ifndef ENET_NO_POOL
+    if (! enet_list_empty (& host -> outgoingCommandPool))
+    {
+        ++ host -> totalCommandPoolHits;
+        -- host -> outgoingCommandPoolSize;
+
+        return (ENetOutgoingCommand *) enet_list_remove (enet_list_begin (& host -> outgoingCommandPool));
+    }
+#endif
+
+    ++ host -> totalCommandPoolMisses;
+
+    return (ENetOutgoingCommand *) enet_malloc (sizeof (ENetOutgoingCommand));
+}
+
+void
+enet_host_free_outgoing_command (ENetHost * host, ENetOutgoingCommand * outgoingCommand)
+{
+#ifndef ENET_NO_POOL
+    if (host -> outgoingCommandPoolSize < host -> commandPoolLimit)
+    {
+        enet_list_insert (enet_list_begin (& host -> outgoingCommandPool), outgoingCommand);
+        ++ host -> outgoingCommandPoolSize;
+
+        return;
+    }
+#else
+    (void) host;
+#endif
+
+    enet_free (outgoingCommand);
+}
+
+ENetIncomingCommand *
+enet_host_allocate_incoming_command (ENetHost * host)
+{
+#ifndef ENET_NO_POOL
+    if (! enet_list_empty (& host -> incomingCommandPool))
+    {
+        ++ host -> totalCommandPoolHits;
+        -- host -> incomingCommandPoolSize;
+
+        return (ENetIncomingCommand *) enet_list_remove (enet_list_begin (& host -> incomingCommandPool));
+    }
+#endif
+
+    ++ host -> totalCommandPoolMisses;
+
+    return (ENetIncomingCommand *) enet_malloc (sizeof (ENetIncomingCommand));
+}
+
+void
+enet_host_free_incoming_command (ENetHost * host, ENetIncomingCommand * incomingCommand)
+{
+#ifndef ENET_NO_POOL
+    if (host -> incomingCommandPoolSize < host -> commandPoolLimit)
+    {
+        enet_list_insert (enet_list_begin (& host -> incomingCommandPool), incomingCommand);
+        ++ host -> incomingCommandPoolSize;
+
+        return;
+    }
+#else
+    (void) host;
+#endif
+
+    enet_free (incomingCommand);
+}
+
+/** Returns the bucket of a host's peers in use whose foreign host may have the given IP address. */
+ENetList *
+enet_host_address_bucket (ENetHost * host, enet_uint32 address)
+{
+    /* Hash in host order, so that the last octet, which tells apart the hosts of a local network,
+       reaches the bits of the product that pick the bucket. */
+    return & host -> addressBuckets [((ENET_NET_TO_HOST_32 (address) * 2654435761U) >> 16) & host -> addressBucketMask];
+}
+
+/** Takes the most recently freed peer of a host for a connection to the given address.
+    @remarks the host must have a free peer, which the caller must then move out of the
+    ENET_PEER_STATE_DISCONNECTED state
+*/
+ENetPeer *
+enet_host_allocate_peer (ENetHost * host, const ENetAddress * address)
+{
+    ENetPeer * peer = (ENetPeer *) ((enet_uint8 *) enet_list_remove (enet_list_begin (& host -> freePeers)) - (size_t) & ((ENetPeer *) 0) -> freeList);
+
+    peer -> address = * address;
+
+    enet_list_insert (enet_list_end (enet_host_address_bucket (host, address -> host)), & peer -> addressList);
+
+    return peer;
+}
+
+/** Returns a peer that is leaving the ENET_PEER_STATE_DISCONNECTED state to its host's free peers. */
+void
+enet_host_free_peer (ENetHost * host, ENetPeer * peer)
+{
+    enet_list_remove (& peer -> addressList);
+
+    enet_list_insert (enet_list_begin (& host -> freePeers), & peer -> freeList);
+}
+
+/** Changes the address of a peer in use, moving it to the bucket of its new IP address if needed. */
+void
+enet_host_set_peer_address (ENetHost * host, ENetPeer * peer, const ENetAddress * address)
+{
+    if (peer -> address.host != address -> host)
+    {
+       enet_list_remove (& peer -> addressList);
+
+       enet_list_insert (enet_list_end (enet_host_address_bucket (host, address -> host)), & peer -> addressList);
+    }
+
+    peer -> address = * address;
+}
+
 /** Adjusts the bandwidth limits of a host.
     @param host host to adjust
     @param incomingBandwidth new incoming bandwidth
@@ -21,6 +21,7 @@ extern "C"
 #include "enet/types.h"
 #include "enet/protocol.h"
 #include "enet/list.h"
+#include "enet/timer.h"
 #include "enet/callbacks.h"
 
 #define ENET_VERSION_MAJOR 1
@@ -62,7 +63,10 @@ typedef enum _ENetSocketOption
    ENET_SOCKOPT_RCVTIMEO  = 6,
    ENET_SOCKOPT_SNDTIMEO  = 7,
    ENET_SOCKOPT_ERROR     = 8,
-   ENET_SOCKOPT_NODELAY   = 9
+   ENET_SOCKOPT_NODELAY   = 9,
+   ENET_SOCKOPT_UDP_GRO   = 10,
+   ENET_SOCKOPT_MULTICAST_TTL   = 11,
+   ENET_SOCKOPT_MULTICAST_LOOP  = 12
 } ENetSocketOption;
 
 typedef enum _ENetSocketShutdown
@@ -92,6 +96,35 @@ typedef struct _ENetAddress
    enet_uint16 port;
 } ENetAddress;
 
+/**
+ * A single datagram for the batched socket functions.
+ *
+ * On receive, buffers describes where the datagram should be stored and
+ * address and dataLength are filled in with its source and size.  On send,
+ * address is the destination and dataLength is filled in with the number of
+ * bytes sent, or 0 if the datagram was dropped or, after a failure, not sent.
+ *
+ * A non-zero segmentSize means the datagram holds several UDP datagrams of
+ * segmentSize bytes each, back to back, with only the last one allowed to be
+ * shorter.  On send the kernel splits it (UDP_SEGMENT); on receive it was
+ * coalesced by the kernel (UDP_GRO) and must be split by the caller.
+ *
+ * enet_socket_send_batch() adds the number of system calls it made to its
+ * last argument, if that is not NULL, as platforms without sendmmsg need one
+ * per datagram.
+
+   @sa enet_socket_send_batch()
+   @sa enet_socket_receive_batch()
+*/
+typedef struct _ENetDatagram
+{
+   ENetAddress  address;
+   ENetBuffer * buffers;
+   size_t       bufferCount;
+   size_t       dataLength;
+   size_t       segmentSize;
+} ENetDatagram;
+
 /**
  * Packet flag bit constants.
  *
@@ -115,6 +148,9 @@ typedef enum _ENetPacketFlag
    /** packet will be fragmented using unreliable (instead of reliable) sends
      * if it exceeds the MTU */
    ENET_PACKET_FLAG_UNRELIABLE_FRAGMENT = (1 << 3),
+   /** packet data points into a receive slab of the host that received it,
+     * see enet_host_zero_copy_receive() */
+   ENET_PACKET_FLAG_RECEIVE_SLAB = (1 << 4),
 
    /** whether the packet has been sent from all queues it has been entered into */
    ENET_PACKET_FLAG_SENT = (1<<8)
@@ -122,6 +158,21 @@ typedef enum _ENetPacketFlag
 
 typedef void (ENET_CALLBACK * ENetPacketFreeCallback) (struct _ENetPacket *);
 
+#ifndef ENET_PACKET_INLINE_DATA_MAXIMUM
+/** payloads of at most this many bytes are stored in the same allocation as their packet */
+#define ENET_PACKET_INLINE_DATA_MAXIMUM 1024
+#endif
+
+/** A reference counted receive buffer of a host, followed by its data. Packets received
+    in place hold a reference to the slab their data points into, and the slab is freed
+    once the host and all such packets have released it.
+*/
+typedef struct _ENetReceiveSlab
+{
+   size_t referenceCount;
+   size_t dataLength;
+} ENetReceiveSlab;
+
 /**
  * ENet packet structure.
  *
@@ -138,6 +189,8 @@ typedef void (ENET_CALLBACK * ENetPacketFreeCallback) (struct _ENetPacket *);
  *    (not supported for reliable packets)
  *
  *    ENET_PACKET_FLAG_NO_ALLOCATE - packet will not allocate data, and user must supply it instead
+ *
+ *    ENET_PACKET_FLAG_RECEIVE_SLAB - packet data points into the datagram it was received in
  
    @sa ENetPacketFlag
  */
@@ -156,19 +209,30 @@ typedef struct _ENetAcknowledgement
    ENetListNode acknowledgementList;
    enet_uint32  sentTime;
    ENetProtocol command;
+   enet_uint32  receivedMask;         /**< later commands on the channel acknowledged along with this one, see ENetProtocolSelectiveAcknowledge */
 } ENetAcknowledgement;
 
+typedef enum _ENetTimerType
+{
+   ENET_TIMER_TYPE_PING       = 1,    /**< ENetPeer::pingTimer, the timer data is the peer */
+   ENET_TIMER_TYPE_RETRANSMIT = 2,    /**< ENetOutgoingCommand::retransmitTimer, the timer data is the peer */
+   ENET_TIMER_TYPE_PACING     = 3     /**< ENetPeer::pacingTimer, the timer data is the peer */
+} ENetTimerType;
+
 typedef struct _ENetOutgoingCommand
 {
    ENetListNode outgoingCommandList;
+   ENetTimer    retransmitTimer;
    enet_uint16  reliableSequenceNumber;
    enet_uint16  unreliableSequenceNumber;
    enet_uint32  sentTime;
+   enet_uint32  sentTimeMicroseconds;  /**< enet_time_get_microseconds() at the command's last send, for round trip time samples */
    enet_uint32  roundTripTimeout;
    enet_uint32  roundTripTimeoutLimit;
    enet_uint32  fragmentOffset;
    enet_uint16  fragmentLength;
    enet_uint16  sendAttempts;
+   enet_uint32  sendNumber;           /**< order of the command's last send among the peer's reliable sends */
    ENetProtocol command;
    ENetPacket * packet;
 } ENetOutgoingCommand;
@@ -207,10 +271,19 @@ enum
 {
    ENET_HOST_RECEIVE_BUFFER_SIZE          = 256 * 1024,
    ENET_HOST_SEND_BUFFER_SIZE             = 256 * 1024,
+   ENET_HOST_RECEIVE_BATCH_SIZE           = 32,
+   ENET_HOST_SEND_BATCH_SIZE              = 32,
+   ENET_HOST_SEGMENT_BUFFER_SIZE          = 64 * 1024,
+   ENET_HOST_SEGMENT_MAXIMUM_SIZE         = 65507,
+   ENET_HOST_SEGMENT_MAXIMUM_COUNT        = 64,
+   ENET_HOST_SEGMENT_MAXIMUM_BUFFERS      = 1024,
    ENET_HOST_BANDWIDTH_THROTTLE_INTERVAL  = 1000,
    ENET_HOST_DEFAULT_MTU                  = 1400,
    ENET_HOST_DEFAULT_MAXIMUM_PACKET_SIZE  = 32 * 1024 * 1024,
    ENET_HOST_DEFAULT_MAXIMUM_WAITING_DATA = 32 * 1024 * 1024,
+   ENET_HOST_DEFAULT_COMMAND_POOL_SIZE    = 256,
+   ENET_HOST_COOKIE_SECRET_SIZE           = 8,
+   ENET_HOST_COOKIE_LIFETIME              = 10000,
 
    ENET_PEER_DEFAULT_ROUND_TRIP_TIME      = 500,
    ENET_PEER_DEFAULT_PACKET_THROTTLE      = 32,
@@ -226,12 +299,16 @@ enum
    ENET_PEER_TIMEOUT_MINIMUM              = 5000,
    ENET_PEER_TIMEOUT_MAXIMUM              = 30000,
    ENET_PEER_PING_INTERVAL                = 500,
+   ENET_PEER_FAST_RETRANSMIT_THRESHOLD    = 3,
    ENET_PEER_UNSEQUENCED_WINDOWS          = 64,
    ENET_PEER_UNSEQUENCED_WINDOW_SIZE      = 1024,
    ENET_PEER_FREE_UNSEQUENCED_WINDOWS     = 32,
    ENET_PEER_RELIABLE_WINDOWS             = 16,
    ENET_PEER_RELIABLE_WINDOW_SIZE         = 0x1000,
-   ENET_PEER_FREE_RELIABLE_WINDOWS        = 8
+   ENET_PEER_FREE_RELIABLE_WINDOWS        = 8,
+   ENET_PEER_INCOMING_RELIABLE_RING_SIZE  = 16,
+   ENET_PEER_SENT_RELIABLE_RING_SIZE      = 32,
+   ENET_PEER_PACING_CATCH_UP_TIME         = 20000
 };
 
 typedef struct _ENetChannel
@@ -242,7 +319,11 @@ typedef struct _ENetChannel
    enet_uint16  reliableWindows [ENET_PEER_RELIABLE_WINDOWS];
    enet_uint16  incomingReliableSequenceNumber;
    enet_uint16  incomingUnreliableSequenceNumber;
-   ENetList     incomingReliableCommands;
+   ENetIncomingCommand ** incomingReliableRing;  /**< reliable commands waiting to be dispatched, indexed by sequence number modulo the ring size */
+   enet_uint16  incomingReliableRingMask;
+   size_t       incomingReliableCount;
+   ENetOutgoingCommand ** sentReliableRing;  /**< reliable commands sent and not yet acknowledged, indexed by sequence number modulo the ring size */
+   enet_uint16  sentReliableRingMask;
    ENetList     incomingUnreliableCommands;
 } ENetChannel;
 
@@ -273,7 +354,6 @@ typedef struct _ENetPeer
    enet_uint32   outgoingDataTotal;
    enet_uint32   lastSendTime;
    enet_uint32   lastReceiveTime;
-   enet_uint32   nextTimeout;
    enet_uint32   earliestTimeout;
    enet_uint32   packetLossEpoch;
    enet_uint32   packetsSent;
@@ -297,14 +377,23 @@ typedef struct _ENetPeer
    enet_uint32   highestRoundTripTimeVariance;
    enet_uint32   roundTripTime;            /**< mean round trip time (RTT), in milliseconds, between sending a reliable packet and receiving its acknowledgement */
    enet_uint32   roundTripTimeVariance;
+   enet_uint32   roundTripTimeMicroseconds;          /**< mean round trip time in microseconds, which roundTripTime is rounded from */
+   enet_uint32   roundTripTimeVarianceMicroseconds;
+   enet_uint32   lastRoundTripTimeMicroseconds;      /**< the throttle's statistics in microseconds; internal, the fields without the suffix are rounded from them */
+   enet_uint32   lowestRoundTripTimeMicroseconds;
+   enet_uint32   lastRoundTripTimeVarianceMicroseconds;
+   enet_uint32   highestRoundTripTimeVarianceMicroseconds;
    enet_uint32   mtu;
    enet_uint32   windowSize;
    enet_uint32   reliableDataInTransit;
+   enet_uint32   reliableSendNumber;       /**< number given to the next reliable send */
+   enet_uint32   acknowledgedSendNumber;   /**< latest reliable send acknowledged, see ENET_PEER_FAST_RETRANSMIT_THRESHOLD */
    enet_uint16   outgoingReliableSequenceNumber;
    ENetList      acknowledgements;
    ENetList      sentReliableCommands;
    ENetList      sentUnreliableCommands;
    ENetList      outgoingReliableCommands;
+   ENetOutgoingCommand * lastQueuedResend;  /**< last of the lost commands waiting at the head of outgoingReliableCommands to be resent, or NULL if there are none */
    ENetList      outgoingUnreliableCommands;
    ENetList      dispatchedCommands;
    int           needsDispatch;
@@ -313,6 +402,19 @@ typedef struct _ENetPeer
    enet_uint32   unsequencedWindow [ENET_PEER_UNSEQUENCED_WINDOW_SIZE / 32]; 
    enet_uint32   eventData;
    size_t        totalWaitingData;
+   ENetTimer     pingTimer;
+   ENetTimer     pacingTimer;              /**< wakes the peer once its pacing allows it to send again */
+   enet_uint32   pacingTime;               /**< enet_time_get_microseconds() when the peer was last given pacing credit */
+   int           pacingCredit;             /**< bytes the peer may still send at its pacing rate; negative once it has sent ahead */
+   int           pacingHeld;               /**< whether the peer had more to send when it last ran out of pacing credit */
+   ENetListNode  serviceList;
+   int           needsService;
+   ENetOutgoingCommand ** sentReliableRing;  /**< sent reliable commands not on any channel, such as connects and pings, awaiting acknowledgement */
+   enet_uint16   sentReliableRingMask;
+   ENetListNode  freeList;            /**< node in the host's free peers while disconnected */
+   ENetListNode  addressList;         /**< node in the host's address bucket for the peer otherwise */
+   ENetProtocolCookie connectCookie;  /**< cookie to echo with the connect, if the foreign host sent one; its command is ENET_PROTOCOL_COMMAND_NONE otherwise */
+   int           selectiveAcknowledgements;  /**< whether the foreign host accepts selective acknowledgements */
 } ENetPeer;
 
 /** An ENet packet compressor for compressing UDP packets before socket sends or receives.
@@ -329,12 +431,44 @@ typedef struct _ENetCompressor
    void (ENET_CALLBACK * destroy) (void * context);
 } ENetCompressor;
 
+/** Congestion control deciding how much reliable data may be in transit to each of a host's peers,
+    and how fast datagrams are sent to them.
+ */
+typedef struct _ENetCongestionControl
+{
+   /** Context data for the congestion control. */
+   void * context;
+   /** Forgets anything kept about a peer when it is reset. May be NULL. */
+   void (ENET_CALLBACK * reset) (void * context, ENetPeer * peer);
+   /** Notes that bytes of reliable data were sent to the peer. May be NULL. */
+   void (ENET_CALLBACK * onSend) (void * context, ENetPeer * peer, enet_uint32 bytes);
+   /** Notes that the peer acknowledged bytes of reliable data, with a round trip time in microseconds sampled from the acknowledgement. May be NULL. */
+   void (ENET_CALLBACK * onAcknowledge) (void * context, ENetPeer * peer, enet_uint32 bytes, enet_uint32 roundTripTime);
+   /** Notes that bytes of reliable data sent to the peer were lost and will be resent. May be NULL. */
+   void (ENET_CALLBACK * onLoss) (void * context, ENetPeer * peer, enet_uint32 bytes);
+   /** Returns how many bytes of reliable data may be in transit to the peer. May be NULL, leaving only the peer's window size. */
+   enet_uint32 (ENET_CALLBACK * congestionWindow) (void * context, ENetPeer * peer);
+   /** Returns the rate in bytes per second at which to pace datagrams to the peer, or 0 to send them as soon as they are ready. May be NULL. */
+   enet_uint32 (ENET_CALLBACK * pacingRate) (void * context, ENetPeer * peer);
+   /** Destroys the context when the congestion control is replaced or the host is destroyed. May be NULL. */
+   void (ENET_CALLBACK * destroy) (void * context);
+} ENetCongestionControl;
+
 /** Callback that computes the checksum of the data held in buffers[0:bufferCount-1] */
 typedef enet_uint32 (ENET_CALLBACK * ENetChecksumCallback) (const ENetBuffer * buffers, size_t bufferCount);
 
 /** Callback for intercepting received raw UDP packets. Should return 1 to intercept, 0 to ignore, or -1 to propagate an error. */
 typedef int (ENET_CALLBACK * ENetInterceptCallback) (struct _ENetHost * host, struct _ENetEvent * event);
  
+/** Storage for a datagram built for a peer that is waiting in the host's send batch. */
+typedef struct _ENetOutgoingDatagram
+{
+   struct _ENetPeer * peer;
+   enet_uint8         headerData [sizeof (ENetProtocolHeader) + sizeof (enet_uint32)];
+   ENetProtocol       commands [ENET_PROTOCOL_MAXIMUM_PACKET_COMMANDS];
+   enet_uint8         compressedData [ENET_PROTOCOL_MAXIMUM_MTU];
+} ENetOutgoingDatagram;
+
 /** An ENet host for communicating with peers.
   *
   * No fields should be modified unless otherwise stated.
@@ -347,9 +481,16 @@ typedef int (ENET_CALLBACK * ENetInterceptCallback) (struct _ENetHost * host, st
     @sa enet_host_broadcast()
     @sa enet_host_compress()
     @sa enet_host_compress_with_range_coder()
+    @sa enet_host_congestion_control()
+    @sa enet_host_congestion_control_with_bbr()
     @sa enet_host_channel_limit()
     @sa enet_host_bandwidth_limit()
     @sa enet_host_bandwidth_throttle()
+    @sa enet_host_segmentation_offload()
+    @sa enet_host_next_deadline()
+    @sa enet_host_reserve_commands()
+    @sa enet_host_zero_copy_receive()
+    @sa enet_host_connect_cookies()
   */
 typedef struct _ENetHost
 {
@@ -363,8 +504,12 @@ typedef struct _ENetHost
    int                  recalculateBandwidthLimits;
    ENetPeer *           peers;                       /**< array of peers allocated for this host */
    size_t               peerCount;                   /**< number of peers allocated for this host */
+   ENetList             freePeers;                   /**< disconnected peers, most recently freed first */
+   ENetList *           addressBuckets;              /**< peers in use, hashed by the IP address of their foreign host */
+   size_t               addressBucketMask;
    size_t               channelLimit;                /**< maximum number of channels allowed for connected peers */
    enet_uint32          serviceTime;
+   enet_uint32          serviceTimeMicroseconds;     /**< enet_time_get_microseconds() when serviceTime was last read */
    ENetList             dispatchQueue;
    int                  continueSending;
    size_t               packetSize;
@@ -375,14 +520,44 @@ typedef struct _ENetHost
    size_t               bufferCount;
    ENetChecksumCallback checksum;                    /**< callback the user can set to enable packet checksums for this host */
    ENetCompressor       compressor;
+   ENetCongestionControl congestionControl;
    enet_uint8           packetData [2][ENET_PROTOCOL_MAXIMUM_MTU];
    ENetAddress          receivedAddress;
    enet_uint8 *         receivedData;
    size_t               receivedDataLength;
+   ENetDatagram         receivedDatagrams [ENET_HOST_RECEIVE_BATCH_SIZE];
+   ENetBuffer           receivedBuffers [ENET_HOST_RECEIVE_BATCH_SIZE];
+   enet_uint8 *         receivedBatchData;
+   size_t               receivedDatagramCount;
+   size_t               receivedDatagramIndex;
+   size_t               receivedSegmentOffset;
+   ENetReceiveSlab *    receivedSlabs [ENET_HOST_RECEIVE_BATCH_SIZE];
+   ENetReceiveSlab *    receivedSlab;                /**< slab holding receivedData, or NULL if it must be copied */
+   ENetDatagram         sendDatagrams [ENET_HOST_SEND_BATCH_SIZE];
+   size_t               sendDatagramCount;
+   ENetBuffer *         sendBuffers;
+   size_t               sendBufferCount;
+   ENetOutgoingDatagram * outgoingDatagrams;
+   size_t               outgoingDatagramCount;
+   int                  segmentationOffload;         /**< whether UDP segmentation offload is enabled, see enet_host_segmentation_offload() */
+   int                  zeroCopyReceive;             /**< whether packets are received in place, see enet_host_zero_copy_receive() */
+   int                  connectCookies;              /**< whether connects must echo a cookie, see enet_host_connect_cookies() */
+   enet_uint32          cookieSecret [ENET_HOST_COOKIE_SECRET_SIZE / 4];
+   ENetTimerWheel       timerWheel;                  /**< retransmit timeouts of sent reliable commands and ping times of peers */
+   ENetList             serviceQueue;                /**< peers with acknowledgements or commands to send, or whose deadline has passed */
+   ENetList             outgoingCommandPool;
+   size_t               outgoingCommandPoolSize;
+   ENetList             incomingCommandPool;
+   size_t               incomingCommandPoolSize;
+   size_t               commandPoolLimit;            /**< number of freed commands of each kind kept for reuse, see enet_host_reserve_commands() */
    enet_uint32          totalSentData;               /**< total data sent, user should reset to 0 as needed to prevent overflow */
    enet_uint32          totalSentPackets;            /**< total UDP packets sent, user should reset to 0 as needed to prevent overflow */
    enet_uint32          totalReceivedData;           /**< total data received, user should reset to 0 as needed to prevent overflow */
    enet_uint32          totalReceivedPackets;        /**< total UDP packets received, user should reset to 0 as needed to prevent overflow */
+   enet_uint32          totalSendCalls;              /**< total system calls made to send, user should reset to 0 as needed to prevent overflow */
+   enet_uint32          totalReceiveCalls;           /**< total system calls made to receive, user should reset to 0 as needed to prevent overflow */
+   enet_uint32          totalCommandPoolHits;        /**< total commands taken from the host's pools, user should reset to 0 as needed to prevent overflow */
+   enet_uint32          totalCommandPoolMisses;      /**< total commands that had to be allocated, user should reset to 0 as needed to prevent overflow */
    ENetInterceptCallback intercept;                  /**< callback the user can set to intercept received raw UDP packets */
    size_t               connectedPeers;
    size_t               bandwidthLimitedPeers;
@@ -436,6 +611,33 @@ typedef struct _ENetEvent
    ENetPacket *         packet;    /**< packet associated with the event, if appropriate */
 } ENetEvent;
 
+typedef struct _ENetGroupMember
+{
+   enet_uint32 connectID;          /**< connection the peer was added on, so a reused peer is not mistaken for it */
+   enet_uint16 peerIndex;
+} ENetGroupMember;
+
+/**
+ * A set of connected peers of a host that packets may be broadcast to.
+ *
+ * Members are kept as a compact array of peer indices, so broadcasting to a
+ * group only visits its members rather than every peer of the host. Peers
+ * that have since disconnected are dropped from the group on its next broadcast.
+
+   @sa enet_group_create()
+   @sa enet_group_destroy()
+   @sa enet_group_add_peer()
+   @sa enet_group_remove_peer()
+   @sa enet_group_broadcast()
+ */
+typedef struct _ENetGroup
+{
+   ENetHost *           host;
+   ENetGroupMember *    members;
+   size_t               memberCount;    /**< number of peers in the group */
+   size_t               memberCapacity;
+} ENetGroup;
+
 /** @defgroup global ENet global functions
     @{ 
 */
@@ -473,14 +675,19 @@ ENET_API ENetVersion enet_linked_version (void);
 /** @defgroup private ENet private implementation functions */
 
 /**
-  Returns the wall-time in milliseconds.  Its initial value is unspecified
-  unless otherwise set.
+  Returns the time in milliseconds, read from a monotonic clock where the platform
+  has one.  Its initial value is unspecified unless otherwise set.
   */
 ENET_API enet_uint32 enet_time_get (void);
 /**
   Sets the current wall-time in milliseconds.
   */
 ENET_API void enet_time_set (enet_uint32);
+/**
+  Returns a monotonic time in microseconds.  It wraps around about every 71 minutes
+  and is only meaningful as the difference between two readings.
+  */
+ENET_API enet_uint32 enet_time_get_microseconds (void);
 
 /** @defgroup socket ENet socket functions
     @{
@@ -493,9 +700,13 @@ ENET_API ENetSocket enet_socket_accept (ENetSocket, ENetAddress *);
 ENET_API int        enet_socket_connect (ENetSocket, const ENetAddress *);
 ENET_API int        enet_socket_send (ENetSocket, const ENetAddress *, ENetBuffer *, size_t);
 ENET_API int        enet_socket_receive (ENetSocket, ENetAddress *, ENetBuffer *, size_t);
+ENET_API int        enet_socket_send_batch (ENetSocket, ENetDatagram *, size_t, enet_uint32 *);
+ENET_API int        enet_socket_receive_batch (ENetSocket, ENetDatagram *, size_t);
 ENET_API int        enet_socket_wait (ENetSocket, enet_uint32 *, enet_uint32);
 ENET_API int        enet_socket_set_option (ENetSocket, ENetSocketOption, int);
 ENET_API int        enet_socket_get_option (ENetSocket, ENetSocketOption, int *);
+ENET_API int        enet_socket_join_multicast (ENetSocket, const ENetAddress *);
+ENET_API int        enet_socket_leave_multicast (ENetSocket, const ENetAddress *);
 ENET_API int        enet_socket_shutdown (ENetSocket, ENetSocketShutdown);
 ENET_API void       enet_socket_destroy (ENetSocket);
 ENET_API int        enet_socketset_select (ENetSocket, ENetSocketSet *, ENetSocketSet *, enet_uint32);
@@ -541,6 +752,9 @@ ENET_API ENetPacket * enet_packet_create (void *, size_t, enet_uint32);
 ENET_API void         enet_packet_destroy (ENetPacket *);
 ENET_API int          enet_packet_resize  (ENetPacket *, size_t);
 ENET_API enet_uint32  enet_crc32 (const ENetBuffer *, size_t);
+extern ENetPacket *      enet_packet_create_in_slab (ENetReceiveSlab *, void *, size_t, enet_uint32);
+extern ENetReceiveSlab * enet_receive_slab_create (size_t);
+extern void              enet_receive_slab_release (ENetReceiveSlab *);
                 
 ENET_API ENetHost * enet_host_create (const ENetAddress *, size_t, size_t, enet_uint32, enet_uint32);
 ENET_API void       enet_host_destroy (ENetHost *);
@@ -551,12 +765,30 @@ ENET_API void       enet_host_flush (ENetHost *);
 ENET_API void       enet_host_broadcast (ENetHost *, enet_uint8, ENetPacket *);
 ENET_API void       enet_host_compress (ENetHost *, const ENetCompressor *);
 ENET_API int        enet_host_compress_with_range_coder (ENetHost * host);
+ENET_API void       enet_host_congestion_control (ENetHost *, const ENetCongestionControl *);
+ENET_API int        enet_host_congestion_control_with_bbr (ENetHost *);
 ENET_API void       enet_host_channel_limit (ENetHost *, size_t);
 ENET_API void       enet_host_bandwidth_limit (ENetHost *, enet_uint32, enet_uint32);
+ENET_API int        enet_host_segmentation_offload (ENetHost *, int);
+ENET_API enet_uint32 enet_host_next_deadline (ENetHost *);
+ENET_API int        enet_host_reserve_commands (ENetHost *, size_t);
+ENET_API int        enet_host_zero_copy_receive (ENetHost *, int);
+ENET_API void       enet_host_connect_cookies (ENetHost *, const enet_uint8 *);
+extern   int        enet_host_renew_receive_slabs (ENetHost *);
 extern   void       enet_host_bandwidth_throttle (ENetHost *);
 extern  enet_uint32 enet_host_random_seed (void);
+extern ENetPeer *            enet_host_allocate_peer (ENetHost *, const ENetAddress *);
+extern void                  enet_host_free_peer (ENetHost *, ENetPeer *);
+extern void                  enet_host_set_peer_address (ENetHost *, ENetPeer *, const ENetAddress *);
+extern ENetList *            enet_host_address_bucket (ENetHost *, enet_uint32);
+extern ENetOutgoingCommand * enet_host_allocate_outgoing_command (ENetHost *);
+extern void                  enet_host_free_outgoing_command (ENetHost *, ENetOutgoingCommand *);
+extern ENetIncomingCommand * enet_host_allocate_incoming_command (ENetHost *);
+extern void                  enet_host_free_incoming_command (ENetHost *, ENetIncomingCommand *);
 
 ENET_API int                 enet_peer_send (ENetPeer *, enet_uint8, ENetPacket *);
+extern void                  enet_peer_setup_send_command (ENetProtocol *, enet_uint8, ENetPacket *);
+extern int                   enet_peer_send_command (ENetPeer *, enet_uint8, ENetPacket *, const ENetProtocol *);
 ENET_API ENetPacket *        enet_peer_receive (ENetPeer *, enet_uint8 * channelID);
 ENET_API void                enet_peer_ping (ENetPeer *);
 ENET_API void                enet_peer_ping_interval (ENetPeer *, enet_uint32);
@@ -574,8 +806,21 @@ extern ENetIncomingCommand * enet_peer_queue_incoming_command (ENetPeer *, const
 extern ENetAcknowledgement * enet_peer_queue_acknowledgement (ENetPeer *, const ENetProtocol *, enet_uint16);
 extern void                  enet_peer_dispatch_incoming_unreliable_commands (ENetPeer *, ENetChannel *);
 extern void                  enet_peer_dispatch_incoming_reliable_commands (ENetPeer *, ENetChannel *);
+extern ENetIncomingCommand * enet_peer_find_incoming_reliable_command (ENetChannel *, enet_uint16);
+extern int                   enet_peer_index_sent_reliable_command (ENetPeer *, ENetOutgoingCommand *);
+extern ENetOutgoingCommand * enet_peer_unindex_sent_reliable_command (ENetPeer *, enet_uint16, enet_uint8);
 extern void                  enet_peer_on_connect (ENetPeer *);
 extern void                  enet_peer_on_disconnect (ENetPeer *);
+extern void                  enet_peer_schedule_ping (ENetPeer *);
+extern void                  enet_peer_activate (ENetPeer *);
+
+extern void                  enet_congestion_control_throttle (ENetCongestionControl *);
+
+ENET_API ENetGroup * enet_group_create (ENetHost *);
+ENET_API void        enet_group_destroy (ENetGroup *);
+ENET_API int         enet_group_add_peer (ENetGroup *, ENetPeer *);
+ENET_API void        enet_group_remove_peer (ENetGroup *, ENetPeer *);
+ENET_API void        enet_group_broadcast (ENetGroup *, enet_uint8, ENetPacket *);
 
 ENET_API void * enet_range_coder_create (void);
 ENET_API void   enet_range_coder_destroy (void *);
@@ -35,7 +35,9 @@ typedef enum _ENetProtocolCommand
    ENET_PROTOCOL_COMMAND_BANDWIDTH_LIMIT    = 10,
    ENET_PROTOCOL_COMMAND_THROTTLE_CONFIGURE = 11,
    ENET_PROTOCOL_COMMAND_SEND_UNRELIABLE_FRAGMENT = 12,
-   ENET_PROTOCOL_COMMAND_COUNT              = 13,
+   ENET_PROTOCOL_COMMAND_COOKIE             = 13,
+   ENET_PROTOCOL_COMMAND_SELECTIVE_ACKNOWLEDGE = 14,
+   ENET_PROTOCOL_COMMAND_COUNT              = 15,
 
    ENET_PROTOCOL_COMMAND_MASK               = 0x0F
 } ENetProtocolCommand;
@@ -44,6 +46,9 @@ typedef enum _ENetProtocolFlag
 {
    ENET_PROTOCOL_COMMAND_FLAG_ACKNOWLEDGE = (1 << 7),
    ENET_PROTOCOL_COMMAND_FLAG_UNSEQUENCED = (1 << 6),
+   /* Set on a connect or verify connect by a peer that accepts selective acknowledgements;
+      older peers mask it off with the command number. */
+   ENET_PROTOCOL_COMMAND_FLAG_SELECTIVE_ACKNOWLEDGE = (1 << 5),
 
    ENET_PROTOCOL_HEADER_FLAG_COMPRESSED = (1 << 14),
    ENET_PROTOCOL_HEADER_FLAG_SENT_TIME  = (1 << 15),
@@ -82,6 +87,16 @@ typedef struct _ENetProtocolAcknowledge
    enet_uint16 receivedSentTime;
 } ENET_PACKED ENetProtocolAcknowledge;
 
+/** Acknowledges receivedReliableSequenceNumber and, for each bit n set in receivedMask, the
+    reliable command n + 1 after it on the same channel. */
+typedef struct _ENetProtocolSelectiveAcknowledge
+{
+   ENetProtocolCommandHeader header;
+   enet_uint16 receivedReliableSequenceNumber;
+   enet_uint16 receivedSentTime;
+   enet_uint32 receivedMask;
+} ENET_PACKED ENetProtocolSelectiveAcknowledge;
+
 typedef struct _ENetProtocolConnect
 {
    ENetProtocolCommandHeader header;
@@ -117,6 +132,16 @@ typedef struct _ENetProtocolVerifyConnect
    enet_uint32 connectID;
 } ENET_PACKED ENetProtocolVerifyConnect;
 
+/** Sent by a host requiring connect cookies in reply to a connect without a valid one, and
+    echoed by the connecting peer ahead of its connect in the same datagram. */
+typedef struct _ENetProtocolCookie
+{
+   ENetProtocolCommandHeader header;
+   enet_uint32 connectID;
+   enet_uint32 timestamp;
+   enet_uint32 mac;
+} ENET_PACKED ENetProtocolCookie;
+
 typedef struct _ENetProtocolBandwidthLimit
 {
    ENetProtocolCommandHeader header;
@@ -178,6 +203,7 @@ typedef union _ENetProtocol
 {
    ENetProtocolCommandHeader header;
    ENetProtocolAcknowledge acknowledge;
+   ENetProtocolSelectiveAcknowledge selectiveAcknowledge;
    ENetProtocolConnect connect;
    ENetProtocolVerifyConnect verifyConnect;
    ENetProtocolDisconnect disconnect;
@@ -188,6 +214,7 @@ typedef union _ENetProtocol
    ENetProtocolSendFragment sendFragment;
    ENetProtocolBandwidthLimit bandwidthLimit;
    ENetProtocolThrottleConfigure throttleConfigure;
+   ENetProtocolCookie cookie;
 } ENET_PACKED ENetProtocol;
 
 #ifdef _MSC_VER
@@ -0,0 +1,48 @@
+/**
+ @file  timer.h
+ @brief ENet hierarchical timer wheel
+*/
+#ifndef __ENET_TIMER_H__
+#define __ENET_TIMER_H__
+
+#include "enet/types.h"
+#include "enet/list.h"
+
+enum
+{
+   ENET_TIMER_WHEEL_SLOT_BITS = 6,
+   ENET_TIMER_WHEEL_SLOTS     = 1 << ENET_TIMER_WHEEL_SLOT_BITS,
+   ENET_TIMER_WHEEL_LEVELS    = 4,
+   ENET_TIMER_WHEEL_SPAN      = 1 << (ENET_TIMER_WHEEL_SLOT_BITS * ENET_TIMER_WHEEL_LEVELS)
+};
+
+typedef struct _ENetTimer
+{
+   ENetListNode timerList;
+   enet_uint32  expiry;
+   int          scheduled;
+   int          type;        /**< tells the owner what the timer was for once it expires */
+   void *       data;
+} ENetTimer;
+
+/** A hashed hierarchical timer wheel. Level 0 has one slot per millisecond and each
+    further level has one slot per full turn of the level below it; timers cascade down
+    a level each time the level below wraps around.
+*/
+typedef struct _ENetTimerWheel
+{
+   enet_uint32  time;        /**< the tick whose level 0 slot is being expired */
+   size_t       timerCount;
+   ENetList     slots [ENET_TIMER_WHEEL_LEVELS] [ENET_TIMER_WHEEL_SLOTS];
+} ENetTimerWheel;
+
+extern void enet_timer_setup (ENetTimer *, int, void *);
+
+extern void enet_timer_wheel_clear (ENetTimerWheel *, enet_uint32);
+extern void enet_timer_wheel_schedule (ENetTimerWheel *, ENetTimer *, enet_uint32);
+extern void enet_timer_wheel_cancel (ENetTimerWheel *, ENetTimer *);
+extern ENetTimer * enet_timer_wheel_expire (ENetTimerWheel *, enet_uint32);
+extern enet_uint32 enet_timer_wheel_next_expiry (ENetTimerWheel *, enet_uint32);
+
+#endif /* __ENET_TIMER_H__ */
+
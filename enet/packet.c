@@ -10,6 +10,9 @@
     @{ 
 */
 
+#define ENET_PACKET_INLINE_DATA(packet) ((enet_uint8 *) ((ENetPacket *) (packet) + 1))
+#define ENET_PACKET_RECEIVE_SLAB(packet) (* (ENetReceiveSlab **) ((ENetPacket *) (packet) + 1))
+
 /** Creates a packet that may be sent to a peer.
     @param data         initial contents of the packet's data; the packet's data will remain uninitialized if data is NULL.
     @param dataLength   size of the data allocated for this packet
@@ -19,7 +22,9 @@
 ENetPacket *
 enet_packet_create (void * data, size_t dataLength, enet_uint32 flags)
 {
-    ENetPacket * packet = (ENetPacket *) enet_malloc (sizeof (ENetPacket));
+    /* Small payloads follow the packet in a single allocation. */
+    int inlineData = ! (flags & ENET_PACKET_FLAG_NO_ALLOCATE) && dataLength > 0 && dataLength <= ENET_PACKET_INLINE_DATA_MAXIMUM;
+    ENetPacket * packet = (ENetPacket *) enet_malloc (sizeof (ENetPacket) + (inlineData ? dataLength : 0));
     if (packet == NULL)
       return NULL;
 
@@ -30,11 +35,16 @@ enet_packet_create (void * data, size_t dataLength, enet_uint32 flags)
       packet -> data = NULL;
     else
     {
-       packet -> data = (enet_uint8 *) enet_malloc (dataLength);
-       if (packet -> data == NULL)
+       if (inlineData)
+         packet -> data = ENET_PACKET_INLINE_DATA (packet);
+       else
        {
-          enet_free (packet);
-          return NULL;
+          packet -> data = (enet_uint8 *) enet_malloc (dataLength);
+          if (packet -> data == NULL)
+          {
+             enet_free (packet);
+             return NULL;
+          }
        }
 
        if (data != NULL)
@@ -50,6 +60,33 @@ enet_packet_create (void * data, size_t dataLength, enet_uint32 flags)
     return packet;
 }
 
+/** Creates a packet whose data points into a receive slab rather than a copy of it.
+    @param slab         slab holding the data; the packet keeps a reference to it until destroyed
+    @param data         contents of the packet, which must lie within the slab's data
+    @param dataLength   size of the data
+    @param flags        flags for this packet as described for the ENetPacket structure.
+    @returns the packet on success, NULL on failure
+*/
+ENetPacket *
+enet_packet_create_in_slab (ENetReceiveSlab * slab, void * data, size_t dataLength, enet_uint32 flags)
+{
+    ENetPacket * packet = (ENetPacket *) enet_malloc (sizeof (ENetPacket) + sizeof (ENetReceiveSlab *));
+    if (packet == NULL)
+      return NULL;
+
+    ENET_PACKET_RECEIVE_SLAB (packet) = slab;
+    ++ slab -> referenceCount;
+
+    packet -> referenceCount = 0;
+    packet -> flags = flags | ENET_PACKET_FLAG_RECEIVE_SLAB;
+    packet -> data = (enet_uint8 *) data;
+    packet -> dataLength = dataLength;
+    packet -> freeCallback = NULL;
+    packet -> userData = NULL;
+
+    return packet;
+}
+
 /** Destroys the packet and deallocates its data.
     @param packet packet to be destroyed
 */
@@ -61,8 +98,12 @@ enet_packet_destroy (ENetPacket * packet)
 
     if (packet -> freeCallback != NULL)
       (* packet -> freeCallback) (packet);
+    if (packet -> flags & ENET_PACKET_FLAG_RECEIVE_SLAB)
+      enet_receive_slab_release (ENET_PACKET_RECEIVE_SLAB (packet));
+    else
     if (! (packet -> flags & ENET_PACKET_FLAG_NO_ALLOCATE) &&
-        packet -> data != NULL)
+        packet -> data != NULL &&
+        packet -> data != ENET_PACKET_INLINE_DATA (packet))
       enet_free (packet -> data);
     enet_free (packet);
 }
@@ -90,7 +131,16 @@ enet_packet_resize (ENetPacket * packet, size_t dataLength)
       return -1;
 
     memcpy (newData, packet -> data, packet -> dataLength);
-    enet_free (packet -> data);
+    if (packet -> flags & ENET_PACKET_FLAG_RECEIVE_SLAB)
+    {
+       /* The slab is shared, so growing the packet moves it into data of its own. */
+       enet_receive_slab_release (ENET_PACKET_RECEIVE_SLAB (packet));
+
+       packet -> flags &= ~ ENET_PACKET_FLAG_RECEIVE_SLAB;
+    }
+    else
+    if (packet -> data != ENET_PACKET_INLINE_DATA (packet))
+      enet_free (packet -> data);
     
     packet -> data = newData;
     packet -> dataLength = dataLength;
@@ -98,6 +148,31 @@ enet_packet_resize (ENetPacket * packet, size_t dataLength)
     return 0;
 }
 
+/** Allocates a receive slab holding a single reference for its creator.
+    @param dataLength size of the data following the slab
+    @returns the slab on success, NULL on failure
+*/
+ENetReceiveSlab *
+enet_receive_slab_create (size_t dataLength)
+{
+    ENetReceiveSlab * slab = (ENetReceiveSlab *) enet_malloc (sizeof (ENetReceiveSlab) + dataLength);
+    if (slab == NULL)
+      return NULL;
+
+    slab -> referenceCount = 1;
+    slab -> dataLength = dataLength;
+
+    return slab;
+}
+
+/** Drops a reference to a receive slab, freeing it once the last reference is gone. */
+void
+enet_receive_slab_release (ENetReceiveSlab * slab)
+{
+    if (-- slab -> referenceCount == 0)
+      enet_free (slab);
+}
+
 static int initializedCRC32 = 0;
 static enet_uint32 crcTable [256];
 
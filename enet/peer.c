@@ -58,15 +58,16 @@ enet_peer_throttle_configure (ENetPeer * peer, enet_uint32 interval, enet_uint32
     enet_peer_queue_outgoing_command (peer, & command, NULL, 0, 0);
 }
 
+/* Moves the packet throttle on a round trip time sample of rtt microseconds. */
 int
 enet_peer_throttle (ENetPeer * peer, enet_uint32 rtt)
 {
-    if (peer -> lastRoundTripTime <= peer -> lastRoundTripTimeVariance)
+    if (peer -> lastRoundTripTimeMicroseconds <= peer -> lastRoundTripTimeVarianceMicroseconds)
     {
         peer -> packetThrottle = peer -> packetThrottleLimit;
     }
     else
-    if (rtt < peer -> lastRoundTripTime)
+    if (rtt < peer -> lastRoundTripTimeMicroseconds)
     {
         peer -> packetThrottle += peer -> packetThrottleAcceleration;
 
@@ -76,7 +77,7 @@ enet_peer_throttle (ENetPeer * peer, enet_uint32 rtt)
         return 1;
     }
     else
-    if (rtt > peer -> lastRoundTripTime + 2 * peer -> lastRoundTripTimeVariance)
+    if (rtt > peer -> lastRoundTripTimeMicroseconds + 2 * peer -> lastRoundTripTimeVarianceMicroseconds)
     {
         if (peer -> packetThrottle > peer -> packetThrottleDeceleration)
           peer -> packetThrottle -= peer -> packetThrottleDeceleration;
@@ -148,14 +149,14 @@ enet_peer_send (ENetPeer * peer, enet_uint8 channelID, ENetPacket * packet)
          if (packet -> dataLength - fragmentOffset < fragmentLength)
            fragmentLength = packet -> dataLength - fragmentOffset;
 
-         fragment = (ENetOutgoingCommand *) enet_malloc (sizeof (ENetOutgoingCommand));
+         fragment = enet_host_allocate_outgoing_command (peer -> host);
          if (fragment == NULL)
          {
             while (! enet_list_empty (& fragments))
             {
                fragment = (ENetOutgoingCommand *) enet_list_remove (enet_list_begin (& fragments));
                
-               enet_free (fragment);
+               enet_host_free_outgoing_command (peer -> host, fragment);
             }
             
             return -1;
@@ -213,6 +214,56 @@ enet_peer_send (ENetPeer * peer, enet_uint8 channelID, ENetPacket * packet)
    return 0;
 }
 
+/** Builds the command that sends a packet unfragmented, so that it can be shared by
+    enet_peer_send_command() across several peers.
+*/
+void
+enet_peer_setup_send_command (ENetProtocol * command, enet_uint8 channelID, ENetPacket * packet)
+{
+   command -> header.channelID = channelID;
+
+   if ((packet -> flags & (ENET_PACKET_FLAG_RELIABLE | ENET_PACKET_FLAG_UNSEQUENCED)) == ENET_PACKET_FLAG_UNSEQUENCED)
+   {
+      command -> header.command = ENET_PROTOCOL_COMMAND_SEND_UNSEQUENCED | ENET_PROTOCOL_COMMAND_FLAG_UNSEQUENCED;
+      command -> sendUnsequenced.dataLength = ENET_HOST_TO_NET_16 (packet -> dataLength);
+   }
+   else
+   if (packet -> flags & ENET_PACKET_FLAG_RELIABLE)
+   {
+      command -> header.command = ENET_PROTOCOL_COMMAND_SEND_RELIABLE | ENET_PROTOCOL_COMMAND_FLAG_ACKNOWLEDGE;
+      command -> sendReliable.dataLength = ENET_HOST_TO_NET_16 (packet -> dataLength);
+   }
+   else
+   {
+      command -> header.command = ENET_PROTOCOL_COMMAND_SEND_UNRELIABLE;
+      command -> sendUnreliable.dataLength = ENET_HOST_TO_NET_16 (packet -> dataLength);
+   }
+}
+
+/** Queues a packet to a connected peer using a command built by enet_peer_setup_send_command(),
+    falling back to enet_peer_send() if the peer needs the packet fragmented or sent reliably.
+    @returns 0 on success, < 0 on failure
+*/
+int
+enet_peer_send_command (ENetPeer * peer, enet_uint8 channelID, ENetPacket * packet, const ENetProtocol * command)
+{
+   size_t overhead = sizeof (ENetProtocolHeader) + sizeof (ENetProtocolSendFragment);
+
+   if (peer -> host -> checksum != NULL)
+     overhead += sizeof (enet_uint32);
+
+   if (channelID >= peer -> channelCount ||
+       packet -> dataLength + overhead > peer -> mtu ||
+       (command -> header.command == ENET_PROTOCOL_COMMAND_SEND_UNRELIABLE &&
+        peer -> channels [channelID].outgoingUnreliableSequenceNumber >= 0xFFFF))
+     return enet_peer_send (peer, channelID, packet);
+
+   if (enet_peer_queue_outgoing_command (peer, command, packet, 0, packet -> dataLength) == NULL)
+     return -1;
+
+   return 0;
+}
+
 /** Attempts to dequeue any incoming queued packet.
     @param peer peer to dequeue packets from
     @param channelID holds the channel ID of the channel the packet was received on success
@@ -239,7 +290,7 @@ enet_peer_receive (ENetPeer * peer, enet_uint8 * channelID)
    if (incomingCommand -> fragments != NULL)
      enet_free (incomingCommand -> fragments);
 
-   enet_free (incomingCommand);
+   enet_host_free_incoming_command (peer -> host, incomingCommand);
 
    peer -> totalWaitingData -= packet -> dataLength;
 
@@ -247,7 +298,7 @@ enet_peer_receive (ENetPeer * peer, enet_uint8 * channelID)
 }
 
 static void
-enet_peer_reset_outgoing_commands (ENetList * queue)
+enet_peer_reset_outgoing_commands (ENetPeer * peer, ENetList * queue)
 {
     ENetOutgoingCommand * outgoingCommand;
 
@@ -255,6 +306,8 @@ enet_peer_reset_outgoing_commands (ENetList * queue)
     {
        outgoingCommand = (ENetOutgoingCommand *) enet_list_remove (enet_list_begin (queue));
 
+       enet_timer_wheel_cancel (& peer -> host -> timerWheel, & outgoingCommand -> retransmitTimer);
+
        if (outgoingCommand -> packet != NULL)
        {
           -- outgoingCommand -> packet -> referenceCount;
@@ -263,12 +316,31 @@ enet_peer_reset_outgoing_commands (ENetList * queue)
             enet_packet_destroy (outgoingCommand -> packet);
        }
 
-       enet_free (outgoingCommand);
+       enet_host_free_outgoing_command (peer -> host, outgoingCommand);
+    }
+}
+
+static void
+enet_peer_free_incoming_command (ENetPeer * peer, ENetIncomingCommand * incomingCommand)
+{
+    if (incomingCommand -> packet != NULL)
+    {
+       peer -> totalWaitingData -= incomingCommand -> packet -> dataLength;
+
+       -- incomingCommand -> packet -> referenceCount;
+
+       if (incomingCommand -> packet -> referenceCount == 0)
+         enet_packet_destroy (incomingCommand -> packet);
     }
+
+    if (incomingCommand -> fragments != NULL)
+      enet_free (incomingCommand -> fragments);
+
+    enet_host_free_incoming_command (peer -> host, incomingCommand);
 }
 
 static void
-enet_peer_remove_incoming_commands (ENetList * queue, ENetListIterator startCommand, ENetListIterator endCommand)
+enet_peer_remove_incoming_commands (ENetPeer * peer, ENetList * queue, ENetListIterator startCommand, ENetListIterator endCommand)
 {
 	(void)queue;
     ENetListIterator currentCommand;    
@@ -281,25 +353,37 @@ enet_peer_remove_incoming_commands (ENetList * queue, ENetListIterator startComm
 
        enet_list_remove (& incomingCommand -> incomingCommandList);
  
-       if (incomingCommand -> packet != NULL)
-       {
-          -- incomingCommand -> packet -> referenceCount;
-
-          if (incomingCommand -> packet -> referenceCount == 0)
-            enet_packet_destroy (incomingCommand -> packet);
-       }
-
-       if (incomingCommand -> fragments != NULL)
-         enet_free (incomingCommand -> fragments);
-
-       enet_free (incomingCommand);
+       enet_peer_free_incoming_command (peer, incomingCommand);
     }
 }
 
 static void
-enet_peer_reset_incoming_commands (ENetList * queue)
+enet_peer_reset_incoming_commands (ENetPeer * peer, ENetList * queue)
 {
-    enet_peer_remove_incoming_commands(queue, enet_list_begin (queue), enet_list_end (queue));
+    enet_peer_remove_incoming_commands(peer, queue, enet_list_begin (queue), enet_list_end (queue));
+}
+
+static void
+enet_peer_reset_incoming_reliable_commands (ENetPeer * peer, ENetChannel * channel)
+{
+    size_t slot;
+
+    if (channel -> incomingReliableRing == NULL)
+      return;
+
+    for (slot = 0; slot <= channel -> incomingReliableRingMask && channel -> incomingReliableCount > 0; ++ slot)
+    {
+       if (channel -> incomingReliableRing [slot] == NULL)
+         continue;
+
+       enet_peer_free_incoming_command (peer, channel -> incomingReliableRing [slot]);
+
+       -- channel -> incomingReliableCount;
+    }
+
+    enet_free (channel -> incomingReliableRing);
+
+    channel -> incomingReliableRing = NULL;
 }
  
 void
@@ -314,14 +398,30 @@ enet_peer_reset_queues (ENetPeer * peer)
        peer -> needsDispatch = 0;
     }
 
+    if (peer -> needsService)
+    {
+       enet_list_remove (& peer -> serviceList);
+
+       peer -> needsService = 0;
+    }
+
     while (! enet_list_empty (& peer -> acknowledgements))
       enet_free (enet_list_remove (enet_list_begin (& peer -> acknowledgements)));
 
-    enet_peer_reset_outgoing_commands (& peer -> sentReliableCommands);
-    enet_peer_reset_outgoing_commands (& peer -> sentUnreliableCommands);
-    enet_peer_reset_outgoing_commands (& peer -> outgoingReliableCommands);
-    enet_peer_reset_outgoing_commands (& peer -> outgoingUnreliableCommands);
-    enet_peer_reset_incoming_commands (& peer -> dispatchedCommands);
+    if (peer -> sentReliableRing != NULL)
+    {
+       enet_free (peer -> sentReliableRing);
+
+       peer -> sentReliableRing = NULL;
+       peer -> sentReliableRingMask = 0;
+    }
+
+    enet_peer_reset_outgoing_commands (peer, & peer -> sentReliableCommands);
+    enet_peer_reset_outgoing_commands (peer, & peer -> sentUnreliableCommands);
+    enet_peer_reset_outgoing_commands (peer, & peer -> outgoingReliableCommands);
+    peer -> lastQueuedResend = NULL;
+    enet_peer_reset_outgoing_commands (peer, & peer -> outgoingUnreliableCommands);
+    enet_peer_reset_incoming_commands (peer, & peer -> dispatchedCommands);
 
     if (peer -> channels != NULL && peer -> channelCount > 0)
     {
@@ -329,8 +429,11 @@ enet_peer_reset_queues (ENetPeer * peer)
              channel < & peer -> channels [peer -> channelCount];
              ++ channel)
         {
-            enet_peer_reset_incoming_commands (& channel -> incomingReliableCommands);
-            enet_peer_reset_incoming_commands (& channel -> incomingUnreliableCommands);
+            enet_peer_reset_incoming_reliable_commands (peer, channel);
+            enet_peer_reset_incoming_commands (peer, & channel -> incomingUnreliableCommands);
+
+            if (channel -> sentReliableRing != NULL)
+              enet_free (channel -> sentReliableRing);
         }
 
         enet_free (peer -> channels);
@@ -364,6 +467,42 @@ enet_peer_on_disconnect (ENetPeer * peer)
     }
 }
 
+/** Schedules the peer's next ping on its host's timer wheel. Pings are only sent to connected
+    peers while no reliable commands are in flight, since those already keep the connection alive.
+*/
+void
+enet_peer_schedule_ping (ENetPeer * peer)
+{
+    enet_uint32 pingTime = peer -> lastReceiveTime + peer -> pingInterval;
+
+    if (peer -> state != ENET_PEER_STATE_CONNECTED ||
+        ! enet_list_empty (& peer -> sentReliableCommands))
+    {
+        enet_timer_wheel_cancel (& peer -> host -> timerWheel, & peer -> pingTimer);
+
+        return;
+    }
+
+    if (peer -> pingTimer.scheduled && peer -> pingTimer.expiry == pingTime)
+      return;
+
+    enet_timer_wheel_schedule (& peer -> host -> timerWheel, & peer -> pingTimer, pingTime);
+}
+
+/** Queues the peer to be visited by the next pass of its host over outgoing commands,
+    such as when new acknowledgements or commands are queued for it.
+*/
+void
+enet_peer_activate (ENetPeer * peer)
+{
+    if (peer -> needsService)
+      return;
+
+    enet_list_insert (enet_list_end (& peer -> host -> serviceQueue), & peer -> serviceList);
+
+    peer -> needsService = 1;
+}
+
 /** Forcefully disconnects a peer.
     @param peer peer to forcefully disconnect
     @remarks The foreign host represented by the peer is not notified of the disconnection and will timeout
@@ -373,6 +512,9 @@ void
 enet_peer_reset (ENetPeer * peer)
 {
     enet_peer_on_disconnect (peer);
+
+    if (peer -> state != ENET_PEER_STATE_DISCONNECTED)
+      enet_host_free_peer (peer -> host, peer);
         
     peer -> outgoingPeerID = ENET_PROTOCOL_MAXIMUM_PEER_ID;
     peer -> connectID = 0;
@@ -387,7 +529,6 @@ enet_peer_reset (ENetPeer * peer)
     peer -> outgoingDataTotal = 0;
     peer -> lastSendTime = 0;
     peer -> lastReceiveTime = 0;
-    peer -> nextTimeout = 0;
     peer -> earliestTimeout = 0;
     peer -> packetLossEpoch = 0;
     peer -> packetsSent = 0;
@@ -411,18 +552,39 @@ enet_peer_reset (ENetPeer * peer)
     peer -> highestRoundTripTimeVariance = 0;
     peer -> roundTripTime = ENET_PEER_DEFAULT_ROUND_TRIP_TIME;
     peer -> roundTripTimeVariance = 0;
+    peer -> roundTripTimeMicroseconds = ENET_PEER_DEFAULT_ROUND_TRIP_TIME * 1000;
+    peer -> roundTripTimeVarianceMicroseconds = 0;
+    peer -> lastRoundTripTimeMicroseconds = ENET_PEER_DEFAULT_ROUND_TRIP_TIME * 1000;
+    peer -> lowestRoundTripTimeMicroseconds = ENET_PEER_DEFAULT_ROUND_TRIP_TIME * 1000;
+    peer -> lastRoundTripTimeVarianceMicroseconds = 0;
+    peer -> highestRoundTripTimeVarianceMicroseconds = 0;
     peer -> mtu = peer -> host -> mtu;
     peer -> reliableDataInTransit = 0;
+    peer -> reliableSendNumber = 0;
+    peer -> acknowledgedSendNumber = 0;
     peer -> outgoingReliableSequenceNumber = 0;
     peer -> windowSize = ENET_PROTOCOL_MAXIMUM_WINDOW_SIZE;
     peer -> incomingUnsequencedGroup = 0;
     peer -> outgoingUnsequencedGroup = 0;
     peer -> eventData = 0;
-    peer -> totalWaitingData = 0;
+    peer -> pacingTime = 0;
+    peer -> pacingCredit = 0;
+    peer -> pacingHeld = 0;
 
     memset (peer -> unsequencedWindow, 0, sizeof (peer -> unsequencedWindow));
+    memset (& peer -> connectCookie, 0, sizeof (peer -> connectCookie));
+    peer -> selectiveAcknowledgements = 0;
     
     enet_peer_reset_queues (peer);
+
+    /* Freeing the queued commands gives back their data, so this only settles the count. */
+    peer -> totalWaitingData = 0;
+
+    enet_timer_wheel_cancel (& peer -> host -> timerWheel, & peer -> pingTimer);
+    enet_timer_wheel_cancel (& peer -> host -> timerWheel, & peer -> pacingTimer);
+
+    if (peer -> host -> congestionControl.reset != NULL)
+      peer -> host -> congestionControl.reset (peer -> host -> congestionControl.context, peer);
 }
 
 /** Sends a ping request to a peer.
@@ -459,6 +621,8 @@ void
 enet_peer_ping_interval (ENetPeer * peer, enet_uint32 pingInterval)
 {
     peer -> pingInterval = pingInterval ? pingInterval : ENET_PEER_PING_INTERVAL;
+
+    enet_peer_schedule_ping (peer);
 }
 
 /** Sets the timeout parameters for a peer.
@@ -600,6 +764,33 @@ enet_peer_queue_acknowledgement (ENetPeer * peer, const ENetProtocol * command,
           return NULL;
     }
 
+    /* Commands usually arrive in order, so fold them into the last acknowledgement while it
+       can still cover them. */
+    if (peer -> selectiveAcknowledgements &&
+        command -> header.channelID < peer -> channelCount &&
+        ! enet_list_empty (& peer -> acknowledgements))
+    {
+        enet_uint16 offset;
+
+        acknowledgement = (ENetAcknowledgement *) enet_list_back (& peer -> acknowledgements);
+        offset = command -> header.reliableSequenceNumber - acknowledgement -> command.header.reliableSequenceNumber;
+
+        if (acknowledgement -> command.header.channelID == command -> header.channelID && offset <= 32)
+        {
+            if (offset > 0)
+            {
+                if (acknowledgement -> receivedMask == 0)
+                  peer -> outgoingDataTotal += sizeof (ENetProtocolSelectiveAcknowledge) - sizeof (ENetProtocolAcknowledge);
+
+                acknowledgement -> receivedMask |= 1U << (offset - 1);
+            }
+
+            acknowledgement -> sentTime = sentTime;
+
+            return acknowledgement;
+        }
+    }
+
     acknowledgement = (ENetAcknowledgement *) enet_malloc (sizeof (ENetAcknowledgement));
     if (acknowledgement == NULL)
       return NULL;
@@ -608,8 +799,11 @@ enet_peer_queue_acknowledgement (ENetPeer * peer, const ENetProtocol * command,
 
     acknowledgement -> sentTime = sentTime;
     acknowledgement -> command = * command;
+    acknowledgement -> receivedMask = 0;
     
     enet_list_insert (enet_list_end (& peer -> acknowledgements), acknowledgement);
+
+    enet_peer_activate (peer);
     
     return acknowledgement;
 }
@@ -655,9 +849,11 @@ enet_peer_setup_outgoing_command (ENetPeer * peer, ENetOutgoingCommand * outgoin
     }
    
     outgoingCommand -> sendAttempts = 0;
+    outgoingCommand -> sendNumber = 0;
     outgoingCommand -> sentTime = 0;
     outgoingCommand -> roundTripTimeout = 0;
     outgoingCommand -> roundTripTimeoutLimit = 0;
+    enet_timer_setup (& outgoingCommand -> retransmitTimer, ENET_TIMER_TYPE_RETRANSMIT, peer);
     outgoingCommand -> command.header.reliableSequenceNumber = ENET_HOST_TO_NET_16 (outgoingCommand -> reliableSequenceNumber);
 
     switch (outgoingCommand -> command.header.command & ENET_PROTOCOL_COMMAND_MASK)
@@ -678,12 +874,14 @@ enet_peer_setup_outgoing_command (ENetPeer * peer, ENetOutgoingCommand * outgoin
       enet_list_insert (enet_list_end (& peer -> outgoingReliableCommands), outgoingCommand);
     else
       enet_list_insert (enet_list_end (& peer -> outgoingUnreliableCommands), outgoingCommand);
+
+    enet_peer_activate (peer);
 }
 
 ENetOutgoingCommand *
 enet_peer_queue_outgoing_command (ENetPeer * peer, const ENetProtocol * command, ENetPacket * packet, enet_uint32 offset, enet_uint16 length)
 {
-    ENetOutgoingCommand * outgoingCommand = (ENetOutgoingCommand *) enet_malloc (sizeof (ENetOutgoingCommand));
+    ENetOutgoingCommand * outgoingCommand = enet_host_allocate_outgoing_command (peer -> host);
     if (outgoingCommand == NULL)
       return NULL;
 
@@ -779,37 +977,223 @@ enet_peer_dispatch_incoming_unreliable_commands (ENetPeer * peer, ENetChannel *
        droppedCommand = currentCommand;
     }
 
-    enet_peer_remove_incoming_commands (& channel -> incomingUnreliableCommands, enet_list_begin (& channel -> incomingUnreliableCommands), droppedCommand);
+    enet_peer_remove_incoming_commands (peer, & channel -> incomingUnreliableCommands, enet_list_begin (& channel -> incomingUnreliableCommands), droppedCommand);
+}
+
+static ENetOutgoingCommand ***
+enet_peer_sent_reliable_ring (ENetPeer * peer, enet_uint8 channelID, enet_uint16 ** ringMask)
+{
+    if (channelID < peer -> channelCount)
+    {
+       * ringMask = & peer -> channels [channelID].sentReliableRingMask;
+
+       return & peer -> channels [channelID].sentReliableRing;
+    }
+
+    * ringMask = & peer -> sentReliableRingMask;
+
+    return & peer -> sentReliableRing;
+}
+
+/** Indexes a reliable command being sent for the first time, so that its acknowledgement
+    finds it directly.
+    @returns 0 on success, < 0 if the ring could not grow
+    @remarks The commands awaiting acknowledgement on a channel span less than the reliable
+    windows, so doubling the ring eventually gives each of them its own slot.
+*/
+int
+enet_peer_index_sent_reliable_command (ENetPeer * peer, ENetOutgoingCommand * outgoingCommand)
+{
+    enet_uint16 * ringMask;
+    ENetOutgoingCommand *** ring = enet_peer_sent_reliable_ring (peer, outgoingCommand -> command.header.channelID, & ringMask);
+    ENetOutgoingCommand ** newRing;
+    size_t ringSize, slot;
+
+    if (* ring != NULL && (* ring) [outgoingCommand -> reliableSequenceNumber & * ringMask] == NULL)
+    {
+       (* ring) [outgoingCommand -> reliableSequenceNumber & * ringMask] = outgoingCommand;
+
+       return 0;
+    }
+
+    for (ringSize = * ring != NULL ? ((size_t) * ringMask + 1) * 2 : ENET_PEER_SENT_RELIABLE_RING_SIZE;
+         ;
+         ringSize *= 2)
+    {
+       newRing = (ENetOutgoingCommand **) enet_malloc (ringSize * sizeof (ENetOutgoingCommand *));
+       if (newRing == NULL)
+         return -1;
+
+       memset (newRing, 0, ringSize * sizeof (ENetOutgoingCommand *));
+
+       newRing [outgoingCommand -> reliableSequenceNumber & (ringSize - 1)] = outgoingCommand;
+
+       for (slot = 0; * ring != NULL && slot <= * ringMask; ++ slot)
+       {
+          ENetOutgoingCommand * sentCommand = (* ring) [slot];
+
+          if (sentCommand == NULL)
+            continue;
+
+          if (newRing [sentCommand -> reliableSequenceNumber & (ringSize - 1)] != NULL)
+            break;
+
+          newRing [sentCommand -> reliableSequenceNumber & (ringSize - 1)] = sentCommand;
+       }
+
+       if (* ring == NULL || slot > * ringMask)
+         break;
+
+       enet_free (newRing);
+    }
+
+    if (* ring != NULL)
+      enet_free (* ring);
+
+    * ring = newRing;
+    * ringMask = (enet_uint16) (ringSize - 1);
+
+    return 0;
+}
+
+/** Removes the sent reliable command with the given sequence number and channel from the index.
+    @returns the command, or NULL if no such command was sent and is awaiting acknowledgement
+*/
+ENetOutgoingCommand *
+enet_peer_unindex_sent_reliable_command (ENetPeer * peer, enet_uint16 reliableSequenceNumber, enet_uint8 channelID)
+{
+    enet_uint16 * ringMask;
+    ENetOutgoingCommand *** ring = enet_peer_sent_reliable_ring (peer, channelID, & ringMask);
+    ENetOutgoingCommand * outgoingCommand;
+
+    if (* ring == NULL)
+      return NULL;
+
+    outgoingCommand = (* ring) [reliableSequenceNumber & * ringMask];
+    if (outgoingCommand == NULL ||
+        outgoingCommand -> reliableSequenceNumber != reliableSequenceNumber ||
+        outgoingCommand -> command.header.channelID != channelID)
+      return NULL;
+
+    (* ring) [reliableSequenceNumber & * ringMask] = NULL;
+
+    return outgoingCommand;
+}
+
+/** Looks up the reliable command with the given sequence number waiting on a channel.
+    @returns the command, or NULL if it has not arrived or was already dispatched
+*/
+ENetIncomingCommand *
+enet_peer_find_incoming_reliable_command (ENetChannel * channel, enet_uint16 reliableSequenceNumber)
+{
+    ENetIncomingCommand * incomingCommand;
+
+    if (channel -> incomingReliableRing == NULL ||
+        (enet_uint16) (reliableSequenceNumber - channel -> incomingReliableSequenceNumber - 1) > channel -> incomingReliableRingMask)
+      return NULL;
+
+    incomingCommand = channel -> incomingReliableRing [reliableSequenceNumber & channel -> incomingReliableRingMask];
+    if (incomingCommand == NULL || incomingCommand -> reliableSequenceNumber != reliableSequenceNumber)
+      return NULL;
+
+    return incomingCommand;
+}
+
+/* Every waiting command is less than the ring size ahead of the next sequence number to
+   dispatch, so no two of them share a slot; grow the ring until that holds for offset too. */
+static int
+enet_peer_grow_incoming_reliable_ring (ENetChannel * channel, enet_uint16 offset)
+{
+    ENetIncomingCommand ** ring;
+    size_t ringSize = ENET_PEER_INCOMING_RELIABLE_RING_SIZE, slot;
+
+    if (channel -> incomingReliableRing != NULL && offset <= channel -> incomingReliableRingMask)
+      return 0;
+
+    while (ringSize <= offset)
+      ringSize <<= 1;
+
+    ring = (ENetIncomingCommand **) enet_malloc (ringSize * sizeof (ENetIncomingCommand *));
+    if (ring == NULL)
+      return -1;
+
+    memset (ring, 0, ringSize * sizeof (ENetIncomingCommand *));
+
+    if (channel -> incomingReliableRing != NULL)
+    {
+       for (slot = 0; slot <= channel -> incomingReliableRingMask; ++ slot)
+       {
+          ENetIncomingCommand * incomingCommand = channel -> incomingReliableRing [slot];
+
+          if (incomingCommand != NULL)
+            ring [incomingCommand -> reliableSequenceNumber & (ringSize - 1)] = incomingCommand;
+       }
+
+       enet_free (channel -> incomingReliableRing);
+    }
+
+    channel -> incomingReliableRing = ring;
+    channel -> incomingReliableRingMask = (enet_uint16) (ringSize - 1);
+
+    return 0;
 }
 
 void
 enet_peer_dispatch_incoming_reliable_commands (ENetPeer * peer, ENetChannel * channel)
 {
-    ENetListIterator currentCommand;
+    int dispatched = 0;
 
-    for (currentCommand = enet_list_begin (& channel -> incomingReliableCommands);
-         currentCommand != enet_list_end (& channel -> incomingReliableCommands);
-         currentCommand = enet_list_next (currentCommand))
+    while (channel -> incomingReliableCount > 0)
     {
-       ENetIncomingCommand * incomingCommand = (ENetIncomingCommand *) currentCommand;
-         
-       if (incomingCommand -> fragmentsRemaining > 0 ||
-           incomingCommand -> reliableSequenceNumber != (enet_uint16) (channel -> incomingReliableSequenceNumber + 1))
+       enet_uint16 reliableSequenceNumber = channel -> incomingReliableSequenceNumber + 1;
+       ENetIncomingCommand * incomingCommand = channel -> incomingReliableRing [reliableSequenceNumber & channel -> incomingReliableRingMask];
+
+       if (incomingCommand == NULL ||
+           incomingCommand -> reliableSequenceNumber != reliableSequenceNumber ||
+           incomingCommand -> fragmentsRemaining > 0)
          break;
 
-       channel -> incomingReliableSequenceNumber = incomingCommand -> reliableSequenceNumber;
+       channel -> incomingReliableRing [reliableSequenceNumber & channel -> incomingReliableRingMask] = NULL;
+       -- channel -> incomingReliableCount;
+
+       channel -> incomingReliableSequenceNumber = reliableSequenceNumber;
 
        if (incomingCommand -> fragmentCount > 0)
-         channel -> incomingReliableSequenceNumber += incomingCommand -> fragmentCount - 1;
+       {
+          enet_uint32 fragmentNumber;
+
+          /* The fragments used up the following sequence numbers, so nothing queued on them can
+             be dispatched any more; drop it before the ring moves past it. */
+          for (fragmentNumber = 1;
+               fragmentNumber < incomingCommand -> fragmentCount && fragmentNumber <= (enet_uint32) channel -> incomingReliableRingMask + 1;
+               ++ fragmentNumber)
+          {
+             enet_uint16 slot = (enet_uint16) (reliableSequenceNumber + fragmentNumber) & channel -> incomingReliableRingMask;
+             ENetIncomingCommand * skippedCommand = channel -> incomingReliableRing [slot];
+
+             if (skippedCommand == NULL ||
+                 (enet_uint16) (skippedCommand -> reliableSequenceNumber - reliableSequenceNumber - 1) >= incomingCommand -> fragmentCount - 1)
+               continue;
+
+             channel -> incomingReliableRing [slot] = NULL;
+             -- channel -> incomingReliableCount;
+
+             enet_peer_free_incoming_command (peer, skippedCommand);
+          }
+
+          channel -> incomingReliableSequenceNumber += incomingCommand -> fragmentCount - 1;
+       }
+
+       enet_list_insert (enet_list_end (& peer -> dispatchedCommands), incomingCommand);
+
+       dispatched = 1;
     } 
 
-    if (currentCommand == enet_list_begin (& channel -> incomingReliableCommands))
+    if (! dispatched)
       return;
 
     channel -> incomingUnreliableSequenceNumber = 0;
 
-    enet_list_move (enet_list_end (& peer -> dispatchedCommands), enet_list_begin (& channel -> incomingReliableCommands), enet_list_previous (currentCommand));
-
     if (! peer -> needsDispatch)
     {
        enet_list_insert (enet_list_end (& peer -> host -> dispatchQueue), & peer -> dispatchList);
@@ -830,8 +1214,9 @@ enet_peer_queue_incoming_command (ENetPeer * peer, const ENetProtocol * command,
     enet_uint32 unreliableSequenceNumber = 0, reliableSequenceNumber = 0;
     enet_uint16 reliableWindow, currentWindow;
     ENetIncomingCommand * incomingCommand;
-    ENetListIterator currentCommand;
+    ENetListIterator currentCommand = enet_list_end (& channel -> incomingUnreliableCommands);
     ENetPacket * packet = NULL;
+    int inOrder = 1;
 
     if (peer -> state == ENET_PEER_STATE_DISCONNECT_LATER)
       goto discardCommand;
@@ -855,30 +1240,14 @@ enet_peer_queue_incoming_command (ENetPeer * peer, const ENetProtocol * command,
     case ENET_PROTOCOL_COMMAND_SEND_RELIABLE:
        if (reliableSequenceNumber == channel -> incomingReliableSequenceNumber)
          goto discardCommand;
-       
-       for (currentCommand = enet_list_previous (enet_list_end (& channel -> incomingReliableCommands));
-            currentCommand != enet_list_end (& channel -> incomingReliableCommands);
-            currentCommand = enet_list_previous (currentCommand))
-       {
-          incomingCommand = (ENetIncomingCommand *) currentCommand;
-
-          if (reliableSequenceNumber >= channel -> incomingReliableSequenceNumber)
-          {
-             if (incomingCommand -> reliableSequenceNumber < channel -> incomingReliableSequenceNumber)
-               continue;
-          }
-          else
-          if (incomingCommand -> reliableSequenceNumber >= channel -> incomingReliableSequenceNumber)
-            break;
 
-          if (incomingCommand -> reliableSequenceNumber <= reliableSequenceNumber)
-          {
-             if (incomingCommand -> reliableSequenceNumber < reliableSequenceNumber)
-               break;
+       inOrder = reliableSequenceNumber == (enet_uint16) (channel -> incomingReliableSequenceNumber + 1);
+       
+       if (enet_peer_find_incoming_reliable_command (channel, reliableSequenceNumber) != NULL)
+         goto discardCommand;
 
-             goto discardCommand;
-          }
-       }
+       if (enet_peer_grow_incoming_reliable_ring (channel, (enet_uint16) (reliableSequenceNumber - channel -> incomingReliableSequenceNumber - 1)) < 0)
+         goto notifyError;
        break;
 
     case ENET_PROTOCOL_COMMAND_SEND_UNRELIABLE:
@@ -889,6 +1258,8 @@ enet_peer_queue_incoming_command (ENetPeer * peer, const ENetProtocol * command,
            unreliableSequenceNumber <= channel -> incomingUnreliableSequenceNumber)
          goto discardCommand;
 
+       inOrder = reliableSequenceNumber == channel -> incomingReliableSequenceNumber;
+
        for (currentCommand = enet_list_previous (enet_list_end (& channel -> incomingUnreliableCommands));
             currentCommand != enet_list_end (& channel -> incomingUnreliableCommands);
             currentCommand = enet_list_previous (currentCommand))
@@ -924,7 +1295,6 @@ enet_peer_queue_incoming_command (ENetPeer * peer, const ENetProtocol * command,
        break;
 
     case ENET_PROTOCOL_COMMAND_SEND_UNSEQUENCED:
-       currentCommand = enet_list_end (& channel -> incomingUnreliableCommands);
        break;
 
     default:
@@ -934,11 +1304,16 @@ enet_peer_queue_incoming_command (ENetPeer * peer, const ENetProtocol * command,
     if (peer -> totalWaitingData >= peer -> host -> maximumWaitingData)
       goto notifyError;
 
-    packet = enet_packet_create (data, dataLength, flags);
+    /* Packets that can be dispatched straight away point into the datagram they arrived in,
+       rather than holding on to it while waiting for earlier commands. */
+    if (inOrder && fragmentCount == 0 && peer -> host -> receivedSlab != NULL)
+      packet = enet_packet_create_in_slab (peer -> host -> receivedSlab, data, dataLength, flags);
+    else
+      packet = enet_packet_create (data, dataLength, flags);
     if (packet == NULL)
       goto notifyError;
 
-    incomingCommand = (ENetIncomingCommand *) enet_malloc (sizeof (ENetIncomingCommand));
+    incomingCommand = enet_host_allocate_incoming_command (peer -> host);
     if (incomingCommand == NULL)
       goto notifyError;
 
@@ -956,7 +1331,7 @@ enet_peer_queue_incoming_command (ENetPeer * peer, const ENetProtocol * command,
          incomingCommand -> fragments = (enet_uint32 *) enet_malloc ((fragmentCount + 31) / 32 * sizeof (enet_uint32));
        if (incomingCommand -> fragments == NULL)
        {
-          enet_free (incomingCommand);
+          enet_host_free_incoming_command (peer -> host, incomingCommand);
 
           goto notifyError;
        }
@@ -970,16 +1345,19 @@ enet_peer_queue_incoming_command (ENetPeer * peer, const ENetProtocol * command,
        peer -> totalWaitingData += packet -> dataLength;
     }
 
-    enet_list_insert (enet_list_next (currentCommand), incomingCommand);
-
     switch (command -> header.command & ENET_PROTOCOL_COMMAND_MASK)
     {
     case ENET_PROTOCOL_COMMAND_SEND_FRAGMENT:
     case ENET_PROTOCOL_COMMAND_SEND_RELIABLE:
+       channel -> incomingReliableRing [reliableSequenceNumber & channel -> incomingReliableRingMask] = incomingCommand;
+       ++ channel -> incomingReliableCount;
+
        enet_peer_dispatch_incoming_reliable_commands (peer, channel);
        break;
 
     default:
+       enet_list_insert (enet_list_next (currentCommand), incomingCommand);
+
        enet_peer_dispatch_incoming_unreliable_commands (peer, channel);
        break;
     }
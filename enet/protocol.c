@@ -23,7 +23,9 @@ static size_t commandSizes [ENET_PROTOCOL_COMMAND_COUNT] =
     sizeof (ENetProtocolSendUnsequenced),
     sizeof (ENetProtocolBandwidthLimit),
     sizeof (ENetProtocolThrottleConfigure),
-    sizeof (ENetProtocolSendFragment)
+    sizeof (ENetProtocolSendFragment),
+    sizeof (ENetProtocolCookie),
+    sizeof (ENetProtocolSelectiveAcknowledge)
 };
 
 size_t
@@ -42,6 +44,8 @@ enet_protocol_change_state (ENetHost * host, ENetPeer * peer, ENetPeerState stat
       enet_peer_on_disconnect (peer);
 
     peer -> state = state;
+
+    enet_peer_schedule_ping (peer);
 }
 
 static void
@@ -182,53 +186,110 @@ enet_protocol_remove_sent_unreliable_commands (ENetPeer * peer)
            }
         }
 
-        enet_free (outgoingCommand);
+        enet_host_free_outgoing_command (peer -> host, outgoingCommand);
     }
 }
 
-static ENetProtocolCommand
-enet_protocol_remove_sent_reliable_command (ENetPeer * peer, enet_uint16 reliableSequenceNumber, enet_uint8 channelID)
+/* Puts a sent reliable command on the outgoing queue to be resent, ahead of anything not yet
+   sent and after commands queued to be resent before it. */
+static void
+enet_protocol_queue_resend (ENetPeer * peer, ENetOutgoingCommand * outgoingCommand)
 {
-    ENetOutgoingCommand * outgoingCommand = NULL;
-    ENetListIterator currentCommand;
-    ENetProtocolCommand commandNumber;
-    int wasSent = 1;
+    ENetListIterator insertPosition = peer -> lastQueuedResend != NULL ?
+                                        enet_list_next (& peer -> lastQueuedResend -> outgoingCommandList) :
+                                        enet_list_begin (& peer -> outgoingReliableCommands);
 
-    for (currentCommand = enet_list_begin (& peer -> sentReliableCommands);
-         currentCommand != enet_list_end (& peer -> sentReliableCommands);
-         currentCommand = enet_list_next (currentCommand))
-    {
-       outgoingCommand = (ENetOutgoingCommand *) currentCommand;
-        
-       if (outgoingCommand -> reliableSequenceNumber == reliableSequenceNumber &&
-           outgoingCommand -> command.header.channelID == channelID)
-         break;
-    }
+    enet_list_insert (insertPosition, enet_list_remove (& outgoingCommand -> outgoingCommandList));
 
-    if (currentCommand == enet_list_end (& peer -> sentReliableCommands))
-    {
-       for (currentCommand = enet_list_begin (& peer -> outgoingReliableCommands);
-            currentCommand != enet_list_end (& peer -> outgoingReliableCommands);
-            currentCommand = enet_list_next (currentCommand))
-       {
-          outgoingCommand = (ENetOutgoingCommand *) currentCommand;
+    peer -> lastQueuedResend = outgoingCommand;
+}
 
-          if (outgoingCommand -> sendAttempts < 1) return ENET_PROTOCOL_COMMAND_NONE;
+/* Called before a command leaves the outgoing queue, so the last command queued to be resent
+   becomes the one before it, if any. */
+static void
+enet_protocol_unqueue_resend (ENetPeer * peer, ENetOutgoingCommand * outgoingCommand)
+{
+    ENetListIterator previous;
 
-          if (outgoingCommand -> reliableSequenceNumber == reliableSequenceNumber &&
-              outgoingCommand -> command.header.channelID == channelID)
-            break;
-       }
+    if (outgoingCommand != peer -> lastQueuedResend)
+      return;
+
+    previous = enet_list_previous (& outgoingCommand -> outgoingCommandList);
+
+    peer -> lastQueuedResend = previous != enet_list_end (& peer -> outgoingReliableCommands) ? (ENetOutgoingCommand *) previous : NULL;
+}
+
+/* Puts a sent reliable command that was lost back on the outgoing queue. */
+static void
+enet_protocol_requeue_sent_reliable_command (ENetPeer * peer, ENetOutgoingCommand * outgoingCommand)
+{
+    ENetCongestionControl * congestionControl = & peer -> host -> congestionControl;
+
+    if (outgoingCommand -> packet != NULL)
+      peer -> reliableDataInTransit -= outgoingCommand -> fragmentLength;
+       
+    ++ peer -> packetsLost;
+
+    if (congestionControl -> onLoss != NULL)
+      congestionControl -> onLoss (congestionControl -> context, peer, outgoingCommand -> packet != NULL ? outgoingCommand -> fragmentLength : 0);
 
-       if (currentCommand == enet_list_end (& peer -> outgoingReliableCommands))
-         return ENET_PROTOCOL_COMMAND_NONE;
+    enet_protocol_queue_resend (peer, outgoingCommand);
+
+    enet_peer_activate (peer);
+}
 
-       wasSent = 0;
+/* Sent reliable commands are kept in the order they were sent, so once a command sent
+   ENET_PEER_FAST_RETRANSMIT_THRESHOLD sends after the oldest ones has been acknowledged, those
+   are taken as lost and resent without waiting for their retransmit timeouts. */
+static void
+enet_protocol_fast_retransmit (ENetHost * host, ENetPeer * peer)
+{
+    while (! enet_list_empty (& peer -> sentReliableCommands))
+    {
+       ENetOutgoingCommand * outgoingCommand = (ENetOutgoingCommand *) enet_list_front (& peer -> sentReliableCommands);
+       enet_uint32 laterSends = peer -> acknowledgedSendNumber - outgoingCommand -> sendNumber;
+
+       if (laterSends < ENET_PEER_FAST_RETRANSMIT_THRESHOLD || laterSends >= 0x80000000U)
+         break;
+
+       enet_timer_wheel_cancel (& host -> timerWheel, & outgoingCommand -> retransmitTimer);
+
+       enet_protocol_requeue_sent_reliable_command (peer, outgoingCommand);
     }
+}
+
+/* If roundTripTime is not NULL, it is lowered to the time since the command was sent when the
+   acknowledgement's receivedSentTime shows that it answers the command's last send. */
+static ENetProtocolCommand
+enet_protocol_remove_sent_reliable_command (ENetPeer * peer, enet_uint16 reliableSequenceNumber, enet_uint8 channelID, enet_uint16 receivedSentTime, enet_uint32 * roundTripTime)
+{
+    ENetOutgoingCommand * outgoingCommand;
+    ENetProtocolCommand commandNumber;
+    int wasSent, answersLastSend;
 
+    outgoingCommand = enet_peer_unindex_sent_reliable_command (peer, reliableSequenceNumber, channelID);
     if (outgoingCommand == NULL)
       return ENET_PROTOCOL_COMMAND_NONE;
 
+    answersLastSend = roundTripTime != NULL && (outgoingCommand -> sentTime & 0xFFFF) == receivedSentTime;
+    if (answersLastSend)
+    {
+       enet_uint32 sample = peer -> host -> serviceTimeMicroseconds - outgoingCommand -> sentTimeMicroseconds;
+
+       if (sample < * roundTripTime)
+         * roundTripTime = sample;
+    }
+
+    /* Only commands waiting on a retransmit timeout are still in transit; the others were
+       put back on the outgoing queue to be resent. */
+    wasSent = outgoingCommand -> retransmitTimer.scheduled;
+
+    /* The acknowledgement of an earlier send of a resent command says nothing about the sends
+       made since, so it must not make them look overtaken. */
+    if (wasSent && (outgoingCommand -> sendAttempts == 1 || answersLastSend) &&
+        outgoingCommand -> sendNumber - peer -> acknowledgedSendNumber < 0x80000000U)
+      peer -> acknowledgedSendNumber = outgoingCommand -> sendNumber;
+
     if (channelID < peer -> channelCount)
     {
        ENetChannel * channel = & peer -> channels [channelID];
@@ -243,8 +304,14 @@ enet_protocol_remove_sent_reliable_command (ENetPeer * peer, enet_uint16 reliabl
 
     commandNumber = (ENetProtocolCommand) (outgoingCommand -> command.header.command & ENET_PROTOCOL_COMMAND_MASK);
     
+    if (! wasSent)
+      enet_protocol_unqueue_resend (peer, outgoingCommand);
+
     enet_list_remove (& outgoingCommand -> outgoingCommandList);
 
+    if (wasSent)
+      enet_timer_wheel_cancel (& peer -> host -> timerWheel, & outgoingCommand -> retransmitTimer);
+
     if (outgoingCommand -> packet != NULL)
     {
        if (wasSent)
@@ -260,27 +327,148 @@ enet_protocol_remove_sent_reliable_command (ENetPeer * peer, enet_uint16 reliabl
        }
     }
 
-    enet_free (outgoingCommand);
-
-    if (enet_list_empty (& peer -> sentReliableCommands))
-      return commandNumber;
-    
-    outgoingCommand = (ENetOutgoingCommand *) enet_list_front (& peer -> sentReliableCommands);
-    
-    peer -> nextTimeout = outgoingCommand -> sentTime + outgoingCommand -> roundTripTimeout;
+    enet_host_free_outgoing_command (peer -> host, outgoingCommand);
 
     return commandNumber;
 } 
 
+#define ENET_COOKIE_ROTATE(x, b) (enet_uint32) (((x) << (b)) | ((x) >> (32 - (b))))
+
+#define ENET_COOKIE_ROUND(v0, v1, v2, v3) \
+    do { \
+        v0 += v1; v1 = ENET_COOKIE_ROTATE (v1, 5); v1 ^= v0; v0 = ENET_COOKIE_ROTATE (v0, 16); \
+        v2 += v3; v3 = ENET_COOKIE_ROTATE (v3, 8); v3 ^= v2; \
+        v0 += v3; v3 = ENET_COOKIE_ROTATE (v3, 7); v3 ^= v0; \
+        v2 += v1; v1 = ENET_COOKIE_ROTATE (v1, 13); v1 ^= v2; v2 = ENET_COOKIE_ROTATE (v2, 16); \
+    } while (0)
+
+/** Computes the MAC of a cookie with HalfSipHash-2-4 keyed by the host's secret, over the
+    address a connect came from, its connect ID and the time the cookie was issued. */
+static enet_uint32
+enet_protocol_cookie_mac (ENetHost * host, const ENetAddress * address, enet_uint32 connectID, enet_uint32 timestamp)
+{
+    enet_uint32 message [5],
+                v0 = host -> cookieSecret [0],
+                v1 = host -> cookieSecret [1],
+                v2 = 0x6C796765 ^ host -> cookieSecret [0],
+                v3 = 0x74656462 ^ host -> cookieSecret [1];
+    size_t messageIndex;
+
+    message [0] = address -> host;
+    message [1] = address -> port;
+    message [2] = connectID;
+    message [3] = timestamp;
+    message [4] = (enet_uint32) (4 * 4) << 24;
+
+    for (messageIndex = 0; messageIndex < sizeof (message) / sizeof (message [0]); ++ messageIndex)
+    {
+        v3 ^= message [messageIndex];
+        ENET_COOKIE_ROUND (v0, v1, v2, v3);
+        ENET_COOKIE_ROUND (v0, v1, v2, v3);
+        v0 ^= message [messageIndex];
+    }
+
+    v2 ^= 0xFF;
+    ENET_COOKIE_ROUND (v0, v1, v2, v3);
+    ENET_COOKIE_ROUND (v0, v1, v2, v3);
+    ENET_COOKIE_ROUND (v0, v1, v2, v3);
+    ENET_COOKIE_ROUND (v0, v1, v2, v3);
+
+    return v1 ^ v3;
+}
+
+static int
+enet_protocol_check_cookie (ENetHost * host, const ENetProtocol * command)
+{
+    enet_uint32 timestamp = ENET_NET_TO_HOST_32 (command -> cookie.timestamp);
+
+    if (ENET_TIME_LESS (host -> serviceTime, timestamp) ||
+        ENET_TIME_DIFFERENCE (host -> serviceTime, timestamp) >= ENET_HOST_COOKIE_LIFETIME)
+      return 0;
+
+    return ENET_NET_TO_HOST_32 (command -> cookie.mac) ==
+             enet_protocol_cookie_mac (host, & host -> receivedAddress, command -> cookie.connectID, timestamp);
+}
+
+/** Answers a connect straight from the socket with a cookie, keeping no state for it. */
+static void
+enet_protocol_send_cookie (ENetHost * host, const ENetProtocol * command)
+{
+    enet_uint8 headerData [sizeof (ENetProtocolHeader) + sizeof (enet_uint32)];
+    ENetProtocolHeader * header = (ENetProtocolHeader *) headerData;
+    ENetProtocolCookie cookie;
+    ENetBuffer buffers [2];
+    int sentLength;
+
+    header -> peerID = ENET_HOST_TO_NET_16 (ENET_NET_TO_HOST_16 (command -> connect.outgoingPeerID) & ENET_PROTOCOL_MAXIMUM_PEER_ID);
+
+    cookie.header.command = ENET_PROTOCOL_COMMAND_COOKIE;
+    cookie.header.channelID = 0xFF;
+    cookie.header.reliableSequenceNumber = 0;
+    cookie.connectID = command -> connect.connectID;
+    cookie.timestamp = ENET_HOST_TO_NET_32 (host -> serviceTime);
+    cookie.mac = ENET_HOST_TO_NET_32 (enet_protocol_cookie_mac (host, & host -> receivedAddress, cookie.connectID, host -> serviceTime));
+
+    buffers [0].data = headerData;
+    buffers [0].dataLength = (size_t) & ((ENetProtocolHeader *) 0) -> sentTime;
+    buffers [1].data = & cookie;
+    buffers [1].dataLength = sizeof (cookie);
+
+    if (host -> checksum != NULL)
+    {
+        enet_uint32 * checksum = (enet_uint32 *) & headerData [buffers [0].dataLength];
+        * checksum = cookie.connectID;
+        buffers [0].dataLength += sizeof (enet_uint32);
+        * checksum = host -> checksum (buffers, 2);
+    }
+
+    sentLength = enet_socket_send (host -> socket, & host -> receivedAddress, buffers, 2);
+
+    host -> totalSendCalls ++;
+
+    if (sentLength > 0)
+    {
+        host -> totalSentData += sentLength;
+        host -> totalSentPackets ++;
+    }
+}
+
+static int
+enet_protocol_handle_cookie (ENetHost * host, ENetPeer * peer, const ENetProtocol * command)
+{
+    if (peer -> state != ENET_PEER_STATE_CONNECTING ||
+        command -> cookie.connectID != peer -> connectID)
+      return 0;
+
+    peer -> connectCookie = command -> cookie;
+
+    /* Resend the connect with the cookie now rather than once its retransmit timeout expires. */
+    while (! enet_list_empty (& peer -> sentReliableCommands))
+    {
+       ENetOutgoingCommand * outgoingCommand = (ENetOutgoingCommand *) enet_list_front (& peer -> sentReliableCommands);
+
+       enet_timer_wheel_cancel (& host -> timerWheel, & outgoingCommand -> retransmitTimer);
+
+       if (outgoingCommand -> packet != NULL)
+         peer -> reliableDataInTransit -= outgoingCommand -> fragmentLength;
+
+       enet_protocol_queue_resend (peer, outgoingCommand);
+    }
+
+    return 0;
+}
+
 static ENetPeer *
-enet_protocol_handle_connect (ENetHost * host, ENetProtocolHeader * header, ENetProtocol * command)
+enet_protocol_handle_connect (ENetHost * host, ENetProtocolHeader * header, ENetProtocol * command, const ENetProtocol * cookie)
 {
 	(void)header;
     enet_uint8 incomingSessionID, outgoingSessionID;
     enet_uint32 mtu, windowSize;
-    ENetChannel * channel;
+    ENetChannel * channel, * channels;
     size_t channelCount, duplicatePeers = 0;
-    ENetPeer * currentPeer, * peer = NULL;
+    ENetPeer * currentPeer, * peer;
+    ENetList * bucket;
+    ENetListIterator currentNode;
     ENetProtocol verifyCommand;
 
     channelCount = ENET_NET_TO_HOST_32 (command -> connect.channelCount);
@@ -289,16 +477,25 @@ enet_protocol_handle_connect (ENetHost * host, ENetProtocolHeader * header, ENet
         channelCount > ENET_PROTOCOL_MAXIMUM_CHANNEL_COUNT)
       return NULL;
 
-    for (currentPeer = host -> peers;
-         currentPeer < & host -> peers [host -> peerCount];
-         ++ currentPeer)
+    if (host -> connectCookies &&
+        (cookie == NULL || cookie -> cookie.connectID != command -> connect.connectID))
     {
-        if (currentPeer -> state == ENET_PEER_STATE_DISCONNECTED)
-        {
-            if (peer == NULL)
-              peer = currentPeer;
-        }
-        else 
+        enet_protocol_send_cookie (host, command);
+
+        return NULL;
+    }
+
+    if (enet_list_empty (& host -> freePeers))
+      return NULL;
+
+    /* Only peers from the same IP address can be duplicates, and they all share a bucket. */
+    bucket = enet_host_address_bucket (host, host -> receivedAddress.host);
+    for (currentNode = enet_list_begin (bucket);
+         currentNode != enet_list_end (bucket);
+         currentNode = enet_list_next (currentNode))
+    {
+        currentPeer = (ENetPeer *) ((enet_uint8 *) currentNode - (size_t) & ((ENetPeer *) 0) -> addressList);
+
         if (currentPeer -> state != ENET_PEER_STATE_CONNECTING &&
             currentPeer -> address.host == host -> receivedAddress.host)
         {
@@ -306,22 +503,25 @@ enet_protocol_handle_connect (ENetHost * host, ENetProtocolHeader * header, ENet
                 currentPeer -> connectID == command -> connect.connectID)
               return NULL;
 
-            ++ duplicatePeers;
+            if (++ duplicatePeers >= host -> duplicatePeers)
+              return NULL;
         }
     }
 
-    if (peer == NULL || duplicatePeers >= host -> duplicatePeers)
+    if (duplicatePeers >= host -> duplicatePeers)
       return NULL;
 
     if (channelCount > host -> channelLimit)
       channelCount = host -> channelLimit;
-    peer -> channels = (ENetChannel *) enet_malloc (channelCount * sizeof (ENetChannel));
-    if (peer -> channels == NULL)
+    channels = (ENetChannel *) enet_malloc (channelCount * sizeof (ENetChannel));
+    if (channels == NULL)
       return NULL;
+
+    peer = enet_host_allocate_peer (host, & host -> receivedAddress);
+    peer -> channels = channels;
     peer -> channelCount = channelCount;
     peer -> state = ENET_PEER_STATE_ACKNOWLEDGING_CONNECT;
     peer -> connectID = command -> connect.connectID;
-    peer -> address = host -> receivedAddress;
     peer -> outgoingPeerID = ENET_NET_TO_HOST_16 (command -> connect.outgoingPeerID);
     peer -> incomingBandwidth = ENET_NET_TO_HOST_32 (command -> connect.incomingBandwidth);
     peer -> outgoingBandwidth = ENET_NET_TO_HOST_32 (command -> connect.outgoingBandwidth);
@@ -351,7 +551,11 @@ enet_protocol_handle_connect (ENetHost * host, ENetProtocolHeader * header, ENet
         channel -> incomingReliableSequenceNumber = 0;
         channel -> incomingUnreliableSequenceNumber = 0;
 
-        enet_list_clear (& channel -> incomingReliableCommands);
+        channel -> incomingReliableRing = NULL;
+        channel -> incomingReliableRingMask = 0;
+        channel -> incomingReliableCount = 0;
+        channel -> sentReliableRing = NULL;
+        channel -> sentReliableRingMask = 0;
         enet_list_clear (& channel -> incomingUnreliableCommands);
 
         channel -> usedReliableWindows = 0;
@@ -404,6 +608,12 @@ enet_protocol_handle_connect (ENetHost * host, ENetProtocolHeader * header, ENet
       windowSize = ENET_PROTOCOL_MAXIMUM_WINDOW_SIZE;
 
     verifyCommand.header.command = ENET_PROTOCOL_COMMAND_VERIFY_CONNECT | ENET_PROTOCOL_COMMAND_FLAG_ACKNOWLEDGE;
+    if (command -> header.command & ENET_PROTOCOL_COMMAND_FLAG_SELECTIVE_ACKNOWLEDGE)
+    {
+       peer -> selectiveAcknowledgements = 1;
+
+       verifyCommand.header.command |= ENET_PROTOCOL_COMMAND_FLAG_SELECTIVE_ACKNOWLEDGE;
+    }
     verifyCommand.header.channelID = 0xFF;
     verifyCommand.verifyConnect.outgoingPeerID = ENET_HOST_TO_NET_16 (peer -> incomingPeerID);
     verifyCommand.verifyConnect.incomingSessionID = incomingSessionID;
@@ -524,8 +734,7 @@ enet_protocol_handle_send_fragment (ENetHost * host, ENetPeer * peer, const ENet
            totalLength;
     ENetChannel * channel;
     enet_uint16 startWindow, currentWindow;
-    ENetListIterator currentCommand;
-    ENetIncomingCommand * startCommand = NULL;
+    ENetIncomingCommand * startCommand;
 
     if (command -> header.channelID >= peer -> channelCount ||
         (peer -> state != ENET_PEER_STATE_CONNECTED && peer -> state != ENET_PEER_STATE_DISCONNECT_LATER))
@@ -561,35 +770,12 @@ enet_protocol_handle_send_fragment (ENetHost * host, ENetPeer * peer, const ENet
         fragmentLength > totalLength - fragmentOffset)
       return -1;
  
-    for (currentCommand = enet_list_previous (enet_list_end (& channel -> incomingReliableCommands));
-         currentCommand != enet_list_end (& channel -> incomingReliableCommands);
-         currentCommand = enet_list_previous (currentCommand))
-    {
-       ENetIncomingCommand * incomingCommand = (ENetIncomingCommand *) currentCommand;
-
-       if (startSequenceNumber >= channel -> incomingReliableSequenceNumber)
-       {
-          if (incomingCommand -> reliableSequenceNumber < channel -> incomingReliableSequenceNumber)
-            continue;
-       }
-       else
-       if (incomingCommand -> reliableSequenceNumber >= channel -> incomingReliableSequenceNumber)
-         break;
-
-       if (incomingCommand -> reliableSequenceNumber <= startSequenceNumber)
-       {
-          if (incomingCommand -> reliableSequenceNumber < startSequenceNumber)
-            break;
-        
-          if ((incomingCommand -> command.header.command & ENET_PROTOCOL_COMMAND_MASK) != ENET_PROTOCOL_COMMAND_SEND_FRAGMENT ||
-              totalLength != incomingCommand -> packet -> dataLength ||
-              fragmentCount != incomingCommand -> fragmentCount)
-            return -1;
-
-          startCommand = incomingCommand;
-          break;
-       }
-    }
+    startCommand = enet_peer_find_incoming_reliable_command (channel, startSequenceNumber);
+    if (startCommand != NULL &&
+        ((startCommand -> command.header.command & ENET_PROTOCOL_COMMAND_MASK) != ENET_PROTOCOL_COMMAND_SEND_FRAGMENT ||
+         totalLength != startCommand -> packet -> dataLength ||
+         fragmentCount != startCommand -> fragmentCount))
+      return -1;
  
     if (startCommand == NULL)
     {
@@ -829,7 +1015,9 @@ enet_protocol_handle_acknowledge (ENetHost * host, ENetEvent * event, ENetPeer *
 {
     enet_uint32 roundTripTime,
            receivedSentTime,
-           receivedReliableSequenceNumber;
+           receivedMask = 0,
+           reliableDataInTransit;
+    enet_uint16 receivedReliableSequenceNumber;
     ENetProtocolCommand commandNumber;
 
     if (peer -> state == ENET_PEER_STATE_DISCONNECTED || peer -> state == ENET_PEER_STATE_ZOMBIE)
@@ -846,69 +1034,103 @@ enet_protocol_handle_acknowledge (ENetHost * host, ENetEvent * event, ENetPeer *
     peer -> lastReceiveTime = host -> serviceTime;
     peer -> earliestTimeout = 0;
 
-    roundTripTime = ENET_TIME_DIFFERENCE (host -> serviceTime, receivedSentTime);
+    roundTripTime = ~ 0U;
 
-    enet_peer_throttle (peer, roundTripTime);
+    reliableDataInTransit = peer -> reliableDataInTransit;
 
-    peer -> roundTripTimeVariance -= peer -> roundTripTimeVariance / 4;
+    receivedReliableSequenceNumber = ENET_NET_TO_HOST_16 (command -> acknowledge.receivedReliableSequenceNumber);
 
-    if (roundTripTime >= peer -> roundTripTime)
-    {
-       peer -> roundTripTime += (roundTripTime - peer -> roundTripTime) / 8;
-       peer -> roundTripTimeVariance += (roundTripTime - peer -> roundTripTime) / 4;
-    }
-    else
+    if ((command -> header.command & ENET_PROTOCOL_COMMAND_MASK) == ENET_PROTOCOL_COMMAND_SELECTIVE_ACKNOWLEDGE)
+      receivedMask = ENET_NET_TO_HOST_32 (command -> selectiveAcknowledge.receivedMask);
+
+    for (;;)
     {
-       peer -> roundTripTime -= (peer -> roundTripTime - roundTripTime) / 8;
-       peer -> roundTripTimeVariance += (peer -> roundTripTime - roundTripTime) / 4;
-    }
+       commandNumber = enet_protocol_remove_sent_reliable_command (peer, receivedReliableSequenceNumber, command -> header.channelID,
+                                                                   (enet_uint16) receivedSentTime, & roundTripTime);
 
-    if (peer -> roundTripTime < peer -> lowestRoundTripTime)
-      peer -> lowestRoundTripTime = peer -> roundTripTime;
+       switch (peer -> state)
+       {
+       case ENET_PEER_STATE_ACKNOWLEDGING_CONNECT:
+          if (commandNumber != ENET_PROTOCOL_COMMAND_VERIFY_CONNECT)
+            return -1;
 
-    if (peer -> roundTripTimeVariance > peer -> highestRoundTripTimeVariance) 
-      peer -> highestRoundTripTimeVariance = peer -> roundTripTimeVariance;
+          enet_protocol_notify_connect (host, peer, event);
+          break;
 
-    if (peer -> packetThrottleEpoch == 0 ||
-        ENET_TIME_DIFFERENCE (host -> serviceTime, peer -> packetThrottleEpoch) >= peer -> packetThrottleInterval)
-    {
-        peer -> lastRoundTripTime = peer -> lowestRoundTripTime;
-        peer -> lastRoundTripTimeVariance = peer -> highestRoundTripTimeVariance;
-        peer -> lowestRoundTripTime = peer -> roundTripTime;
-        peer -> highestRoundTripTimeVariance = peer -> roundTripTimeVariance;
-        peer -> packetThrottleEpoch = host -> serviceTime;
+       case ENET_PEER_STATE_DISCONNECTING:
+          if (commandNumber != ENET_PROTOCOL_COMMAND_DISCONNECT)
+            return -1;
+
+          enet_protocol_notify_disconnect (host, peer, event);
+          return 0;
+
+       case ENET_PEER_STATE_DISCONNECT_LATER:
+          if (enet_list_empty (& peer -> outgoingReliableCommands) &&
+              enet_list_empty (& peer -> outgoingUnreliableCommands) &&   
+              enet_list_empty (& peer -> sentReliableCommands))
+            enet_peer_disconnect (peer, peer -> eventData);
+          break;
+
+       default:
+          break;
+       }
+
+       if (receivedMask == 0)
+         break;
+
+       for (++ receivedReliableSequenceNumber; ! (receivedMask & 1); receivedMask >>= 1)
+         ++ receivedReliableSequenceNumber;
+
+       receivedMask >>= 1;
     }
 
-    receivedReliableSequenceNumber = ENET_NET_TO_HOST_16 (command -> acknowledge.receivedReliableSequenceNumber);
+    if (peer -> state == ENET_PEER_STATE_DISCONNECTED || peer -> state == ENET_PEER_STATE_ZOMBIE)
+      return 0;
 
-    commandNumber = enet_protocol_remove_sent_reliable_command (peer, receivedReliableSequenceNumber, command -> header.channelID);
+    /* Without a command sent at the echoed time, such as when it has been resent since, fall back
+       on the time echoed, which only has millisecond resolution. */
+    if (roundTripTime == ~ 0U)
+      roundTripTime = ENET_TIME_DIFFERENCE (host -> serviceTime, receivedSentTime) * 1000;
 
-    switch (peer -> state)
-    {
-    case ENET_PEER_STATE_ACKNOWLEDGING_CONNECT:
-       if (commandNumber != ENET_PROTOCOL_COMMAND_VERIFY_CONNECT)
-         return -1;
+    if (host -> congestionControl.onAcknowledge != NULL)
+      host -> congestionControl.onAcknowledge (host -> congestionControl.context, peer, reliableDataInTransit - peer -> reliableDataInTransit, roundTripTime);
 
-       enet_protocol_notify_connect (host, peer, event);
-       break;
+    peer -> roundTripTimeVarianceMicroseconds -= peer -> roundTripTimeVarianceMicroseconds / 4;
 
-    case ENET_PEER_STATE_DISCONNECTING:
-       if (commandNumber != ENET_PROTOCOL_COMMAND_DISCONNECT)
-         return -1;
+    if (roundTripTime >= peer -> roundTripTimeMicroseconds)
+    {
+       peer -> roundTripTimeMicroseconds += (roundTripTime - peer -> roundTripTimeMicroseconds) / 8;
+       peer -> roundTripTimeVarianceMicroseconds += (roundTripTime - peer -> roundTripTimeMicroseconds) / 4;
+    }
+    else
+    {
+       peer -> roundTripTimeMicroseconds -= (peer -> roundTripTimeMicroseconds - roundTripTime) / 8;
+       peer -> roundTripTimeVarianceMicroseconds += (peer -> roundTripTimeMicroseconds - roundTripTime) / 4;
+    }
 
-       enet_protocol_notify_disconnect (host, peer, event);
-       break;
+    if (peer -> roundTripTimeMicroseconds < peer -> lowestRoundTripTimeMicroseconds)
+      peer -> lowestRoundTripTimeMicroseconds = peer -> roundTripTimeMicroseconds;
 
-    case ENET_PEER_STATE_DISCONNECT_LATER:
-       if (enet_list_empty (& peer -> outgoingReliableCommands) &&
-           enet_list_empty (& peer -> outgoingUnreliableCommands) &&   
-           enet_list_empty (& peer -> sentReliableCommands))
-         enet_peer_disconnect (peer, peer -> eventData);
-       break;
+    if (peer -> roundTripTimeVarianceMicroseconds > peer -> highestRoundTripTimeVarianceMicroseconds) 
+      peer -> highestRoundTripTimeVarianceMicroseconds = peer -> roundTripTimeVarianceMicroseconds;
 
-    default:
-       break;
+    if (peer -> packetThrottleEpoch == 0 ||
+        ENET_TIME_DIFFERENCE (host -> serviceTime, peer -> packetThrottleEpoch) >= peer -> packetThrottleInterval)
+    {
+        peer -> lastRoundTripTimeMicroseconds = peer -> lowestRoundTripTimeMicroseconds;
+        peer -> lastRoundTripTimeVarianceMicroseconds = peer -> highestRoundTripTimeVarianceMicroseconds;
+        peer -> lowestRoundTripTimeMicroseconds = peer -> roundTripTimeMicroseconds;
+        peer -> highestRoundTripTimeVarianceMicroseconds = peer -> roundTripTimeVarianceMicroseconds;
+        peer -> packetThrottleEpoch = host -> serviceTime;
     }
+
+    /* The statistics applications read stay in milliseconds. */
+    peer -> roundTripTime = (peer -> roundTripTimeMicroseconds + 500) / 1000;
+    peer -> roundTripTimeVariance = (peer -> roundTripTimeVarianceMicroseconds + 500) / 1000;
+    peer -> lastRoundTripTime = (peer -> lastRoundTripTimeMicroseconds + 500) / 1000;
+    peer -> lowestRoundTripTime = (peer -> lowestRoundTripTimeMicroseconds + 500) / 1000;
+    peer -> lastRoundTripTimeVariance = (peer -> lastRoundTripTimeVarianceMicroseconds + 500) / 1000;
+    peer -> highestRoundTripTimeVariance = (peer -> highestRoundTripTimeVarianceMicroseconds + 500) / 1000;
    
     return 0;
 }
@@ -937,11 +1159,13 @@ enet_protocol_handle_verify_connect (ENetHost * host, ENetEvent * event, ENetPee
         return -1;
     }
 
-    enet_protocol_remove_sent_reliable_command (peer, 1, 0xFF);
+    enet_protocol_remove_sent_reliable_command (peer, 1, 0xFF, 0, NULL);
     
     if (channelCount < peer -> channelCount)
       peer -> channelCount = channelCount;
 
+    peer -> selectiveAcknowledgements = (command -> header.command & ENET_PROTOCOL_COMMAND_FLAG_SELECTIVE_ACKNOWLEDGE) != 0;
+
     peer -> outgoingPeerID = ENET_NET_TO_HOST_16 (command -> verifyConnect.outgoingPeerID);
     peer -> incomingSessionID = command -> verifyConnect.incomingSessionID;
     peer -> outgoingSessionID = command -> verifyConnect.outgoingSessionID;
@@ -980,6 +1204,7 @@ enet_protocol_handle_incoming_commands (ENetHost * host, ENetEvent * event)
 {
     ENetProtocolHeader * header;
     ENetProtocol * command;
+    const ENetProtocol * cookie = NULL;
     ENetPeer * peer;
     enet_uint8 * currentData;
     size_t headerSize;
@@ -1035,6 +1260,7 @@ enet_protocol_handle_incoming_commands (ENetHost * host, ENetEvent * event)
 
         memcpy (host -> packetData [1], header, headerSize);
         host -> receivedData = host -> packetData [1];
+        host -> receivedSlab = NULL;
         host -> receivedDataLength = headerSize + originalSize;
     }
 
@@ -1055,8 +1281,7 @@ enet_protocol_handle_incoming_commands (ENetHost * host, ENetEvent * event)
        
     if (peer != NULL)
     {
-       peer -> address.host = host -> receivedAddress.host;
-       peer -> address.port = host -> receivedAddress.port;
+       enet_host_set_peer_address (host, peer, & host -> receivedAddress);
        peer -> incomingDataTotal += host -> receivedDataLength;
     }
     
@@ -1082,7 +1307,7 @@ enet_protocol_handle_incoming_commands (ENetHost * host, ENetEvent * event)
 
        currentData += commandSize;
 
-       if (peer == NULL && commandNumber != ENET_PROTOCOL_COMMAND_CONNECT)
+       if (peer == NULL && commandNumber != ENET_PROTOCOL_COMMAND_CONNECT && commandNumber != ENET_PROTOCOL_COMMAND_COOKIE)
          break;
          
        command -> header.reliableSequenceNumber = ENET_NET_TO_HOST_16 (command -> header.reliableSequenceNumber);
@@ -1090,6 +1315,7 @@ enet_protocol_handle_incoming_commands (ENetHost * host, ENetEvent * event)
        switch (commandNumber)
        {
        case ENET_PROTOCOL_COMMAND_ACKNOWLEDGE:
+       case ENET_PROTOCOL_COMMAND_SELECTIVE_ACKNOWLEDGE:
           if (enet_protocol_handle_acknowledge (host, event, peer, command))
             goto commandError;
           break;
@@ -1097,7 +1323,7 @@ enet_protocol_handle_incoming_commands (ENetHost * host, ENetEvent * event)
        case ENET_PROTOCOL_COMMAND_CONNECT:
           if (peer != NULL)
             goto commandError;
-          peer = enet_protocol_handle_connect (host, header, command);
+          peer = enet_protocol_handle_connect (host, header, command, cookie);
           if (peer == NULL)
             goto commandError;
           break;
@@ -1152,6 +1378,18 @@ enet_protocol_handle_incoming_commands (ENetHost * host, ENetEvent * event)
             goto commandError;
           break;
 
+       case ENET_PROTOCOL_COMMAND_COOKIE:
+          if (peer == NULL)
+          {
+             /* An echoed cookie only vouches for a connect later in the same datagram. */
+             if (host -> connectCookies && enet_protocol_check_cookie (host, command))
+               cookie = command;
+          }
+          else
+          if (enet_protocol_handle_cookie (host, peer, command))
+            goto commandError;
+          break;
+
        default:
           goto commandError;
        }
@@ -1187,6 +1425,19 @@ enet_protocol_handle_incoming_commands (ENetHost * host, ENetEvent * event)
     }
 
 commandError:
+    /* Acknowledgements and bandwidth changes may have opened the window for queued commands. */
+    if (peer != NULL)
+    {
+       enet_peer_schedule_ping (peer);
+
+       if (peer -> state != ENET_PEER_STATE_DISCONNECTED && peer -> state != ENET_PEER_STATE_ZOMBIE)
+         enet_protocol_fast_retransmit (host, peer);
+
+       if (! enet_list_empty (& peer -> outgoingReliableCommands) ||
+           ! enet_list_empty (& peer -> outgoingUnreliableCommands))
+         enet_peer_activate (peer);
+    }
+
     if (event != NULL && event -> type != ENET_EVENT_TYPE_NONE)
       return 1;
 
@@ -1198,27 +1449,55 @@ enet_protocol_receive_incoming_commands (ENetHost * host, ENetEvent * event)
 {
     for (;;)
     {
-       int receivedLength;
-       ENetBuffer buffer;
+       ENetDatagram * datagram;
 
-       buffer.data = host -> packetData [0];
-       buffer.dataLength = sizeof (host -> packetData [0]);
+       if (host -> receivedDatagramIndex >= host -> receivedDatagramCount)
+       {
+          int receivedCount;
 
-       receivedLength = enet_socket_receive (host -> socket,
-                                             & host -> receivedAddress,
-                                             & buffer,
-                                             1);
+          host -> receivedDatagramIndex = 0;
+          host -> receivedDatagramCount = 0;
+          host -> receivedSegmentOffset = 0;
 
-       if (receivedLength < 0)
-         return -1;
+          if (host -> zeroCopyReceive && enet_host_renew_receive_slabs (host) < 0)
+            return -1;
 
-       if (receivedLength == 0)
-         return 0;
+          receivedCount = enet_socket_receive_batch (host -> socket,
+                                                     host -> receivedDatagrams,
+                                                     ENET_HOST_RECEIVE_BATCH_SIZE);
+
+          host -> totalReceiveCalls ++;
 
-       host -> receivedData = host -> packetData [0];
-       host -> receivedDataLength = receivedLength;
+          if (receivedCount < 0)
+            return -1;
+
+          if (receivedCount == 0)
+            return 0;
+
+          host -> receivedDatagramCount = receivedCount;
+       }
+
+       /* Datagrams left over when an event is returned stay queued in the
+          batch and are handled on the next call before the socket is read.
+          Datagrams coalesced by segmentation offload are handled one segment
+          at a time. */
+       datagram = & host -> receivedDatagrams [host -> receivedDatagramIndex];
+
+       host -> receivedAddress = datagram -> address;
+       host -> receivedSlab = host -> receivedSlabs [host -> receivedDatagramIndex];
+       host -> receivedData = (enet_uint8 *) datagram -> buffers [0].data + host -> receivedSegmentOffset;
+       host -> receivedDataLength = datagram -> dataLength - host -> receivedSegmentOffset;
+       if (datagram -> segmentSize > 0 && host -> receivedDataLength > datagram -> segmentSize)
+         host -> receivedDataLength = datagram -> segmentSize;
+
+       host -> receivedSegmentOffset += host -> receivedDataLength;
+       if (host -> receivedSegmentOffset >= datagram -> dataLength)
+       {
+          host -> receivedDatagramIndex ++;
+          host -> receivedSegmentOffset = 0;
+       }
       
-       host -> totalReceivedData += receivedLength;
+       host -> totalReceivedData += host -> receivedDataLength;
        host -> totalReceivedPackets ++;
 
        if (host -> intercept != NULL)
@@ -1261,36 +1540,42 @@ enet_protocol_send_acknowledgements (ENetHost * host, ENetPeer * peer)
     ENetAcknowledgement * acknowledgement;
     ENetListIterator currentAcknowledgement;
     enet_uint16 reliableSequenceNumber;
+    size_t commandSize;
  
     currentAcknowledgement = enet_list_begin (& peer -> acknowledgements);
          
     while (currentAcknowledgement != enet_list_end (& peer -> acknowledgements))
     {
+       acknowledgement = (ENetAcknowledgement *) currentAcknowledgement;
+
+       commandSize = acknowledgement -> receivedMask != 0 ? sizeof (ENetProtocolSelectiveAcknowledge) : sizeof (ENetProtocolAcknowledge);
+
        if (command >= & host -> commands [sizeof (host -> commands) / sizeof (ENetProtocol)] ||
            buffer >= & host -> buffers [sizeof (host -> buffers) / sizeof (ENetBuffer)] ||
-           peer -> mtu - host -> packetSize < sizeof (ENetProtocolAcknowledge))
+           peer -> mtu - host -> packetSize < commandSize)
        {
           host -> continueSending = 1;
 
           break;
        }
 
-       acknowledgement = (ENetAcknowledgement *) currentAcknowledgement;
- 
        currentAcknowledgement = enet_list_next (currentAcknowledgement);
 
        buffer -> data = command;
-       buffer -> dataLength = sizeof (ENetProtocolAcknowledge);
+       buffer -> dataLength = commandSize;
 
        host -> packetSize += buffer -> dataLength;
 
        reliableSequenceNumber = ENET_HOST_TO_NET_16 (acknowledgement -> command.header.reliableSequenceNumber);
   
-       command -> header.command = ENET_PROTOCOL_COMMAND_ACKNOWLEDGE;
+       command -> header.command = acknowledgement -> receivedMask != 0 ? ENET_PROTOCOL_COMMAND_SELECTIVE_ACKNOWLEDGE : ENET_PROTOCOL_COMMAND_ACKNOWLEDGE;
        command -> header.channelID = acknowledgement -> command.header.channelID;
        command -> header.reliableSequenceNumber = reliableSequenceNumber;
        command -> acknowledge.receivedReliableSequenceNumber = reliableSequenceNumber;
        command -> acknowledge.receivedSentTime = ENET_HOST_TO_NET_16 (acknowledgement -> sentTime);
+
+       if (acknowledgement -> receivedMask != 0)
+         command -> selectiveAcknowledge.receivedMask = ENET_HOST_TO_NET_32 (acknowledgement -> receivedMask);
   
        if ((acknowledgement -> command.header.command & ENET_PROTOCOL_COMMAND_MASK) == ENET_PROTOCOL_COMMAND_DISCONNECT)
          enet_protocol_dispatch_state (host, peer, ENET_PEER_STATE_ZOMBIE);
@@ -1353,7 +1638,7 @@ enet_protocol_send_unreliable_outgoing_commands (ENetHost * host, ENetPeer * pee
                   enet_packet_destroy (outgoingCommand -> packet);
          
                 enet_list_remove (& outgoingCommand -> outgoingCommandList);
-                enet_free (outgoingCommand);
+                enet_host_free_outgoing_command (host, outgoingCommand);
 
                 if (currentCommand == enet_list_end (& peer -> outgoingUnreliableCommands))
                   break;
@@ -1391,7 +1676,7 @@ enet_protocol_send_unreliable_outgoing_commands (ENetHost * host, ENetPeer * pee
           enet_list_insert (enet_list_end (& peer -> sentUnreliableCommands), outgoingCommand);
        }
        else
-         enet_free (outgoingCommand);
+         enet_host_free_outgoing_command (host, outgoingCommand);
 
        ++ command;
        ++ buffer;
@@ -1404,58 +1689,34 @@ enet_protocol_send_unreliable_outgoing_commands (ENetHost * host, ENetPeer * pee
         enet_list_empty (& peer -> outgoingReliableCommands) &&
         enet_list_empty (& peer -> outgoingUnreliableCommands) && 
         enet_list_empty (& peer -> sentReliableCommands))
+    {
       enet_peer_disconnect (peer, peer -> eventData);
+
+      /* The peer is still being serviced, so make sure the disconnect goes out in another pass. */
+      host -> continueSending = 1;
+    }
 }
 
 static int
-enet_protocol_check_timeouts (ENetHost * host, ENetPeer * peer, ENetEvent * event)
+enet_protocol_check_timeout (ENetHost * host, ENetPeer * peer, ENetOutgoingCommand * outgoingCommand, ENetEvent * event)
 {
-    ENetOutgoingCommand * outgoingCommand;
-    ENetListIterator currentCommand, insertPosition;
-
-    currentCommand = enet_list_begin (& peer -> sentReliableCommands);
-    insertPosition = enet_list_begin (& peer -> outgoingReliableCommands);
-
-    while (currentCommand != enet_list_end (& peer -> sentReliableCommands))
+    if (peer -> earliestTimeout == 0 ||
+        ENET_TIME_LESS (outgoingCommand -> sentTime, peer -> earliestTimeout))
+      peer -> earliestTimeout = outgoingCommand -> sentTime;
+
+    if (peer -> earliestTimeout != 0 &&
+          (ENET_TIME_DIFFERENCE (host -> serviceTime, peer -> earliestTimeout) >= peer -> timeoutMaximum ||
+            (outgoingCommand -> roundTripTimeout >= outgoingCommand -> roundTripTimeoutLimit &&
+              ENET_TIME_DIFFERENCE (host -> serviceTime, peer -> earliestTimeout) >= peer -> timeoutMinimum)))
     {
-       outgoingCommand = (ENetOutgoingCommand *) currentCommand;
-
-       currentCommand = enet_list_next (currentCommand);
-
-       if (ENET_TIME_DIFFERENCE (host -> serviceTime, outgoingCommand -> sentTime) < outgoingCommand -> roundTripTimeout)
-         continue;
-
-       if (peer -> earliestTimeout == 0 ||
-           ENET_TIME_LESS (outgoingCommand -> sentTime, peer -> earliestTimeout))
-         peer -> earliestTimeout = outgoingCommand -> sentTime;
-
-       if (peer -> earliestTimeout != 0 &&
-             (ENET_TIME_DIFFERENCE (host -> serviceTime, peer -> earliestTimeout) >= peer -> timeoutMaximum ||
-               (outgoingCommand -> roundTripTimeout >= outgoingCommand -> roundTripTimeoutLimit &&
-                 ENET_TIME_DIFFERENCE (host -> serviceTime, peer -> earliestTimeout) >= peer -> timeoutMinimum)))
-       {
-          enet_protocol_notify_disconnect (host, peer, event);
-
-          return 1;
-       }
-
-       if (outgoingCommand -> packet != NULL)
-         peer -> reliableDataInTransit -= outgoingCommand -> fragmentLength;
-          
-       ++ peer -> packetsLost;
-
-       outgoingCommand -> roundTripTimeout *= 2;
+       enet_protocol_notify_disconnect (host, peer, event);
 
-       enet_list_insert (insertPosition, enet_list_remove (& outgoingCommand -> outgoingCommandList));
+       return 1;
+    }
 
-       if (currentCommand == enet_list_begin (& peer -> sentReliableCommands) &&
-           ! enet_list_empty (& peer -> sentReliableCommands))
-       {
-          outgoingCommand = (ENetOutgoingCommand *) currentCommand;
+    outgoingCommand -> roundTripTimeout *= 2;
 
-          peer -> nextTimeout = outgoingCommand -> sentTime + outgoingCommand -> roundTripTimeout;
-       }
-    }
+    enet_protocol_requeue_sent_reliable_command (peer, outgoingCommand);
     
     return 0;
 }
@@ -1469,7 +1730,7 @@ enet_protocol_send_reliable_outgoing_commands (ENetHost * host, ENetPeer * peer)
     ENetListIterator currentCommand;
     ENetChannel *channel;
     enet_uint16 reliableWindow;
-    size_t commandSize;
+    size_t commandSize, cookieSize;
     int windowExceeded = 0, windowWrap = 0, canPing = 1;
 
     currentCommand = enet_list_begin (& peer -> outgoingReliableCommands);
@@ -1501,7 +1762,15 @@ enet_protocol_send_reliable_outgoing_commands (ENetHost * host, ENetPeer * peer)
        {
           if (! windowExceeded)
           {
-             enet_uint32 windowSize = (peer -> packetThrottle * peer -> windowSize) / ENET_PEER_PACKET_THROTTLE_SCALE;
+             enet_uint32 windowSize = peer -> windowSize;
+
+             if (host -> congestionControl.congestionWindow != NULL)
+             {
+                enet_uint32 congestionWindow = host -> congestionControl.congestionWindow (host -> congestionControl.context, peer);
+
+                if (congestionWindow < windowSize)
+                  windowSize = congestionWindow;
+             }
              
              if (peer -> reliableDataInTransit + outgoingCommand -> fragmentLength > ENET_MAX (windowSize, peer -> mtu))
                windowExceeded = 1;
@@ -1517,9 +1786,11 @@ enet_protocol_send_reliable_outgoing_commands (ENetHost * host, ENetPeer * peer)
        canPing = 0;
 
        commandSize = commandSizes [outgoingCommand -> command.header.command & ENET_PROTOCOL_COMMAND_MASK];
-       if (command >= & host -> commands [sizeof (host -> commands) / sizeof (ENetProtocol)] ||
-           buffer + 1 >= & host -> buffers [sizeof (host -> buffers) / sizeof (ENetBuffer)] ||
-           peer -> mtu - host -> packetSize < commandSize ||
+       cookieSize = (outgoingCommand -> command.header.command & ENET_PROTOCOL_COMMAND_MASK) == ENET_PROTOCOL_COMMAND_CONNECT &&
+                      peer -> connectCookie.header.command != ENET_PROTOCOL_COMMAND_NONE ? sizeof (ENetProtocolCookie) : 0;
+       if (command + (cookieSize > 0) >= & host -> commands [sizeof (host -> commands) / sizeof (ENetProtocol)] ||
+           buffer + 1 + (cookieSize > 0) >= & host -> buffers [sizeof (host -> buffers) / sizeof (ENetBuffer)] ||
+           peer -> mtu - host -> packetSize < commandSize + cookieSize ||
            (outgoingCommand -> packet != NULL && 
              (enet_uint16) (peer -> mtu - host -> packetSize) < (enet_uint16) (commandSize + outgoingCommand -> fragmentLength)))
        {
@@ -1528,6 +1799,10 @@ enet_protocol_send_reliable_outgoing_commands (ENetHost * host, ENetPeer * peer)
           break;
        }
 
+       if (outgoingCommand -> sendAttempts < 1 &&
+           enet_peer_index_sent_reliable_command (peer, outgoingCommand) < 0)
+         break;
+
        currentCommand = enet_list_next (currentCommand);
 
        if (channel != NULL && outgoingCommand -> sendAttempts < 1)
@@ -1537,20 +1812,42 @@ enet_protocol_send_reliable_outgoing_commands (ENetHost * host, ENetPeer * peer)
        }
 
        ++ outgoingCommand -> sendAttempts;
+       outgoingCommand -> sendNumber = peer -> reliableSendNumber ++;
  
        if (outgoingCommand -> roundTripTimeout == 0)
        {
-          outgoingCommand -> roundTripTimeout = peer -> roundTripTime + 4 * peer -> roundTripTimeVariance;
+          /* The variance of a steady path shrinks to almost nothing, so allow at least a quarter of the
+             round trip time for it. The round trip time is kept in microseconds, but the timer wheel
+             counts milliseconds and the command may be sent late in the millisecond it is stamped with,
+             so allow one more. */
+          outgoingCommand -> roundTripTimeout = (peer -> roundTripTimeMicroseconds + ENET_MAX (4 * peer -> roundTripTimeVarianceMicroseconds, peer -> roundTripTimeMicroseconds / 4) + 999) / 1000 + 1;
           outgoingCommand -> roundTripTimeoutLimit = peer -> timeoutLimit * outgoingCommand -> roundTripTimeout;
        }
 
-       if (enet_list_empty (& peer -> sentReliableCommands))
-         peer -> nextTimeout = host -> serviceTime + outgoingCommand -> roundTripTimeout;
+       enet_protocol_unqueue_resend (peer, outgoingCommand);
 
        enet_list_insert (enet_list_end (& peer -> sentReliableCommands),
                          enet_list_remove (& outgoingCommand -> outgoingCommandList));
 
        outgoingCommand -> sentTime = host -> serviceTime;
+       outgoingCommand -> sentTimeMicroseconds = host -> serviceTimeMicroseconds;
+
+       enet_timer_wheel_schedule (& host -> timerWheel, & outgoingCommand -> retransmitTimer,
+                                  outgoingCommand -> sentTime + outgoingCommand -> roundTripTimeout);
+
+       if (cookieSize > 0)
+       {
+          /* The foreign host only takes the connect if its cookie comes first in the datagram. */
+          buffer -> data = command;
+          buffer -> dataLength = cookieSize;
+
+          host -> packetSize += buffer -> dataLength;
+
+          command -> cookie = peer -> connectCookie;
+
+          ++ command;
+          ++ buffer;
+       }
 
        buffer -> data = command;
        buffer -> dataLength = commandSize;
@@ -1570,6 +1867,9 @@ enet_protocol_send_reliable_outgoing_commands (ENetHost * host, ENetPeer * peer)
           host -> packetSize += outgoingCommand -> fragmentLength;
 
           peer -> reliableDataInTransit += outgoingCommand -> fragmentLength;
+
+          if (host -> congestionControl.onSend != NULL)
+            host -> congestionControl.onSend (host -> congestionControl.context, peer, outgoingCommand -> fragmentLength);
        }
 
        ++ peer -> packetsSent;
@@ -1584,27 +1884,296 @@ enet_protocol_send_reliable_outgoing_commands (ENetHost * host, ENetPeer * peer)
     return canPing;
 }
 
+/* Replaces the datagrams of a batch that failed to send with one datagram per segment of those
+   that were not sent, counting the data of those that were. Each segment is made of whole buffers,
+   since segments are only appended one datagram at a time. Returns 0, leaving the batch as it is,
+   if no datagram left to send was segmented. */
+static int
+enet_protocol_unsegment_outgoing_datagrams (ENetHost * host)
+{
+    ENetDatagram datagrams [ENET_HOST_SEND_BATCH_SIZE];
+    size_t datagramCount = host -> sendDatagramCount, datagramIndex, bufferIndex;
+
+    for (datagramIndex = 0; datagramIndex < datagramCount; ++ datagramIndex)
+      if (host -> sendDatagrams [datagramIndex].dataLength == 0 && host -> sendDatagrams [datagramIndex].segmentSize > 0)
+        break;
+
+    if (datagramIndex >= datagramCount)
+      return 0;
+
+    memcpy (datagrams, host -> sendDatagrams, datagramCount * sizeof (ENetDatagram));
+
+    host -> sendDatagramCount = 0;
+
+    for (datagramIndex = 0; datagramIndex < datagramCount; ++ datagramIndex)
+    {
+        const ENetDatagram * datagram = & datagrams [datagramIndex];
+
+        if (datagram -> dataLength > 0)
+        {
+           host -> totalSentData += datagram -> dataLength;
+
+           continue;
+        }
+
+        for (bufferIndex = 0; bufferIndex < datagram -> bufferCount; )
+        {
+           ENetDatagram * segment = & host -> sendDatagrams [host -> sendDatagramCount ++];
+           size_t segmentLength = 0;
+
+           segment -> address = datagram -> address;
+           segment -> buffers = & datagram -> buffers [bufferIndex];
+           segment -> segmentSize = 0;
+
+           do
+             segmentLength += datagram -> buffers [bufferIndex ++].dataLength;
+           while (bufferIndex < datagram -> bufferCount &&
+                  (datagram -> segmentSize == 0 || segmentLength < datagram -> segmentSize));
+
+           segment -> bufferCount = & datagram -> buffers [bufferIndex] - segment -> buffers;
+           segment -> dataLength = segmentLength;
+        }
+    }
+
+    return 1;
+}
+
+static int
+enet_protocol_flush_outgoing_datagrams (ENetHost * host)
+{
+    size_t datagramIndex;
+    int sentCount;
+
+    if (host -> outgoingDatagramCount == 0)
+      return 0;
+
+    sentCount = enet_socket_send_batch (host -> socket, host -> sendDatagrams, host -> sendDatagramCount, & host -> totalSendCalls);
+
+    /* The kernel or the device may refuse to segment, such as with EIO from a device that cannot
+       checksum segments or EINVAL from one whose MTU is too small. If sending the rest of the batch
+       one segment per datagram works, segmentation was the problem, so stop using it. */
+    if (sentCount < 0 && host -> segmentationOffload &&
+        enet_protocol_unsegment_outgoing_datagrams (host))
+    {
+        sentCount = enet_socket_send_batch (host -> socket, host -> sendDatagrams, host -> sendDatagramCount, & host -> totalSendCalls);
+        if (sentCount >= 0)
+          host -> segmentationOffload = 0;
+    }
+
+    for (datagramIndex = 0; datagramIndex < host -> outgoingDatagramCount; ++ datagramIndex)
+    {
+        /* Unreliable commands were kept alive until now since the batch still referenced their packets. */
+        enet_protocol_remove_sent_unreliable_commands (host -> outgoingDatagrams [datagramIndex].peer);
+    }
+
+    if (sentCount >= 0)
+    {
+        for (datagramIndex = 0; datagramIndex < host -> sendDatagramCount; ++ datagramIndex)
+          host -> totalSentData += host -> sendDatagrams [datagramIndex].dataLength;
+
+        host -> totalSentPackets += host -> outgoingDatagramCount;
+    }
+
+    host -> outgoingDatagramCount = 0;
+    host -> sendDatagramCount = 0;
+    host -> sendBufferCount = 0;
+
+    return sentCount < 0 ? -1 : 0;
+}
+
+static void
+enet_protocol_queue_outgoing_datagram (ENetHost * host, ENetPeer * peer)
+{
+    ENetOutgoingDatagram * outgoingDatagram = & host -> outgoingDatagrams [host -> outgoingDatagramCount];
+    ENetBuffer * buffers = & host -> sendBuffers [host -> sendBufferCount];
+    ENetDatagram * datagram = host -> sendDatagramCount > 0 ? & host -> sendDatagrams [host -> sendDatagramCount - 1] : NULL;
+    const enet_uint8 * commandsBegin = (const enet_uint8 *) host -> commands,
+                     * commandsEnd = (const enet_uint8 *) & host -> commands [host -> commandCount];
+    size_t bufferIndex, dataLength = 0, segmentSize;
+
+    memcpy (outgoingDatagram -> commands, host -> commands, host -> commandCount * sizeof (ENetProtocol));
+
+    for (bufferIndex = 0; bufferIndex < host -> bufferCount; ++ bufferIndex)
+    {
+        ENetBuffer * buffer = & buffers [bufferIndex];
+
+        * buffer = host -> buffers [bufferIndex];
+
+        if ((const enet_uint8 *) buffer -> data >= commandsBegin && (const enet_uint8 *) buffer -> data < commandsEnd)
+          buffer -> data = (enet_uint8 *) outgoingDatagram -> commands + ((const enet_uint8 *) buffer -> data - commandsBegin);
+
+        dataLength += buffer -> dataLength;
+    }
+
+    outgoingDatagram -> peer = peer;
+
+    ++ host -> outgoingDatagramCount;
+    host -> sendBufferCount += host -> bufferCount;
+
+    /* With segmentation offload a datagram no larger than the previous ones
+       to the same address is appended to them as one more segment. Buffers
+       are allocated contiguously across the batch so this only needs the
+       previous datagram's buffer count extended. */
+    if (datagram != NULL && host -> segmentationOffload)
+    {
+        segmentSize = datagram -> segmentSize > 0 ? datagram -> segmentSize : datagram -> dataLength;
+
+        if (datagram -> address.host == peer -> address.host &&
+            datagram -> address.port == peer -> address.port &&
+            datagram -> dataLength % segmentSize == 0 &&
+            dataLength <= segmentSize &&
+            datagram -> dataLength / segmentSize < ENET_HOST_SEGMENT_MAXIMUM_COUNT &&
+            datagram -> dataLength + dataLength <= ENET_HOST_SEGMENT_MAXIMUM_SIZE &&
+            datagram -> bufferCount + host -> bufferCount <= ENET_HOST_SEGMENT_MAXIMUM_BUFFERS)
+        {
+            datagram -> segmentSize = segmentSize;
+            datagram -> bufferCount += host -> bufferCount;
+            datagram -> dataLength += dataLength;
+
+            return;
+        }
+    }
+
+    datagram = & host -> sendDatagrams [host -> sendDatagramCount ++];
+    datagram -> address = peer -> address;
+    datagram -> buffers = buffers;
+    datagram -> bufferCount = host -> bufferCount;
+    datagram -> dataLength = dataLength;
+    datagram -> segmentSize = 0;
+}
+
+static int
+enet_protocol_expire_timers (ENetHost * host, ENetEvent * event)
+{
+    ENetTimer * timer;
+
+    while ((timer = enet_timer_wheel_expire (& host -> timerWheel, host -> serviceTime)) != NULL)
+    {
+        ENetPeer * peer = (ENetPeer *) timer -> data;
+
+        if (peer -> state == ENET_PEER_STATE_DISCONNECTED ||
+            peer -> state == ENET_PEER_STATE_ZOMBIE)
+          continue;
+
+        switch (timer -> type)
+        {
+        case ENET_TIMER_TYPE_PING:
+        case ENET_TIMER_TYPE_PACING:
+           enet_peer_activate (peer);
+           break;
+
+        case ENET_TIMER_TYPE_RETRANSMIT:
+           if (enet_protocol_check_timeout (host, peer,
+                 (ENetOutgoingCommand *) ((enet_uint8 *) timer - (size_t) & ((ENetOutgoingCommand *) 0) -> retransmitTimer),
+                 event) == 1 &&
+               event != NULL && event -> type != ENET_EVENT_TYPE_NONE)
+             return 1;
+           break;
+        }
+    }
+
+    return 0;
+}
+
+/* Gives the peer credit for the time since it was last paced, up to a millisecond of sending or
+   two datagrams, whichever is more, or up to ENET_PEER_PACING_CATCH_UP_TIME if it was held back
+   with more to send. The credit is counted in microseconds so that frequent calls to
+   enet_host_service() do not each round it away. Returns 1 if the peer has used its credit up
+   and must wait for its pacing timer. */
+static int
+enet_protocol_check_pacing (ENetHost * host, ENetPeer * peer)
+{
+    enet_uint32 pacingRate = host -> congestionControl.pacingRate (host -> congestionControl.context, peer),
+                elapsedTime, burst, credit, waitTime;
+
+    if (pacingRate == 0)
+    {
+       peer -> pacingCredit = 0;
+       peer -> pacingHeld = 0;
+
+       return 0;
+    }
+
+    burst = ENET_MAX (pacingRate / 1000, 2 * peer -> mtu);
+
+    elapsedTime = host -> serviceTimeMicroseconds - peer -> pacingTime;
+    peer -> pacingTime = host -> serviceTimeMicroseconds;
+
+    if (elapsedTime > ENET_PEER_PACING_CATCH_UP_TIME)
+      elapsedTime = ENET_PEER_PACING_CATCH_UP_TIME;
+
+    credit = (pacingRate / 1000) * (elapsedTime / 1000) +
+             ((pacingRate / 1000) * (elapsedTime % 1000) + (pacingRate % 1000) * (elapsedTime / 1000)) / 1000;
+
+    /* A peer held back by pacing is owed all the time since, however seldom the host is
+       serviced; one that ran out of things to send keeps no more than a burst. The limit
+       only applies to new credit, so what a peer was owed is not taken back later on. */
+    if (peer -> pacingHeld && credit > burst)
+      burst = credit;
+
+    if (peer -> pacingCredit < (int) burst)
+    {
+       peer -> pacingCredit += (int) credit;
+       if (peer -> pacingCredit > (int) burst)
+         peer -> pacingCredit = (int) burst;
+    }
+
+    if (peer -> pacingCredit > 0)
+    {
+       peer -> pacingHeld = 0;
+
+       return 0;
+    }
+
+    peer -> pacingHeld = ! enet_list_empty (& peer -> outgoingReliableCommands) ||
+                         ! enet_list_empty (& peer -> outgoingUnreliableCommands);
+
+    /* The timer wheel counts milliseconds, so wait at least one. */
+    waitTime = ((enet_uint32) - peer -> pacingCredit * 1000 + pacingRate - 1) / pacingRate;
+
+    enet_timer_wheel_schedule (& host -> timerWheel, & peer -> pacingTimer, host -> serviceTime + ENET_MAX (waitTime, 1));
+
+    return 1;
+}
+
 static int
 enet_protocol_send_outgoing_commands (ENetHost * host, ENetEvent * event, int checkForTimeouts)
 {
-    enet_uint8 headerData [sizeof (ENetProtocolHeader) + sizeof (enet_uint32)];
-    ENetProtocolHeader * header = (ENetProtocolHeader *) headerData;
+    ENetOutgoingDatagram * outgoingDatagram;
+    ENetProtocolHeader * header;
+    ENetListIterator currentNode, nextNode;
     ENetPeer * currentPeer;
-    int sentLength;
     size_t shouldCompress = 0;
+    int continueSending, sendAgain = 0, paced;
  
+    if (checkForTimeouts != 0 &&
+        enet_protocol_expire_timers (host, event) == 1)
+      return 1;
+
     host -> continueSending = 1;
 
     while (host -> continueSending)
+    {
     for (host -> continueSending = 0,
-           currentPeer = host -> peers;
-         currentPeer < & host -> peers [host -> peerCount];
-         ++ currentPeer)
+           currentNode = enet_list_begin (& host -> serviceQueue);
+         currentNode != enet_list_end (& host -> serviceQueue);
+         currentNode = sendAgain ? currentNode : nextNode)
     {
+        currentPeer = (ENetPeer *) ((enet_uint8 *) currentNode - (size_t) & ((ENetPeer *) 0) -> serviceList);
+
+        /* Disconnecting requeues the peer at the end of the list, so remember where to go next. */
+        nextNode = enet_list_next (currentNode);
+        sendAgain = 0;
+
         if (currentPeer -> state == ENET_PEER_STATE_DISCONNECTED ||
             currentPeer -> state == ENET_PEER_STATE_ZOMBIE)
           continue;
 
+        /* Only data waits for the pacing timer; acknowledgements and pings are still sent so
+           the other side's round trip times and timeouts are not held up behind it. */
+        paced = host -> congestionControl.pacingRate != NULL &&
+                enet_protocol_check_pacing (host, currentPeer);
+
         host -> headerFlags = 0;
         host -> commandCount = 0;
         host -> bufferCount = 1;
@@ -1613,19 +2182,11 @@ enet_protocol_send_outgoing_commands (ENetHost * host, ENetEvent * event, int ch
         if (! enet_list_empty (& currentPeer -> acknowledgements))
           enet_protocol_send_acknowledgements (host, currentPeer);
 
-        if (checkForTimeouts != 0 &&
-            ! enet_list_empty (& currentPeer -> sentReliableCommands) &&
-            ENET_TIME_GREATER_EQUAL (host -> serviceTime, currentPeer -> nextTimeout) &&
-            enet_protocol_check_timeouts (host, currentPeer, event) == 1)
-        {
-            if (event != NULL && event -> type != ENET_EVENT_TYPE_NONE)
-              return 1;
-            else
-              continue;
-        }
+        continueSending = host -> continueSending;
+        host -> continueSending = 0;
 
         if ((enet_list_empty (& currentPeer -> outgoingReliableCommands) ||
-              enet_protocol_send_reliable_outgoing_commands (host, currentPeer)) &&
+              (! paced && enet_protocol_send_reliable_outgoing_commands (host, currentPeer))) &&
             enet_list_empty (& currentPeer -> sentReliableCommands) &&
             ENET_TIME_DIFFERENCE (host -> serviceTime, currentPeer -> lastReceiveTime) >= currentPeer -> pingInterval &&
             currentPeer -> mtu - host -> packetSize >= sizeof (ENetProtocolPing))
@@ -1634,9 +2195,19 @@ enet_protocol_send_outgoing_commands (ENetHost * host, ENetEvent * event, int ch
             enet_protocol_send_reliable_outgoing_commands (host, currentPeer);
         }
                       
-        if (! enet_list_empty (& currentPeer -> outgoingUnreliableCommands))
+        if (! paced && ! enet_list_empty (& currentPeer -> outgoingUnreliableCommands))
           enet_protocol_send_unreliable_outgoing_commands (host, currentPeer);
 
+        /* With segmentation offload a peer that still has more to send is served
+           again straight away so its datagrams are next to each other in the batch. */
+        sendAgain = host -> segmentationOffload && host -> continueSending && host -> commandCount > 0;
+        if (sendAgain)
+          host -> continueSending = continueSending;
+        else
+          host -> continueSending |= continueSending;
+
+        enet_peer_schedule_ping (currentPeer);
+
         if (host -> commandCount == 0)
           continue;
 
@@ -1649,7 +2220,7 @@ enet_protocol_send_outgoing_commands (ENetHost * host, ENetEvent * event, int ch
            enet_uint32 packetLoss = currentPeer -> packetsLost * ENET_PEER_PACKET_LOSS_SCALE / currentPeer -> packetsSent;
 
 #ifdef ENET_DEBUG
-           printf ("peer %u: %f%%+-%f%% packet loss, %u+-%u ms round trip time, %f%% throttle, %u/%u outgoing, %u/%u incoming\n", currentPeer -> incomingPeerID, currentPeer -> packetLoss / (float) ENET_PEER_PACKET_LOSS_SCALE, currentPeer -> packetLossVariance / (float) ENET_PEER_PACKET_LOSS_SCALE, currentPeer -> roundTripTime, currentPeer -> roundTripTimeVariance, currentPeer -> packetThrottle / (float) ENET_PEER_PACKET_THROTTLE_SCALE, enet_list_size (& currentPeer -> outgoingReliableCommands), enet_list_size (& currentPeer -> outgoingUnreliableCommands), currentPeer -> channels != NULL ? enet_list_size (& currentPeer -> channels -> incomingReliableCommands) : 0, currentPeer -> channels != NULL ? enet_list_size (& currentPeer -> channels -> incomingUnreliableCommands) : 0);
+           printf ("peer %u: %f%%+-%f%% packet loss, %u+-%u ms round trip time, %f%% throttle, %u/%u outgoing, %u/%u incoming\n", currentPeer -> incomingPeerID, currentPeer -> packetLoss / (float) ENET_PEER_PACKET_LOSS_SCALE, currentPeer -> packetLossVariance / (float) ENET_PEER_PACKET_LOSS_SCALE, currentPeer -> roundTripTime, currentPeer -> roundTripTimeVariance, currentPeer -> packetThrottle / (float) ENET_PEER_PACKET_THROTTLE_SCALE, enet_list_size (& currentPeer -> outgoingReliableCommands), enet_list_size (& currentPeer -> outgoingUnreliableCommands), currentPeer -> channels != NULL ? currentPeer -> channels -> incomingReliableCount : 0, currentPeer -> channels != NULL ? enet_list_size (& currentPeer -> channels -> incomingUnreliableCommands) : 0);
 #endif
           
            currentPeer -> packetLossVariance -= currentPeer -> packetLossVariance / 4;
@@ -1670,7 +2241,10 @@ enet_protocol_send_outgoing_commands (ENetHost * host, ENetEvent * event, int ch
            currentPeer -> packetsLost = 0;
         }
 
-        host -> buffers -> data = headerData;
+        outgoingDatagram = & host -> outgoingDatagrams [host -> outgoingDatagramCount];
+        header = (ENetProtocolHeader *) outgoingDatagram -> headerData;
+
+        host -> buffers -> data = outgoingDatagram -> headerData;
         if (host -> headerFlags & ENET_PROTOCOL_HEADER_FLAG_SENT_TIME)
         {
             header -> sentTime = ENET_HOST_TO_NET_16 (host -> serviceTime & 0xFFFF);
@@ -1687,7 +2261,7 @@ enet_protocol_send_outgoing_commands (ENetHost * host, ENetEvent * event, int ch
                    compressedSize = host -> compressor.compress (host -> compressor.context,
                                         & host -> buffers [1], host -> bufferCount - 1,
                                         originalSize,
-                                        host -> packetData [1],
+                                        outgoingDatagram -> compressedData,
                                         originalSize);
             if (compressedSize > 0 && compressedSize < originalSize)
             {
@@ -1704,7 +2278,7 @@ enet_protocol_send_outgoing_commands (ENetHost * host, ENetEvent * event, int ch
         header -> peerID = ENET_HOST_TO_NET_16 (currentPeer -> outgoingPeerID | host -> headerFlags);
         if (host -> checksum != NULL)
         {
-            enet_uint32 * checksum = (enet_uint32 *) & headerData [host -> buffers -> dataLength];
+            enet_uint32 * checksum = (enet_uint32 *) & outgoingDatagram -> headerData [host -> buffers -> dataLength];
             * checksum = currentPeer -> outgoingPeerID < ENET_PROTOCOL_MAXIMUM_PEER_ID ? currentPeer -> connectID : 0;
             host -> buffers -> dataLength += sizeof (enet_uint32);
             * checksum = host -> checksum (host -> buffers, host -> bufferCount);
@@ -1712,27 +2286,46 @@ enet_protocol_send_outgoing_commands (ENetHost * host, ENetEvent * event, int ch
 
         if (shouldCompress > 0)
         {
-            host -> buffers [1].data = host -> packetData [1];
+            host -> buffers [1].data = outgoingDatagram -> compressedData;
             host -> buffers [1].dataLength = shouldCompress;
             host -> bufferCount = 2;
         }
 
         currentPeer -> lastSendTime = host -> serviceTime;
 
-        sentLength = enet_socket_send (host -> socket, & currentPeer -> address, host -> buffers, host -> bufferCount);
+        if (host -> congestionControl.pacingRate != NULL)
+          currentPeer -> pacingCredit -= (int) host -> packetSize;
 
-        enet_protocol_remove_sent_unreliable_commands (currentPeer);
+        enet_protocol_queue_outgoing_datagram (host, currentPeer);
 
-        if (sentLength < 0)
+        if (host -> outgoingDatagramCount >= ENET_HOST_SEND_BATCH_SIZE &&
+            enet_protocol_flush_outgoing_datagrams (host) < 0)
           return -1;
+    }
 
-        host -> totalSentData += sentLength;
-        host -> totalSentPackets ++;
+    /* Flush at the end of every pass so that no peer visited again has datagrams still queued. */
+    if (enet_protocol_flush_outgoing_datagrams (host) < 0)
+      return -1;
+    }
+
+    /* Whatever is left waits on a deadline or on incoming acknowledgements. */
+    while (! enet_list_empty (& host -> serviceQueue))
+    {
+       currentPeer = (ENetPeer *) ((enet_uint8 *) enet_list_remove (enet_list_begin (& host -> serviceQueue)) - (size_t) & ((ENetPeer *) 0) -> serviceList);
+
+       currentPeer -> needsService = 0;
     }
    
     return 0;
 }
 
+static void
+enet_protocol_update_service_time (ENetHost * host)
+{
+    host -> serviceTime = enet_time_get ();
+    host -> serviceTimeMicroseconds = enet_time_get_microseconds ();
+}
+
 /** Sends any queued packets on the host specified to its designated peers.
 
     @param host   host to flush
@@ -1742,7 +2335,7 @@ enet_protocol_send_outgoing_commands (ENetHost * host, ENetEvent * event, int ch
 void
 enet_host_flush (ENetHost * host)
 {
-    host -> serviceTime = enet_time_get ();
+    enet_protocol_update_service_time (host);
 
     enet_protocol_send_outgoing_commands (host, NULL, 0);
 }
@@ -1809,7 +2402,7 @@ enet_host_service (ENetHost * host, ENetEvent * event, enet_uint32 timeout)
         }
     }
 
-    host -> serviceTime = enet_time_get ();
+    enet_protocol_update_service_time (host);
     
     timeout += host -> serviceTime;
 
@@ -1890,7 +2483,7 @@ enet_host_service (ENetHost * host, ENetEvent * event, enet_uint32 timeout)
 
        do
        {
-          host -> serviceTime = enet_time_get ();
+          enet_protocol_update_service_time (host);
 
           if (ENET_TIME_GREATER_EQUAL (host -> serviceTime, timeout))
             return 0;
@@ -1902,7 +2495,7 @@ enet_host_service (ENetHost * host, ENetEvent * event, enet_uint32 timeout)
        }
        while (waitCondition & ENET_SOCKET_WAIT_INTERRUPT);
 
-       host -> serviceTime = enet_time_get ();
+       enet_protocol_update_service_time (host);
     } while (waitCondition & ENET_SOCKET_WAIT_RECEIVE);
 
     return 0; 
@@ -0,0 +1,125 @@
+/** 
+ @file  bench_broadcast.c
+ @brief Measures the server's cost of fanning one packet out to many peers
+
+ A server host sends one reliable packet to every connected peer, either with
+ enet_host_broadcast() or with a call to enet_peer_send() per peer, then services the hosts
+ until every peer has received it. The time the server spends queuing the packet and in
+ enet_host_service() is reported per peer reached, for each peer count in turn. The peers are
+ spread over client hosts of CLIENT_PEERS each, so that a burst to thousands of peers does
+ not overflow the socket buffer of a single client. Usage:
+
+    enet_bench_broadcast [rounds [packet size]]
+*/
+#include <string.h>
+#include "harness.h"
+
+#define CLIENT_PEERS 64
+
+static const size_t peerCounts [] = { 16, 256, 4000 };
+
+static void
+run (size_t peerCount, int broadcast, int rounds, size_t packetSize)
+{
+    size_t clientCount = (peerCount + CLIENT_PEERS - 1) / CLIENT_PEERS,
+           received, peerIndex, clientIndex;
+    int round;
+    double queueStart, queueTime = 0.0, serviceStart, serviceTime = 0.0;
+    ENetHost * server, ** clients;
+    ENetPeer * peers [CLIENT_PEERS];
+    ENetEvent event;
+    enet_uint8 payload [ENET_PROTOCOL_MAXIMUM_MTU];
+
+    server = harness_create_server (peerCount, 1);
+    clients = (ENetHost **) malloc (clientCount * sizeof (ENetHost *));
+    if (clients == NULL)
+      exit (1);
+
+    for (clientIndex = 0; clientIndex < clientCount; ++ clientIndex)
+    {
+       size_t clientPeers = peerCount - clientIndex * CLIENT_PEERS;
+
+       if (clientPeers > CLIENT_PEERS)
+         clientPeers = CLIENT_PEERS;
+
+       clients [clientIndex] = enet_host_create (NULL, clientPeers, 1, 0, 0);
+       if (clients [clientIndex] == NULL ||
+           harness_connect (clients [clientIndex], server, peers, clientPeers, 1) != clientPeers)
+       {
+          fprintf (stderr, "failed to connect %u peers\n", (unsigned) peerCount);
+          exit (1);
+       }
+    }
+
+    memset (payload, 'x', packetSize);
+
+    for (round = 0; round < rounds; ++ round)
+    {
+       ENetPacket * packet = enet_packet_create (payload, packetSize, ENET_PACKET_FLAG_RELIABLE);
+
+       queueStart = harness_seconds ();
+
+       if (broadcast)
+         enet_host_broadcast (server, 0, packet);
+       else
+       for (peerIndex = 0; peerIndex < server -> peerCount; ++ peerIndex)
+         if (server -> peers [peerIndex].state == ENET_PEER_STATE_CONNECTED)
+           enet_peer_send (& server -> peers [peerIndex], 0, packet);
+
+       queueTime += harness_seconds () - queueStart;
+
+       for (received = 0; received < peerCount;)
+       {
+          serviceStart = harness_seconds ();
+
+          while (enet_host_service (server, & event, 0) > 0)
+            if (event.type == ENET_EVENT_TYPE_RECEIVE)
+              enet_packet_destroy (event.packet);
+
+          serviceTime += harness_seconds () - serviceStart;
+
+          for (clientIndex = 0; clientIndex < clientCount; ++ clientIndex)
+            while (enet_host_service (clients [clientIndex], & event, 0) > 0)
+              if (event.type == ENET_EVENT_TYPE_RECEIVE)
+              {
+                 ++ received;
+
+                 enet_packet_destroy (event.packet);
+              }
+       }
+    }
+
+    printf ("%4u peers, %-9s: %.3f us queuing and %.3f us servicing per peer reached\n",
+            (unsigned) peerCount, broadcast ? "broadcast" : "per peer",
+            queueTime * 1000000.0 / ((double) rounds * peerCount),
+            serviceTime * 1000000.0 / ((double) rounds * peerCount));
+
+    for (clientIndex = 0; clientIndex < clientCount; ++ clientIndex)
+      enet_host_destroy (clients [clientIndex]);
+    free (clients);
+    enet_host_destroy (server);
+}
+
+int
+main (int argc, char ** argv)
+{
+    int rounds = argc > 1 ? atoi (argv [1]) : 200;
+    size_t packetSize = argc > 2 ? (size_t) atoi (argv [2]) : 64,
+           countIndex;
+
+    harness_initialize ();
+
+    if (rounds < 1 || packetSize < 1 || packetSize > 1024)
+    {
+       fprintf (stderr, "usage: %s [rounds [packet size]]\n", argv [0]);
+       return 1;
+    }
+
+    for (countIndex = 0; countIndex < sizeof (peerCounts) / sizeof (peerCounts [0]); ++ countIndex)
+    {
+       run (peerCounts [countIndex], 0, rounds, packetSize);
+       run (peerCounts [countIndex], 1, rounds, packetSize);
+    }
+
+    return 0;
+}
@@ -0,0 +1,112 @@
+/** 
+ @file  bench_bulk.c
+ @brief Measures bulk transfer throughput over loopback with and without segmentation offload
+
+ One peer sends large reliable packets, which go out as runs of MTU-sized fragments, to
+ another host as fast as the reliable window allows. Usage:
+
+    enet_bench_bulk [seconds [packet size]]
+
+ Each mode runs with fresh hosts; modes the socket does not support are skipped.
+*/
+#include <string.h>
+#include "harness.h"
+
+static void
+run (int segmentationOffload, double duration, size_t packetSize)
+{
+    ENetHost * server = harness_create_server (1, 1),
+             * client = enet_host_create (NULL, 1, 1, 0, 0);
+    ENetPeer * peer;
+    ENetPacket * packet;
+    ENetEvent event;
+    double start, elapsed, cpuStart, cpuTime;
+    size_t receivedBytes = 0;
+
+    if (client == NULL)
+      exit (1);
+
+    if (segmentationOffload &&
+        (enet_host_segmentation_offload (server, 1) < 0 || enet_host_segmentation_offload (client, 1) < 0))
+    {
+       printf ("segmentation offload: not supported\n");
+
+       enet_host_destroy (client);
+       enet_host_destroy (server);
+       return;
+    }
+
+    if (harness_connect (client, server, & peer, 1, 1) != 1)
+    {
+       fprintf (stderr, "failed to connect\n");
+       exit (1);
+    }
+
+    client -> totalSentPackets = 0;
+    client -> totalSendCalls = 0;
+    server -> totalReceivedPackets = 0;
+    server -> totalReceiveCalls = 0;
+
+    start = harness_seconds ();
+    cpuStart = harness_cpu_seconds ();
+
+    do
+    {
+       /* Keep about two packets queued, so the window is never starved. */
+       if (enet_list_size (& peer -> outgoingReliableCommands) < 2 * (packetSize / 1024 + 1))
+       {
+          packet = enet_packet_create (NULL, packetSize, ENET_PACKET_FLAG_RELIABLE);
+          memset (packet -> data, 'x', packetSize);
+          enet_peer_send (peer, 0, packet);
+       }
+
+       while (enet_host_service (client, & event, 0) > 0)
+         if (event.type == ENET_EVENT_TYPE_RECEIVE)
+           enet_packet_destroy (event.packet);
+
+       while (enet_host_service (server, & event, 0) > 0)
+         if (event.type == ENET_EVENT_TYPE_RECEIVE)
+         {
+            receivedBytes += event.packet -> dataLength;
+
+            enet_packet_destroy (event.packet);
+         }
+
+       elapsed = harness_seconds () - start;
+    } while (elapsed < duration);
+
+    cpuTime = harness_cpu_seconds () - cpuStart;
+
+    printf ("%-22s %.1f MB/s, %.3f send calls and %.3f receive calls per datagram, %.2f us CPU per KB\n",
+            segmentationOffload ? "segmentation offload:" : "one datagram per call:",
+            receivedBytes / elapsed / 1000000.0,
+            client -> totalSentPackets > 0 ? (double) client -> totalSendCalls / client -> totalSentPackets : 0.0,
+            server -> totalReceivedPackets > 0 ? (double) server -> totalReceiveCalls / server -> totalReceivedPackets : 0.0,
+            receivedBytes > 0 ? cpuTime * 1000000.0 / (receivedBytes / 1000.0) : 0.0);
+
+    enet_host_destroy (client);
+    enet_host_destroy (server);
+}
+
+int
+main (int argc, char ** argv)
+{
+    double duration = argc > 1 ? atof (argv [1]) : 5.0;
+    size_t packetSize = argc > 2 ? (size_t) atoi (argv [2]) : 256 * 1024;
+
+    harness_initialize ();
+
+    if (packetSize < 1 || packetSize > ENET_HOST_DEFAULT_MAXIMUM_PACKET_SIZE)
+    {
+       fprintf (stderr, "usage: %s [seconds [packet size]]\n", argv [0]);
+       return 1;
+    }
+
+    printf ("%u byte packets, %.1f s per mode\n", (unsigned) packetSize, duration);
+
+    run (0, duration, packetSize);
+    run (1, duration, packetSize);
+
+    return 0;
+}
+
@@ -0,0 +1,135 @@
+/**
+ @file  bench_connect.c
+ @brief Measures how fast a server takes connects while nearly all of its peers are in use
+
+ All but one of the server's peer slots are filled by idle peers connected from client hosts
+ on other loopback addresses, 64 to each address as a local network would spread them. Another
+ client then connects to the free slot, disconnects and connects again. The connects made
+ and the time the server spends in enet_host_service() per connect are reported, for 100
+ and for 4000 slots. Usage:
+
+    enet_bench_connect [seconds]
+
+ The filling clients bind to addresses in 127.0.3.0/24, which Linux routes to loopback
+ without any configuration.
+*/
+#include "harness.h"
+
+#define CLIENT_PEERS 64
+#define QUIET_INTERVAL 600000
+
+static const size_t slotCounts [] = { 100, 4000 };
+
+static void
+run (size_t slotCount, double duration)
+{
+    size_t fillerCount = (slotCount - 1 + CLIENT_PEERS - 1) / CLIENT_PEERS,
+           fillerIndex, peerIndex, connects = 0;
+    ENetHost * server, * client, ** fillers;
+    ENetPeer * peers [CLIENT_PEERS], * peer = NULL;
+    ENetAddress address;
+    ENetEvent event;
+    double start, elapsed, serviceStart, serviceTime = 0.0;
+    int connected = 0;
+
+    server = harness_create_server (slotCount, 1);
+    client = enet_host_create (NULL, 1, 1, 0, 0);
+    fillers = (ENetHost **) malloc (fillerCount * sizeof (ENetHost *));
+    if (client == NULL || fillers == NULL)
+      exit (1);
+
+    for (fillerIndex = 0; fillerIndex < fillerCount; ++ fillerIndex)
+    {
+       size_t fillerPeers = slotCount - 1 - fillerIndex * CLIENT_PEERS;
+
+       if (fillerPeers > CLIENT_PEERS)
+         fillerPeers = CLIENT_PEERS;
+
+       address.host = ENET_HOST_TO_NET_32 (0x7F000300 + (enet_uint32) fillerIndex + 1);
+       address.port = 0;
+
+       fillers [fillerIndex] = enet_host_create (& address, fillerPeers, 1, 0, 0);
+       if (fillers [fillerIndex] == NULL ||
+           harness_connect (fillers [fillerIndex], server, peers, fillerPeers, 1) != fillerPeers)
+       {
+          fprintf (stderr, "failed to fill %u slots\n", (unsigned) slotCount);
+          exit (1);
+       }
+
+       for (peerIndex = 0; peerIndex < fillerPeers; ++ peerIndex)
+       {
+          enet_peer_ping_interval (peers [peerIndex], QUIET_INTERVAL);
+          enet_peer_timeout (peers [peerIndex], 0, QUIET_INTERVAL, QUIET_INTERVAL);
+       }
+    }
+
+    /* The filling peers stay idle, neither pinging nor timing out during the run, so the
+       server's service time is spent on the connects. */
+    for (peerIndex = 0; peerIndex < server -> peerCount; ++ peerIndex)
+      if (server -> peers [peerIndex].state == ENET_PEER_STATE_CONNECTED)
+      {
+         enet_peer_ping_interval (& server -> peers [peerIndex], QUIET_INTERVAL);
+         enet_peer_timeout (& server -> peers [peerIndex], 0, QUIET_INTERVAL, QUIET_INTERVAL);
+      }
+
+    harness_loopback (& address, server -> address.port);
+
+    start = harness_seconds ();
+
+    do
+    {
+       elapsed = harness_seconds () - start;
+
+       if (peer == NULL)
+         peer = enet_host_connect (client, & address, 1, 0);
+
+       while (enet_host_service (client, & event, 0) > 0)
+         if (event.type == ENET_EVENT_TYPE_CONNECT)
+         {
+            ++ connects;
+
+            connected = 1;
+         }
+
+       /* Disconnect only once the service calls above have acknowledged the server's verify,
+          which disconnecting would otherwise drop, so the server frees the slot at once. */
+       if (connected)
+       {
+          enet_peer_disconnect_now (peer, 0);
+          peer = NULL;
+          connected = 0;
+       }
+
+       serviceStart = harness_seconds ();
+
+       while (enet_host_service (server, & event, 0) > 0)
+         if (event.type == ENET_EVENT_TYPE_RECEIVE)
+           enet_packet_destroy (event.packet);
+
+       serviceTime += harness_seconds () - serviceStart;
+    } while (elapsed < duration);
+
+    printf ("%4u slots: %.0f connects/s, %.2f us of server service per connect\n",
+            (unsigned) slotCount, connects / elapsed,
+            connects > 0 ? serviceTime * 1000000.0 / connects : 0.0);
+
+    for (fillerIndex = 0; fillerIndex < fillerCount; ++ fillerIndex)
+      enet_host_destroy (fillers [fillerIndex]);
+    free (fillers);
+    enet_host_destroy (client);
+    enet_host_destroy (server);
+}
+
+int
+main (int argc, char ** argv)
+{
+    double duration = argc > 1 ? atof (argv [1]) : 5.0;
+    size_t countIndex;
+
+    harness_initialize ();
+
+    for (countIndex = 0; countIndex < sizeof (slotCounts) / sizeof (slotCounts [0]); ++ countIndex)
+      run (slotCounts [countIndex], duration);
+
+    return 0;
+}
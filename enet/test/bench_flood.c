@@ -0,0 +1,173 @@
+/**
+ @file  bench_flood.c
+ @brief Measures how long a legitimate client takes to connect while spoofed connects flood
+        the server
+
+ Flood sockets bound to many loopback addresses send connects that never go any further,
+ as a flood with spoofed source addresses would. Meanwhile a client connects to the server,
+ disconnects and connects again. This runs once with the server taking every connect and
+ once with it requiring cookies. The client's connect latency and how many of its connects
+ time out are reported for each. Usage:
+
+    enet_bench_flood [spoofed connects per second [seconds]]
+
+ The flood binds to addresses in 127.0.1.0/24, which Linux routes to loopback without any
+ configuration.
+*/
+#include <string.h>
+#include "harness.h"
+
+#define SERVER_PEERS 64
+#define FLOOD_SOCKETS 64
+#define CONNECT_TIMEOUT 1000
+#define MAXIMUM_SAMPLES 100000
+
+static double latencies [MAXIMUM_SAMPLES];
+
+static int
+compare_latencies (const void * x, const void * y)
+{
+    double a = * (const double *) x, b = * (const double *) y;
+
+    return a < b ? -1 : (a > b ? 1 : 0);
+}
+
+static void
+run (int cookies, int floodRate, double duration)
+{
+    ENetSocket floodSockets [FLOOD_SOCKETS];
+    ENetAddress address, serverAddress;
+    ENetBuffer buffer;
+    ENetEvent event;
+    ENetHost * server, * client;
+    ENetPeer * peer = NULL;
+    enet_uint8 data [ENET_PROTOCOL_MAXIMUM_MTU];
+    enet_uint8 secret [ENET_HOST_COOKIE_SECRET_SIZE];
+    size_t socketIndex, sampleCount = 0, timeouts = 0, flooded = 0;
+    int connected = 0;
+    double start, elapsed, connectStart = 0.0;
+
+    server = harness_create_server (SERVER_PEERS, 1);
+    if (cookies)
+    {
+       memset (secret, 0x5A, sizeof (secret));
+       enet_host_connect_cookies (server, secret);
+    }
+
+    client = enet_host_create (NULL, 1, 1, 0, 0);
+    if (client == NULL)
+      exit (1);
+
+    for (socketIndex = 0; socketIndex < FLOOD_SOCKETS; ++ socketIndex)
+    {
+       address.host = ENET_HOST_TO_NET_32 (0x7F000100 + (enet_uint32) socketIndex + 1);
+       address.port = 0;
+
+       floodSockets [socketIndex] = enet_socket_create (ENET_SOCKET_TYPE_DATAGRAM);
+       if (floodSockets [socketIndex] == ENET_SOCKET_NULL ||
+           enet_socket_bind (floodSockets [socketIndex], & address) != 0 ||
+           enet_socket_set_option (floodSockets [socketIndex], ENET_SOCKOPT_NONBLOCK, 1) != 0)
+       {
+          fprintf (stderr, "failed to bind a flood socket to 127.0.1.%u\n", (unsigned) socketIndex + 1);
+          exit (1);
+       }
+    }
+
+    harness_loopback (& serverAddress, server -> address.port);
+
+    start = harness_seconds ();
+
+    do
+    {
+       elapsed = harness_seconds () - start;
+
+       /* Every spoofed connect has a new connect ID, so none of them repeats another. */
+       for (; flooded < (size_t) (elapsed * floodRate); ++ flooded)
+       {
+          buffer.data = data;
+          buffer.dataLength = harness_write_connect (data, NULL, harness_random ());
+          enet_socket_send (floodSockets [flooded % FLOOD_SOCKETS], & serverAddress, & buffer, 1);
+       }
+
+       /* The flood never answers, so drop what the server sends back to it. */
+       for (socketIndex = 0; socketIndex < FLOOD_SOCKETS; ++ socketIndex)
+       {
+          buffer.data = data;
+          buffer.dataLength = sizeof (data);
+          while (enet_socket_receive (floodSockets [socketIndex], & address, & buffer, 1) > 0)
+            ;
+       }
+
+       if (peer == NULL)
+       {
+          peer = enet_host_connect (client, & serverAddress, 1, 0);
+          connectStart = harness_seconds ();
+       }
+       else
+       if (harness_seconds () - connectStart >= CONNECT_TIMEOUT / 1000.0)
+       {
+          enet_peer_reset (peer);
+          peer = NULL;
+          ++ timeouts;
+       }
+
+       while (enet_host_service (client, & event, 0) > 0)
+         if (event.type == ENET_EVENT_TYPE_CONNECT)
+         {
+            if (sampleCount < MAXIMUM_SAMPLES)
+              latencies [sampleCount ++] = harness_seconds () - connectStart;
+
+            connected = 1;
+         }
+
+       /* Disconnecting drops unsent acknowledgements, so only disconnect once the service
+          calls above have acknowledged the server's verify; otherwise the server keeps the
+          peer until it times out. */
+       if (connected)
+       {
+          enet_peer_disconnect_now (peer, 0);
+          peer = NULL;
+          connected = 0;
+       }
+
+       while (enet_host_service (server, & event, 0) > 0)
+         if (event.type == ENET_EVENT_TYPE_RECEIVE)
+           enet_packet_destroy (event.packet);
+    } while (elapsed < duration);
+
+    qsort (latencies, sampleCount, sizeof (double), compare_latencies);
+
+    printf ("%-10s %.0f spoofed connects/s: %u connects, %u timed out",
+            cookies ? "cookies," : "no cookies,", flooded / elapsed, (unsigned) sampleCount, (unsigned) timeouts);
+    if (sampleCount > 0)
+      printf (", latency median %.0f us, 99th percentile %.0f us",
+              latencies [sampleCount / 2] * 1000000.0,
+              latencies [sampleCount * 99 / 100] * 1000000.0);
+    printf (", %u of %u server peers free\n",
+            (unsigned) enet_list_size (& server -> freePeers), SERVER_PEERS);
+
+    for (socketIndex = 0; socketIndex < FLOOD_SOCKETS; ++ socketIndex)
+      enet_socket_destroy (floodSockets [socketIndex]);
+    enet_host_destroy (client);
+    enet_host_destroy (server);
+}
+
+int
+main (int argc, char ** argv)
+{
+    int floodRate = argc > 1 ? atoi (argv [1]) : 20000;
+    double duration = argc > 2 ? atof (argv [2]) : 5.0;
+
+    harness_initialize ();
+
+    if (floodRate < 0)
+    {
+       fprintf (stderr, "usage: %s [spoofed connects per second [seconds]]\n", argv [0]);
+       return 1;
+    }
+
+    run (0, floodRate, duration);
+    run (1, floodRate, duration);
+
+    return 0;
+}
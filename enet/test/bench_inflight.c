@@ -0,0 +1,132 @@
+/**
+ @file  bench_inflight.c
+ @brief Measures the sender's cost of acknowledgements with thousands of reliable commands in flight
+
+ A client peer queues a burst of one-byte reliable packets to a server over loopback and both
+ hosts are serviced until the server has received them all; the sender's window lets thousands
+ of them be in flight at once. Bursts repeat for the given time with no loss and with 2% and 5%
+ of datagrams dropped on receipt by both hosts, so that acknowledgements arrive out of order.
+ The most commands seen in flight and the time spent servicing the sender per burst are
+ reported. Usage:
+
+    enet_bench_inflight [packets per burst [seconds per loss rate]]
+*/
+#include "harness.h"
+
+#define STALL_TIMEOUT 10.0
+
+static const double lossRates [] = { 0.0, 2.0, 5.0 };
+
+static enet_uint32 lossThreshold;
+
+static int ENET_CALLBACK
+drop_datagram (ENetHost * host, ENetEvent * event)
+{
+    return harness_random () % 10000 < lossThreshold ? 1 : 0;
+}
+
+static void
+run (ENetHost * client, ENetHost * server, ENetPeer * peer, size_t burst, double loss, double duration)
+{
+    ENetEvent event;
+    size_t bursts = 0, packetIndex, received, inFlight, mostInFlight = 0;
+    double start, serviceStart, progressTime, senderTime = 0.0;
+    enet_uint8 payload = 'x';
+
+    lossThreshold = (enet_uint32) (loss * 100.0);
+
+    start = harness_seconds ();
+
+    do
+    {
+       for (packetIndex = 0; packetIndex < burst; ++ packetIndex)
+         enet_peer_send (peer, 0, enet_packet_create (& payload, 1, ENET_PACKET_FLAG_RELIABLE));
+
+       progressTime = harness_seconds ();
+
+       for (received = 0; received < burst; )
+       {
+          serviceStart = harness_seconds ();
+
+          if (serviceStart - progressTime >= STALL_TIMEOUT)
+          {
+             fprintf (stderr, "%.1f%% loss: stalled with %u of %u packets received, peer %s\n", loss, (unsigned) received, (unsigned) burst,
+                      peer -> state == ENET_PEER_STATE_CONNECTED ? "connected" : "disconnected");
+             exit (1);
+          }
+
+          while (enet_host_service (client, & event, 0) > 0)
+            if (event.type == ENET_EVENT_TYPE_RECEIVE)
+              enet_packet_destroy (event.packet);
+
+          senderTime += harness_seconds () - serviceStart;
+
+          inFlight = enet_list_size (& peer -> sentReliableCommands);
+          if (inFlight > mostInFlight)
+            mostInFlight = inFlight;
+
+          while (enet_host_service (server, & event, 0) > 0)
+            if (event.type == ENET_EVENT_TYPE_RECEIVE)
+            {
+               ++ received;
+               progressTime = harness_seconds ();
+
+               enet_packet_destroy (event.packet);
+            }
+       }
+
+       ++ bursts;
+    } while (harness_seconds () - start < duration);
+
+    /* Let the last acknowledgements arrive, so the next loss rate starts with nothing in flight. */
+    lossThreshold = 0;
+    while (! enet_list_empty (& peer -> sentReliableCommands) || ! enet_list_empty (& peer -> outgoingReliableCommands))
+    {
+       ENetHost * hosts [2];
+
+       hosts [0] = client;
+       hosts [1] = server;
+       harness_service (hosts, 2, 1);
+    }
+
+    printf ("%.1f%% loss: %u bursts of %u packets, up to %u in flight, %.2f ms servicing the sender per burst\n",
+            loss, (unsigned) bursts, (unsigned) burst, (unsigned) mostInFlight,
+            senderTime * 1000.0 / bursts);
+}
+
+int
+main (int argc, char ** argv)
+{
+    size_t burst = argc > 1 ? (size_t) atoi (argv [1]) : 20000,
+           rateIndex;
+    double duration = argc > 2 ? atof (argv [2]) : 5.0;
+    ENetHost * server, * client;
+    ENetPeer * peer;
+
+    harness_initialize ();
+
+    if (burst < 1)
+    {
+       fprintf (stderr, "usage: %s [packets per burst [seconds per loss rate]]\n", argv [0]);
+       return 1;
+    }
+
+    server = harness_create_server (1, 1);
+    client = enet_host_create (NULL, 1, 1, 0, 0);
+    if (client == NULL || harness_connect (client, server, & peer, 1, 1) != 1)
+    {
+       fprintf (stderr, "failed to connect\n");
+       return 1;
+    }
+
+    client -> intercept = drop_datagram;
+    server -> intercept = drop_datagram;
+
+    for (rateIndex = 0; rateIndex < sizeof (lossRates) / sizeof (lossRates [0]); ++ rateIndex)
+      run (client, server, peer, burst, lossRates [rateIndex], duration);
+
+    enet_host_destroy (client);
+    enet_host_destroy (server);
+
+    return 0;
+}
@@ -0,0 +1,175 @@
+/**
+ @file  bench_link.c
+ @brief Compares the packet throttle with BBR over a link with a bottleneck, latency and loss
+
+ A client sends bulk reliable packets of 1000 bytes to a server through the in-process link of
+ link.c, keeping a few queued so it always has more to send. Only the client's direction has
+ a bottleneck; the server's acknowledgements see the same delay and loss but no queue. Each
+ link is run first with the default congestion control, the packet throttle, and then with
+ BBR, whose pacing goes through enet_protocol_check_pacing(). The goodput, the delay datagrams
+ spent in the bottleneck queue and the latency of packets from their send to the server
+ receiving them are reported. Usage:
+
+    enet_bench_link [seconds per run [milliseconds between client services]]
+*/
+#include <string.h>
+#include "link.h"
+
+#define PACKET_SIZE 1000
+#define QUEUED_PACKETS 32
+#define SEND_TIME_SLOTS 0x10000
+
+typedef struct _LinkSetting
+{
+   const char * name;
+   enet_uint32  bandwidth;   /* bytes per second */
+   enet_uint32  delay;       /* one way, in milliseconds */
+   enet_uint32  bufferSize;
+   double       lossRate;
+} LinkSetting;
+
+static const LinkSetting settings [] =
+{
+   { "1 MB/s, 20 ms RTT, 64 KB buffer",          1000000, 10,  65536, 0.0  },
+   { "1 MB/s, 20 ms RTT, 64 KB buffer, 1% loss", 1000000, 10,  65536, 0.01 },
+   { "1 MB/s, 20 ms RTT, 256 KB buffer",         1000000, 10, 262144, 0.0  },
+   { "4 MB/s, 10 ms RTT, 64 KB buffer",          4000000,  5,  65536, 0.0  }
+};
+
+static double sendTimes [SEND_TIME_SLOTS];
+
+static int
+compare_latencies (const void * x, const void * y)
+{
+    double a = * (const double *) x, b = * (const double *) y;
+
+    return a < b ? -1 : (a > b ? 1 : 0);
+}
+
+static void
+run (const LinkSetting * setting, int bbr, double duration, double serviceInterval)
+{
+    HarnessLink link;
+    ENetHost * server, * client;
+    ENetPeer * peer;
+    ENetEvent event;
+    enet_uint8 payload [PACKET_SIZE];
+    enet_uint32 sent = 0, index;
+    size_t received = 0, latencyCapacity = 1024;
+    double * latencies = (double *) malloc (latencyCapacity * sizeof (double)),
+           start, now, lastService = 0.0;
+
+    server = harness_create_server (1, 1);
+    client = enet_host_create (NULL, 1, 1, 0, 0);
+    if (latencies == NULL || client == NULL || (bbr && enet_host_congestion_control_with_bbr (client) < 0))
+    {
+       fprintf (stderr, "failed to create the hosts\n");
+       exit (1);
+    }
+
+    harness_link_create (& link, server);
+    harness_link_configure (& link.toServer, setting -> bandwidth, setting -> delay, setting -> bufferSize, setting -> lossRate);
+    harness_link_configure (& link.toClient, 0, setting -> delay, 0, setting -> lossRate);
+
+    peer = harness_link_connect (& link, client, server, 1);
+    if (peer == NULL)
+    {
+       fprintf (stderr, "failed to connect through the link\n");
+       exit (1);
+    }
+
+    harness_link_reset_statistics (& link);
+    memset (payload, 'x', sizeof (payload));
+
+    start = harness_seconds ();
+
+    do
+    {
+       now = harness_seconds ();
+
+       while (enet_list_size (& peer -> outgoingReliableCommands) < QUEUED_PACKETS)
+       {
+          memcpy (payload, & sent, sizeof (sent));
+          sendTimes [sent % SEND_TIME_SLOTS] = now;
+          ++ sent;
+
+          enet_peer_send (peer, 0, enet_packet_create (payload, sizeof (payload), ENET_PACKET_FLAG_RELIABLE));
+       }
+
+       harness_link_service (& link);
+
+       if (now - lastService >= serviceInterval)
+       {
+          lastService = now;
+
+          while (enet_host_service (client, & event, 0) > 0)
+            if (event.type == ENET_EVENT_TYPE_RECEIVE)
+              enet_packet_destroy (event.packet);
+       }
+
+       harness_link_service (& link);
+
+       while (enet_host_service (server, & event, 0) > 0)
+         if (event.type == ENET_EVENT_TYPE_RECEIVE)
+         {
+            memcpy (& index, event.packet -> data, sizeof (index));
+
+            if (received >= latencyCapacity)
+            {
+               latencyCapacity *= 2;
+               latencies = (double *) realloc (latencies, latencyCapacity * sizeof (double));
+               if (latencies == NULL)
+                 exit (1);
+            }
+
+            latencies [received ++] = harness_seconds () - sendTimes [index % SEND_TIME_SLOTS];
+
+            enet_packet_destroy (event.packet);
+         }
+    } while (peer -> state == ENET_PEER_STATE_CONNECTED && harness_seconds () - start < duration);
+
+    if (received == 0)
+      printf ("%-42s %-8s nothing arrived\n", setting -> name, bbr ? "BBR" : "throttle");
+    else
+    {
+       qsort (latencies, received, sizeof (double), compare_latencies);
+
+       printf ("%-42s %-8s goodput %5.1f%%, queueing delay mean %5.1f ms max %5.1f ms, %4u overflowed, latency p50 %6.1f ms p99 %6.1f ms\n",
+               setting -> name, bbr ? "BBR" : "throttle",
+               received * (double) PACKET_SIZE / duration / setting -> bandwidth * 100.0,
+               link.toServer.queued > 0 ? link.toServer.queueingDelay * 1000.0 / link.toServer.queued : 0.0,
+               link.toServer.maximumQueueingDelay * 1000.0,
+               (unsigned) link.toServer.overflowed,
+               latencies [received / 2] * 1000.0,
+               latencies [received * 99 / 100] * 1000.0);
+    }
+
+    free (latencies);
+    harness_link_destroy (& link);
+    enet_host_destroy (client);
+    enet_host_destroy (server);
+}
+
+int
+main (int argc, char ** argv)
+{
+    double duration = argc > 1 ? atof (argv [1]) : 5.0,
+           serviceInterval = argc > 2 ? atof (argv [2]) / 1000.0 : 0.0;
+    size_t settingIndex;
+
+    harness_initialize ();
+
+    if (duration <= 0.0 || serviceInterval < 0.0)
+    {
+       fprintf (stderr, "usage: %s [seconds per run [milliseconds between client services]]\n", argv [0]);
+       return 1;
+    }
+
+    for (settingIndex = 0; settingIndex < sizeof (settings) / sizeof (settings [0]); ++ settingIndex)
+    {
+       run (& settings [settingIndex], 0, duration, serviceInterval);
+       run (& settings [settingIndex], 1, duration, serviceInterval);
+    }
+
+    return 0;
+}
@@ -0,0 +1,111 @@
+/** 
+ @file  bench_lossy.c
+ @brief Measures the processor time of many peers exchanging reliable packets over lossy links
+
+ A client host connects peers to a server host over loopback and each peer sends a small
+ reliable packet ten times a second, so most of the work is in retransmit timeouts, pings and
+ acknowledgements rather than in moving data. Both hosts drop the given percentage of the
+ datagrams they receive. The processor time is reported as a share of one core and per packet
+ delivered. Usage:
+
+    enet_bench_lossy [peers [loss percent [seconds]]]
+*/
+#include <string.h>
+#include "harness.h"
+
+#define SEND_INTERVAL 100
+
+static enet_uint32 lossThreshold;
+
+static int ENET_CALLBACK
+drop_datagram (ENetHost * host, ENetEvent * event)
+{
+    return harness_random () % 10000 < lossThreshold ? 1 : 0;
+}
+
+int
+main (int argc, char ** argv)
+{
+    size_t peerCount = argc > 1 ? (size_t) atoi (argv [1]) : 4000,
+           peerIndex, sent = 0, received = 0;
+    double loss = argc > 2 ? atof (argv [2]) : 2.0,
+           duration = argc > 3 ? atof (argv [3]) : 5.0,
+           start, elapsed, cpuStart, cpuTime;
+    enet_uint32 packetsLost = 0;
+    ENetHost * server, * client;
+    ENetPeer ** peers;
+    ENetEvent event;
+    enet_uint8 payload [32];
+
+    harness_initialize ();
+
+    if (peerCount < 1 || peerCount > ENET_PROTOCOL_MAXIMUM_PEER_ID || loss < 0.0 || loss >= 100.0)
+    {
+       fprintf (stderr, "usage: %s [peers [loss percent [seconds]]]\n", argv [0]);
+       return 1;
+    }
+
+    server = harness_create_server (peerCount, 1);
+    client = enet_host_create (NULL, peerCount, 1, 0, 0);
+    peers = (ENetPeer **) malloc (peerCount * sizeof (ENetPeer *));
+    if (client == NULL || peers == NULL)
+      return 1;
+
+    if (harness_connect (client, server, peers, peerCount, 1) != peerCount)
+    {
+       fprintf (stderr, "failed to connect %u peers\n", (unsigned) peerCount);
+       return 1;
+    }
+
+    memset (payload, 'x', sizeof (payload));
+
+    for (peerIndex = 0; peerIndex < peerCount; ++ peerIndex)
+      peers [peerIndex] -> packetsLost = 0;
+
+    /* Connect without loss, then drop from here on. */
+    lossThreshold = (enet_uint32) (loss * 100.0);
+    client -> intercept = drop_datagram;
+    server -> intercept = drop_datagram;
+
+    start = harness_seconds ();
+    cpuStart = harness_cpu_seconds ();
+
+    do
+    {
+       elapsed = harness_seconds () - start;
+
+       /* Spread the sends evenly, so each peer sends once per interval. */
+       for (; sent < (size_t) (elapsed * 1000.0 / SEND_INTERVAL * peerCount); ++ sent)
+         enet_peer_send (peers [sent % peerCount], 0, enet_packet_create (payload, sizeof (payload), ENET_PACKET_FLAG_RELIABLE));
+
+       while (enet_host_service (client, & event, 0) > 0)
+         if (event.type == ENET_EVENT_TYPE_RECEIVE)
+           enet_packet_destroy (event.packet);
+
+       while (enet_host_service (server, & event, 1) > 0)
+         if (event.type == ENET_EVENT_TYPE_RECEIVE)
+         {
+            ++ received;
+
+            enet_packet_destroy (event.packet);
+         }
+    } while (elapsed < duration);
+
+    cpuTime = harness_cpu_seconds () - cpuStart;
+
+    for (peerIndex = 0; peerIndex < peerCount; ++ peerIndex)
+      packetsLost += peers [peerIndex] -> packetsLost;
+
+    printf ("%u peers, %.1f%% loss, %.1f s: %.0f packets/s delivered, %u retransmit timeouts, %.1f%% of a core, %.2f us CPU per packet\n",
+            (unsigned) peerCount, loss, elapsed,
+            received / elapsed,
+            packetsLost,
+            cpuTime * 100.0 / elapsed,
+            received > 0 ? cpuTime * 1000000.0 / received : 0.0);
+
+    free (peers);
+    enet_host_destroy (client);
+    enet_host_destroy (server);
+
+    return 0;
+}
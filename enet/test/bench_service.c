@@ -0,0 +1,105 @@
+/** 
+ @file  bench_service.c
+ @brief Measures the cost of servicing a host against its peer count at a fixed active load
+
+ A client host connects every peer slot of a server host, but only a fixed number of its
+ peers stream reliable packets; the rest stay connected and idle, exchanging only pings. The
+ time spent inside the server's enet_host_service() is reported per call and per datagram
+ received, for each peer count in turn, so a service loop that visits every slot shows up as
+ a cost that grows with the peer count rather than with the traffic. Usage:
+
+    enet_bench_service [active peers [seconds]]
+*/
+#include <string.h>
+#include "harness.h"
+
+static const size_t peerCounts [] = { 16, 256, 1024, 4000 };
+
+static void
+run (size_t peerCount, size_t activeCount, double duration)
+{
+    size_t peerIndex, serviceCalls = 0;
+    enet_uint32 receivedPackets;
+    double start, elapsed, serviceStart, serviceTime = 0.0;
+    ENetHost * server, * client;
+    ENetPeer ** peers;
+    ENetEvent event;
+    enet_uint8 payload [32];
+
+    server = harness_create_server (peerCount, 1);
+    client = enet_host_create (NULL, peerCount, 1, 0, 0);
+    peers = (ENetPeer **) malloc (peerCount * sizeof (ENetPeer *));
+    if (client == NULL || peers == NULL)
+      exit (1);
+
+    if (harness_connect (client, server, peers, peerCount, 1) != peerCount)
+    {
+       fprintf (stderr, "failed to connect %u peers\n", (unsigned) peerCount);
+       exit (1);
+    }
+
+    memset (payload, 'x', sizeof (payload));
+
+    server -> totalReceivedPackets = 0;
+
+    start = harness_seconds ();
+
+    do
+    {
+       for (peerIndex = 0; peerIndex < activeCount; ++ peerIndex)
+         if (enet_list_empty (& peers [peerIndex] -> outgoingReliableCommands))
+           enet_peer_send (peers [peerIndex], 0, enet_packet_create (payload, sizeof (payload), ENET_PACKET_FLAG_RELIABLE));
+
+       while (enet_host_service (client, & event, 0) > 0)
+         if (event.type == ENET_EVENT_TYPE_RECEIVE)
+           enet_packet_destroy (event.packet);
+
+       serviceStart = harness_seconds ();
+
+       while (enet_host_service (server, & event, 0) > 0)
+       {
+          if (event.type == ENET_EVENT_TYPE_RECEIVE)
+            enet_packet_destroy (event.packet);
+
+          ++ serviceCalls;
+       }
+       ++ serviceCalls;
+
+       elapsed = harness_seconds ();
+       serviceTime += elapsed - serviceStart;
+       elapsed -= start;
+    } while (elapsed < duration);
+
+    receivedPackets = server -> totalReceivedPackets;
+
+    printf ("%4u peers, %u active: %.0f server datagrams/s, %.2f us per service call, %.2f us per datagram\n",
+            (unsigned) peerCount, (unsigned) activeCount,
+            receivedPackets / elapsed,
+            serviceTime * 1000000.0 / serviceCalls,
+            receivedPackets > 0 ? serviceTime * 1000000.0 / receivedPackets : 0.0);
+
+    free (peers);
+    enet_host_destroy (client);
+    enet_host_destroy (server);
+}
+
+int
+main (int argc, char ** argv)
+{
+    size_t activeCount = argc > 1 ? (size_t) atoi (argv [1]) : 16,
+           countIndex;
+    double duration = argc > 2 ? atof (argv [2]) : 3.0;
+
+    harness_initialize ();
+
+    if (activeCount < 1 || activeCount > peerCounts [0])
+    {
+       fprintf (stderr, "usage: %s [active peers (1 to %u) [seconds]]\n", argv [0], (unsigned) peerCounts [0]);
+       return 1;
+    }
+
+    for (countIndex = 0; countIndex < sizeof (peerCounts) / sizeof (peerCounts [0]); ++ countIndex)
+      run (peerCounts [countIndex], activeCount, duration);
+
+    return 0;
+}
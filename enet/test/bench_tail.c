@@ -0,0 +1,133 @@
+/**
+ @file  bench_tail.c
+ @brief Measures the delivery latency of reliable messages over lossy links, tail included
+
+ A client sends a small reliable message to a server over loopback at a steady interval, and
+ both hosts drop the given share of the datagrams they receive. Each message's latency runs
+ from its send to the server receiving it, and so includes waiting behind a lost message on
+ the channel. The median, 99th percentile and maximum are reported for 1, 3 and 5% loss, with
+ a message every 2 ms and every 20 ms. Usage:
+
+    enet_bench_tail [messages per run]
+*/
+#include <string.h>
+#include "harness.h"
+
+#define DRAIN_TIMEOUT 10.0
+
+static const double lossRates [] = { 1.0, 3.0, 5.0 };
+static const enet_uint32 sendIntervals [] = { 2, 20 };
+
+static enet_uint32 lossThreshold;
+
+static int ENET_CALLBACK
+drop_datagram (ENetHost * host, ENetEvent * event)
+{
+    return harness_random () % 10000 < lossThreshold ? 1 : 0;
+}
+
+static int
+compare_latencies (const void * x, const void * y)
+{
+    double a = * (const double *) x, b = * (const double *) y;
+
+    return a < b ? -1 : (a > b ? 1 : 0);
+}
+
+static void
+run (size_t messageCount, double loss, enet_uint32 sendInterval)
+{
+    double * sendTimes = (double *) malloc (messageCount * sizeof (double)),
+           * latencies = (double *) malloc (messageCount * sizeof (double)),
+           start, elapsed, lastReceipt;
+    size_t sent = 0, received = 0;
+    ENetHost * server, * client;
+    ENetPeer * peer;
+    ENetEvent event;
+
+    server = harness_create_server (1, 1);
+    client = enet_host_create (NULL, 1, 1, 0, 0);
+    if (sendTimes == NULL || latencies == NULL || client == NULL ||
+        harness_connect (client, server, & peer, 1, 1) != 1)
+    {
+       fprintf (stderr, "failed to connect\n");
+       exit (1);
+    }
+
+    /* Connect without loss, then drop from here on. */
+    lossThreshold = (enet_uint32) (loss * 100.0);
+    client -> intercept = drop_datagram;
+    server -> intercept = drop_datagram;
+
+    start = lastReceipt = harness_seconds ();
+
+    while (received < messageCount && harness_seconds () - lastReceipt < DRAIN_TIMEOUT)
+    {
+       elapsed = harness_seconds () - start;
+
+       for (; sent < messageCount && elapsed * 1000.0 >= (double) sent * sendInterval; ++ sent)
+       {
+          enet_uint32 index = (enet_uint32) sent;
+
+          sendTimes [sent] = harness_seconds ();
+          enet_peer_send (peer, 0, enet_packet_create (& index, sizeof (index), ENET_PACKET_FLAG_RELIABLE));
+       }
+
+       while (enet_host_service (client, & event, 0) > 0)
+         if (event.type == ENET_EVENT_TYPE_RECEIVE)
+           enet_packet_destroy (event.packet);
+
+       while (enet_host_service (server, & event, 0) > 0)
+         if (event.type == ENET_EVENT_TYPE_RECEIVE)
+         {
+            enet_uint32 index;
+
+            memcpy (& index, event.packet -> data, sizeof (index));
+
+            lastReceipt = harness_seconds ();
+            latencies [received ++] = lastReceipt - sendTimes [index];
+
+            enet_packet_destroy (event.packet);
+         }
+    }
+
+    if (received < messageCount)
+      printf ("%.0f%% loss, every %2u ms: only %u of %u messages arrived\n",
+              loss, sendInterval, (unsigned) received, (unsigned) messageCount);
+    else
+    {
+       qsort (latencies, received, sizeof (double), compare_latencies);
+
+       printf ("%.0f%% loss, every %2u ms: latency median %.2f ms, 99th percentile %.2f ms, max %.2f ms\n",
+               loss, sendInterval,
+               latencies [received / 2] * 1000.0,
+               latencies [received * 99 / 100] * 1000.0,
+               latencies [received - 1] * 1000.0);
+    }
+
+    free (sendTimes);
+    free (latencies);
+    enet_host_destroy (client);
+    enet_host_destroy (server);
+}
+
+int
+main (int argc, char ** argv)
+{
+    size_t messageCount = argc > 1 ? (size_t) atoi (argv [1]) : 1000,
+           intervalIndex, rateIndex;
+
+    harness_initialize ();
+
+    if (messageCount < 1)
+    {
+       fprintf (stderr, "usage: %s [messages per run]\n", argv [0]);
+       return 1;
+    }
+
+    for (intervalIndex = 0; intervalIndex < sizeof (sendIntervals) / sizeof (sendIntervals [0]); ++ intervalIndex)
+      for (rateIndex = 0; rateIndex < sizeof (lossRates) / sizeof (lossRates [0]); ++ rateIndex)
+        run (messageCount, lossRates [rateIndex], sendIntervals [intervalIndex]);
+
+    return 0;
+}
@@ -0,0 +1,102 @@
+/** 
+ @file  bench_throughput.c
+ @brief Measures datagrams per second over loopback and the socket calls made for them
+
+ A client host with many peers streams small reliable packets to a server host, so both
+ hosts handle one datagram per peer on each pass, and the server acknowledges them with one
+ datagram per peer. Usage:
+
+    enet_bench_throughput [peers [seconds [packet size]]]
+
+ The batched receive and send paths are used where recvmmsg and sendmmsg are found. To
+ measure the paths that handle one datagram per call, configure a separate build with
+ -DHAS_RECVMMSG=0 or -DHAS_SENDMMSG=0.
+*/
+#include <string.h>
+#include "harness.h"
+
+int
+main (int argc, char ** argv)
+{
+    size_t peerCount = argc > 1 ? (size_t) atoi (argv [1]) : 64,
+           packetSize = argc > 3 ? (size_t) atoi (argv [3]) : 32,
+           peerIndex, received = 0;
+    double duration = argc > 2 ? atof (argv [2]) : 5.0,
+           start, elapsed, cpuStart, cpuTime;
+    ENetHost * server, * client;
+    ENetPeer ** peers;
+    ENetEvent event;
+    enet_uint8 payload [ENET_PROTOCOL_MAXIMUM_MTU];
+
+    harness_initialize ();
+
+    if (peerCount < 1 || peerCount > ENET_PROTOCOL_MAXIMUM_PEER_ID || packetSize < 1 || packetSize > 1024)
+    {
+       fprintf (stderr, "usage: %s [peers [seconds [packet size]]]\n", argv [0]);
+       return 1;
+    }
+
+    server = harness_create_server (peerCount, 1);
+    client = enet_host_create (NULL, peerCount, 1, 0, 0);
+    peers = (ENetPeer **) malloc (peerCount * sizeof (ENetPeer *));
+    if (client == NULL || peers == NULL)
+      return 1;
+
+    if (harness_connect (client, server, peers, peerCount, 1) != peerCount)
+    {
+       fprintf (stderr, "failed to connect %u peers\n", (unsigned) peerCount);
+       return 1;
+    }
+
+    memset (payload, 'x', packetSize);
+
+    server -> totalReceivedPackets = 0;
+    server -> totalReceiveCalls = 0;
+    server -> totalSentPackets = 0;
+    server -> totalSendCalls = 0;
+    client -> totalSentPackets = 0;
+    client -> totalSendCalls = 0;
+
+    start = harness_seconds ();
+    cpuStart = harness_cpu_seconds ();
+
+    do
+    {
+       for (peerIndex = 0; peerIndex < peerCount; ++ peerIndex)
+         if (enet_list_empty (& peers [peerIndex] -> outgoingReliableCommands))
+           enet_peer_send (peers [peerIndex], 0, enet_packet_create (payload, packetSize, ENET_PACKET_FLAG_RELIABLE));
+
+       while (enet_host_service (client, & event, 0) > 0)
+         if (event.type == ENET_EVENT_TYPE_RECEIVE)
+           enet_packet_destroy (event.packet);
+
+       while (enet_host_service (server, & event, 0) > 0)
+         if (event.type == ENET_EVENT_TYPE_RECEIVE)
+         {
+            ++ received;
+
+            enet_packet_destroy (event.packet);
+         }
+
+       elapsed = harness_seconds () - start;
+    } while (elapsed < duration);
+
+    cpuTime = harness_cpu_seconds () - cpuStart;
+
+    printf ("%u peers, %u byte packets, %.1f s: %.0f packets/s, server %.0f datagrams/s, %.3f receive calls per datagram, %.2f us CPU per datagram\n",
+            (unsigned) peerCount, (unsigned) packetSize, elapsed,
+            received / elapsed,
+            server -> totalReceivedPackets / elapsed,
+            server -> totalReceivedPackets > 0 ? (double) server -> totalReceiveCalls / server -> totalReceivedPackets : 0.0,
+            server -> totalReceivedPackets > 0 ? cpuTime * 1000000.0 / server -> totalReceivedPackets : 0.0);
+    printf ("send calls per datagram: client %.3f, server %.3f\n",
+            client -> totalSentPackets > 0 ? (double) client -> totalSendCalls / client -> totalSentPackets : 0.0,
+            server -> totalSentPackets > 0 ? (double) server -> totalSendCalls / server -> totalSentPackets : 0.0);
+
+    free (peers);
+    enet_host_destroy (client);
+    enet_host_destroy (server);
+
+    return 0;
+}
+
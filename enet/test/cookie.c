@@ -0,0 +1,137 @@
+/**
+ @file  cookie.c
+ @brief Checks that a host requiring connect cookies gives no peer to a connect without a
+        valid one
+*/
+#include <string.h>
+#include "harness.h"
+
+#define CONNECT_ID 0x1234567
+
+static ENetHost * server;
+
+static ENetSocket
+create_socket (void)
+{
+    ENetAddress address;
+    ENetSocket socket = enet_socket_create (ENET_SOCKET_TYPE_DATAGRAM);
+
+    harness_loopback (& address, 0);
+
+    HARNESS_CHECK (socket != ENET_SOCKET_NULL);
+    HARNESS_CHECK (enet_socket_bind (socket, & address) == 0);
+
+    return socket;
+}
+
+/* Sends a connect to the server from the socket, behind the cookie if one is given, and
+   services the server until it replies. Returns whether the reply was a cookie, which is
+   then stored in reply. */
+static int
+send_connect (ENetSocket socket, const ENetProtocolCookie * cookie, enet_uint32 connectID, ENetProtocolCookie * reply)
+{
+    ENetAddress address;
+    ENetBuffer buffer;
+    ENetEvent event;
+    enet_uint8 data [ENET_PROTOCOL_MAXIMUM_MTU];
+    enet_uint32 start = enet_time_get (), condition;
+    int length;
+
+    harness_loopback (& address, server -> address.port);
+
+    buffer.data = data;
+    buffer.dataLength = harness_write_connect (data, cookie, connectID);
+
+    HARNESS_CHECK (enet_socket_send (socket, & address, & buffer, 1) == (int) buffer.dataLength);
+
+    do
+    {
+       while (enet_host_service (server, & event, 0) > 0)
+         HARNESS_CHECK (event.type != ENET_EVENT_TYPE_CONNECT);
+
+       condition = ENET_SOCKET_WAIT_RECEIVE;
+       HARNESS_CHECK (enet_socket_wait (socket, & condition, 1) == 0);
+       if (! (condition & ENET_SOCKET_WAIT_RECEIVE))
+         continue;
+
+       buffer.data = data;
+       buffer.dataLength = sizeof (data);
+       length = enet_socket_receive (socket, & address, & buffer, 1);
+       HARNESS_CHECK (length > 0);
+
+       if ((size_t) length == sizeof (enet_uint16) + sizeof (ENetProtocolCookie) &&
+           (data [sizeof (enet_uint16)] & ENET_PROTOCOL_COMMAND_MASK) == ENET_PROTOCOL_COMMAND_COOKIE)
+       {
+          memcpy (reply, & data [sizeof (enet_uint16)], sizeof (ENetProtocolCookie));
+
+          HARNESS_CHECK (reply -> connectID == connectID);
+
+          return 1;
+       }
+
+       return 0;
+    } while (ENET_TIME_DIFFERENCE (enet_time_get (), start) < 1000);
+
+    return 0;
+}
+
+int
+main (int argc, char ** argv)
+{
+    enet_uint8 secret [ENET_HOST_COOKIE_SECRET_SIZE];
+    ENetProtocolCookie cookie, forged, reply;
+    ENetSocket socket, otherSocket;
+    size_t freePeers;
+
+    harness_initialize ();
+
+    memset (secret, 0x5A, sizeof (secret));
+    server = harness_create_server (4, 1);
+    enet_host_connect_cookies (server, secret);
+    freePeers = enet_list_size (& server -> freePeers);
+
+    socket = create_socket ();
+    otherSocket = create_socket ();
+
+    /* A connect without a cookie is answered with one and takes no peer. */
+    HARNESS_CHECK (send_connect (socket, NULL, CONNECT_ID, & cookie));
+    HARNESS_CHECK (enet_list_size (& server -> freePeers) == freePeers);
+
+    /* Neither does one behind a cookie with a forged MAC... */
+    forged = cookie;
+    forged.mac ^= ENET_HOST_TO_NET_32 (1);
+    HARNESS_CHECK (send_connect (socket, & forged, CONNECT_ID, & reply));
+    HARNESS_CHECK (enet_list_size (& server -> freePeers) == freePeers);
+
+    /* ...or a forged timestamp... */
+    forged = cookie;
+    forged.timestamp = ENET_HOST_TO_NET_32 (ENET_NET_TO_HOST_32 (cookie.timestamp) - 1);
+    HARNESS_CHECK (send_connect (socket, & forged, CONNECT_ID, & reply));
+    HARNESS_CHECK (enet_list_size (& server -> freePeers) == freePeers);
+
+    /* ...or a valid cookie vouching for a different connect... */
+    forged = cookie;
+    forged.connectID = CONNECT_ID + 1;
+    HARNESS_CHECK (send_connect (socket, & forged, CONNECT_ID + 1, & reply));
+    HARNESS_CHECK (enet_list_size (& server -> freePeers) == freePeers);
+
+    /* ...or a valid cookie replayed from another address. */
+    HARNESS_CHECK (send_connect (otherSocket, & cookie, CONNECT_ID, & reply));
+    HARNESS_CHECK (enet_list_size (& server -> freePeers) == freePeers);
+
+    /* A cookie is stale once its lifetime has passed. */
+    enet_time_set (enet_time_get () + ENET_HOST_COOKIE_LIFETIME);
+    HARNESS_CHECK (send_connect (socket, & cookie, CONNECT_ID, & reply));
+    HARNESS_CHECK (enet_list_size (& server -> freePeers) == freePeers);
+
+    /* The fresh cookie from that reply is taken, and only then is a peer used. */
+    HARNESS_CHECK (! send_connect (socket, & reply, CONNECT_ID, & cookie));
+    HARNESS_CHECK (enet_list_size (& server -> freePeers) == freePeers - 1);
+
+    enet_socket_destroy (socket);
+    enet_socket_destroy (otherSocket);
+    enet_host_destroy (server);
+
+    printf ("connects without a valid cookie took no peer\n");
+    return 0;
+}
@@ -0,0 +1,202 @@
+/**
+ @file  duplicate.c
+ @brief Checks that the peers a host counts against its duplicate peer limit through its
+        address buckets are the ones a scan of every peer finds
+*/
+#include <string.h>
+#include "harness.h"
+
+#define SERVER_PEERS 48
+#define DUPLICATE_PEERS 5
+#define ADDRESS_COUNT 8
+#define SOCKETS_PER_ADDRESS 4
+#define SOCKET_COUNT (ADDRESS_COUNT * SOCKETS_PER_ADDRESS)
+#define ROUNDS 4000
+
+static ENetHost * server;
+static ENetSocket sockets [SOCKET_COUNT];
+static ENetAddress addresses [SOCKET_COUNT];
+static enet_uint32 connectIDs [SOCKET_COUNT];
+
+/* Counts the peers from the IP address that a connect from it is measured against, the way
+   enet_protocol_handle_connect() does: through the address's bucket. */
+static size_t
+bucket_duplicates (enet_uint32 address)
+{
+    ENetList * bucket = enet_host_address_bucket (server, address);
+    ENetListIterator currentNode;
+    size_t duplicates = 0;
+
+    for (currentNode = enet_list_begin (bucket);
+         currentNode != enet_list_end (bucket);
+         currentNode = enet_list_next (currentNode))
+    {
+       ENetPeer * peer = (ENetPeer *) ((enet_uint8 *) currentNode - (size_t) & ((ENetPeer *) 0) -> addressList);
+
+       HARNESS_CHECK (peer -> state != ENET_PEER_STATE_DISCONNECTED);
+
+       if (peer -> state != ENET_PEER_STATE_CONNECTING && peer -> address.host == address)
+         ++ duplicates;
+    }
+
+    return duplicates;
+}
+
+/* Counts the same peers by scanning every peer of the host, as ENet did before it kept buckets. */
+static size_t
+scan_duplicates (enet_uint32 address)
+{
+    ENetPeer * peer;
+    size_t duplicates = 0;
+
+    for (peer = server -> peers; peer < & server -> peers [server -> peerCount]; ++ peer)
+      if (peer -> state != ENET_PEER_STATE_DISCONNECTED &&
+          peer -> state != ENET_PEER_STATE_CONNECTING &&
+          peer -> address.host == address)
+        ++ duplicates;
+
+    return duplicates;
+}
+
+static ENetPeer *
+find_peer (const ENetAddress * address, enet_uint32 connectID)
+{
+    ENetPeer * peer;
+
+    for (peer = server -> peers; peer < & server -> peers [server -> peerCount]; ++ peer)
+      if (peer -> state != ENET_PEER_STATE_DISCONNECTED &&
+          peer -> address.host == address -> host &&
+          peer -> address.port == address -> port &&
+          peer -> connectID == connectID)
+        return peer;
+
+    return NULL;
+}
+
+static void
+check_accounting (void)
+{
+    ENetPeer * peer;
+    size_t addressIndex, freePeers = 0;
+
+    for (peer = server -> peers; peer < & server -> peers [server -> peerCount]; ++ peer)
+      if (peer -> state == ENET_PEER_STATE_DISCONNECTED)
+        ++ freePeers;
+
+    HARNESS_CHECK (enet_list_size (& server -> freePeers) == freePeers);
+
+    for (addressIndex = 0; addressIndex < SOCKET_COUNT; addressIndex += SOCKETS_PER_ADDRESS)
+      HARNESS_CHECK (bucket_duplicates (addresses [addressIndex].host) == scan_duplicates (addresses [addressIndex].host));
+}
+
+/* Sends a connect from a socket and services the server until it has read it. Returns
+   whether the server gave it a new peer. */
+static int
+send_connect (size_t socketIndex, enet_uint32 connectID)
+{
+    ENetAddress serverAddress;
+    ENetBuffer buffer;
+    ENetEvent event;
+    enet_uint8 data [ENET_PROTOCOL_MAXIMUM_MTU];
+    ENetPeer * peer = find_peer (& addresses [socketIndex], connectID);
+    enet_uint32 receivedPackets = server -> totalReceivedPackets,
+                start = enet_time_get ();
+
+    harness_loopback (& serverAddress, server -> address.port);
+
+    buffer.data = data;
+    buffer.dataLength = harness_write_connect (data, NULL, connectID);
+    HARNESS_CHECK (enet_socket_send (sockets [socketIndex], & serverAddress, & buffer, 1) == (int) buffer.dataLength);
+
+    while (server -> totalReceivedPackets == receivedPackets)
+    {
+       HARNESS_CHECK (ENET_TIME_DIFFERENCE (enet_time_get (), start) < 1000);
+
+       enet_host_service (server, & event, 0);
+    }
+
+    return find_peer (& addresses [socketIndex], connectID) != peer;
+}
+
+int
+main (int argc, char ** argv)
+{
+    size_t socketIndex, otherBuckets = 0, accepted = 0, rejected = 0;
+    int round;
+
+    harness_initialize ();
+    harness_seed (argc > 1 ? (enet_uint32) strtoul (argv [1], NULL, 0) : 1);
+
+    server = harness_create_server (SERVER_PEERS, 1);
+    server -> duplicatePeers = DUPLICATE_PEERS;
+
+    /* Several sockets on each of several loopback addresses, so some connects come from
+       the same IP address and others may only share its bucket. */
+    for (socketIndex = 0; socketIndex < SOCKET_COUNT; ++ socketIndex)
+    {
+       addresses [socketIndex].host = ENET_HOST_TO_NET_32 (0x7F000200 + (enet_uint32) (socketIndex / SOCKETS_PER_ADDRESS) + 1);
+       addresses [socketIndex].port = 0;
+
+       sockets [socketIndex] = enet_socket_create (ENET_SOCKET_TYPE_DATAGRAM);
+       HARNESS_CHECK (sockets [socketIndex] != ENET_SOCKET_NULL);
+       HARNESS_CHECK (enet_socket_bind (sockets [socketIndex], & addresses [socketIndex]) == 0);
+       HARNESS_CHECK (enet_socket_get_address (sockets [socketIndex], & addresses [socketIndex]) == 0);
+
+       if (socketIndex % SOCKETS_PER_ADDRESS == 0 &&
+           enet_host_address_bucket (server, addresses [socketIndex].host) != enet_host_address_bucket (server, addresses [0].host))
+         ++ otherBuckets;
+    }
+
+    /* The hosts of a local network differ only in their last octets, which must still spread
+       them over the buckets. */
+    HARNESS_CHECK (otherBuckets > 0);
+
+    for (round = 0; round < ROUNDS; ++ round)
+    {
+       enet_uint32 choice = harness_random () % 10;
+
+       socketIndex = harness_random () % SOCKET_COUNT;
+
+       if (choice < 6)
+       {
+          /* A connect is refused when no peer is free, when it repeats one already taken, or
+             when its IP address already has the allowed number of peers. */
+          enet_uint32 connectID = harness_random () % 4 == 0 && connectIDs [socketIndex] != 0 ? connectIDs [socketIndex] : harness_random () | 1;
+          int expected = ! enet_list_empty (& server -> freePeers) &&
+                         find_peer (& addresses [socketIndex], connectID) == NULL &&
+                         scan_duplicates (addresses [socketIndex].host) < DUPLICATE_PEERS;
+
+          connectIDs [socketIndex] = connectID;
+
+          HARNESS_CHECK (send_connect (socketIndex, connectID) == expected);
+          if (expected)
+            ++ accepted;
+          else
+            ++ rejected;
+       }
+       else
+       if (choice < 9)
+       {
+          /* Free a peer in use, as a disconnect or timeout would. */
+          ENetPeer * peer = & server -> peers [harness_random () % SERVER_PEERS];
+
+          if (peer -> state != ENET_PEER_STATE_DISCONNECTED)
+            enet_peer_reset (peer);
+       }
+       else
+       if (! enet_list_empty (& server -> freePeers))
+       {
+          /* Peers the host is connecting out to itself are not counted as duplicates. */
+          HARNESS_CHECK (enet_host_connect (server, & addresses [socketIndex], 1, 0) != NULL);
+       }
+
+       check_accounting ();
+    }
+
+    for (socketIndex = 0; socketIndex < SOCKET_COUNT; ++ socketIndex)
+      enet_socket_destroy (sockets [socketIndex]);
+    enet_host_destroy (server);
+
+    printf ("%u connects taken and %u refused, counted alike by buckets and by scan\n", (unsigned) accepted, (unsigned) rejected);
+    return 0;
+}
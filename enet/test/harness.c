@@ -0,0 +1,206 @@
+/** 
+ @file  harness.c
+ @brief Helpers shared by the ENet tests and benchmarks
+*/
+#include <time.h>
+#include <string.h>
+#include "harness.h"
+
+#define HARNESS_CONNECT_WINDOW 256
+
+static enet_uint32 randomState = 0x2545F491;
+
+void
+harness_fail (const char * file, int line, const char * condition)
+{
+    fprintf (stderr, "%s:%d: check failed: %s\n", file, line, condition);
+    exit (1);
+}
+
+/** Seeds harness_random(), so a run can be repeated. */
+void
+harness_seed (enet_uint32 seed)
+{
+    randomState = seed != 0 ? seed : 0x2545F491;
+}
+
+enet_uint32
+harness_random (void)
+{
+    randomState ^= randomState << 13;
+    randomState ^= randomState >> 17;
+    randomState ^= randomState << 5;
+    return randomState;
+}
+
+/** Returns wall time in seconds, from the same clock ENet reads. Only differences are meaningful. */
+double
+harness_seconds (void)
+{
+    static enet_uint32 lastTime = 0;
+    static double seconds = 0.0;
+    enet_uint32 time = enet_time_get_microseconds ();
+
+    /* The microsecond clock wraps every 71 minutes; count its turns as long as it is read more often than that. */
+    seconds += (enet_uint32) (time - lastTime) / 1000000.0;
+    lastTime = time;
+
+    return seconds;
+}
+
+/** Returns the processor time used by the program in seconds. */
+double
+harness_cpu_seconds (void)
+{
+    return (double) clock () / CLOCKS_PER_SEC;
+}
+
+void
+harness_initialize (void)
+{
+    if (enet_initialize () != 0)
+    {
+       fprintf (stderr, "failed to initialise ENet\n");
+       exit (1);
+    }
+
+    atexit (enet_deinitialize);
+
+    harness_seconds ();
+}
+
+void
+harness_loopback (ENetAddress * address, enet_uint16 port)
+{
+    address -> host = ENET_HOST_TO_NET_32 (0x7F000001);
+    address -> port = port;
+}
+
+/** Creates a host listening on a free loopback port. */
+ENetHost *
+harness_create_server (size_t peerCount, size_t channelLimit)
+{
+    ENetAddress address;
+    ENetHost * host;
+
+    harness_loopback (& address, 0);
+
+    host = enet_host_create (& address, peerCount, channelLimit, 0, 0);
+    if (host == NULL)
+    {
+       fprintf (stderr, "failed to create a host with %u peers\n", (unsigned) peerCount);
+       exit (1);
+    }
+
+    return host;
+}
+
+/** Connects peerCount peers of client to server and services both until they are all
+    connected, or until ten seconds pass. At most HARNESS_CONNECT_WINDOW connects are pending
+    at once, so a burst of thousands does not overflow the server's socket buffer.
+    @returns the number of peers connected
+*/
+size_t
+harness_connect (ENetHost * client, ENetHost * server, ENetPeer ** peers, size_t peerCount, size_t channelCount)
+{
+    ENetAddress address;
+    ENetEvent event;
+    size_t peerIndex = 0, clientConnected = 0, serverConnected = 0;
+    enet_uint32 start = enet_time_get ();
+
+    harness_loopback (& address, server -> address.port);
+
+    while ((peerIndex < peerCount || clientConnected < peerIndex || serverConnected < peerIndex) &&
+           ENET_TIME_DIFFERENCE (enet_time_get (), start) < 10000)
+    {
+       for (; peerIndex < peerCount && peerIndex - clientConnected < HARNESS_CONNECT_WINDOW; ++ peerIndex)
+       {
+          peers [peerIndex] = enet_host_connect (client, & address, channelCount, 0);
+          if (peers [peerIndex] == NULL)
+          {
+             peerCount = peerIndex;
+             break;
+          }
+       }
+
+       while (enet_host_service (client, & event, 0) > 0)
+         if (event.type == ENET_EVENT_TYPE_CONNECT)
+           ++ clientConnected;
+
+       while (enet_host_service (server, & event, 1) > 0)
+       {
+          if (event.type == ENET_EVENT_TYPE_CONNECT)
+            ++ serverConnected;
+          else
+          if (event.type == ENET_EVENT_TYPE_RECEIVE)
+            enet_packet_destroy (event.packet);
+       }
+    }
+
+    return clientConnected < serverConnected ? clientConnected : serverConnected;
+}
+
+/** Services the hosts for duration milliseconds, discarding the packets they receive.
+    @returns the number of packets received
+*/
+size_t
+harness_service (ENetHost ** hosts, size_t hostCount, enet_uint32 duration)
+{
+    ENetEvent event;
+    size_t hostIndex, received = 0;
+    enet_uint32 start = enet_time_get ();
+
+    do
+    {
+       for (hostIndex = 0; hostIndex < hostCount; ++ hostIndex)
+         while (enet_host_service (hosts [hostIndex], & event, 0) > 0)
+         {
+            if (event.type == ENET_EVENT_TYPE_RECEIVE)
+            {
+               ++ received;
+
+               enet_packet_destroy (event.packet);
+            }
+         }
+    } while (ENET_TIME_DIFFERENCE (enet_time_get (), start) < duration);
+
+    return received;
+}
+
+
+/** Writes a datagram asking for a new connection, as a peer with one channel would, behind
+    an echoed cookie if one is given. data should hold ENET_PROTOCOL_MAXIMUM_MTU bytes.
+    @returns the length of the datagram
+*/
+size_t
+harness_write_connect (enet_uint8 * data, const ENetProtocolCookie * cookie, enet_uint32 connectID)
+{
+    ENetProtocolConnect connect;
+    size_t length = sizeof (enet_uint16);
+
+    * (enet_uint16 *) data = ENET_HOST_TO_NET_16 (ENET_PROTOCOL_MAXIMUM_PEER_ID);
+
+    if (cookie != NULL)
+    {
+       memcpy (& data [length], cookie, sizeof (ENetProtocolCookie));
+       length += sizeof (ENetProtocolCookie);
+    }
+
+    memset (& connect, 0, sizeof (connect));
+    connect.header.command = ENET_PROTOCOL_COMMAND_CONNECT | ENET_PROTOCOL_COMMAND_FLAG_ACKNOWLEDGE;
+    connect.header.channelID = 0xFF;
+    connect.header.reliableSequenceNumber = ENET_HOST_TO_NET_16 (1);
+    connect.incomingSessionID = 0xFF;
+    connect.outgoingSessionID = 0xFF;
+    connect.mtu = ENET_HOST_TO_NET_32 (ENET_HOST_DEFAULT_MTU);
+    connect.windowSize = ENET_HOST_TO_NET_32 (ENET_PROTOCOL_MAXIMUM_WINDOW_SIZE);
+    connect.channelCount = ENET_HOST_TO_NET_32 (1);
+    connect.packetThrottleInterval = ENET_HOST_TO_NET_32 (ENET_PEER_PACKET_THROTTLE_INTERVAL);
+    connect.packetThrottleAcceleration = ENET_HOST_TO_NET_32 (ENET_PEER_PACKET_THROTTLE_ACCELERATION);
+    connect.packetThrottleDeceleration = ENET_HOST_TO_NET_32 (ENET_PEER_PACKET_THROTTLE_DECELERATION);
+    connect.connectID = connectID;
+
+    memcpy (& data [length], & connect, sizeof (connect));
+
+    return length + sizeof (connect);
+}
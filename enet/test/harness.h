@@ -0,0 +1,33 @@
+/** 
+ @file  harness.h
+ @brief Helpers shared by the ENet tests and benchmarks
+*/
+#ifndef __ENET_TEST_HARNESS_H__
+#define __ENET_TEST_HARNESS_H__
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "enet/enet.h"
+#include "enet/time.h"
+
+/** Fails the calling program with a message naming the check when condition is false. */
+#define HARNESS_CHECK(condition) \
+    do { if (! (condition)) harness_fail (__FILE__, __LINE__, #condition); } while (0)
+
+extern void harness_fail (const char * file, int line, const char * condition);
+
+extern void harness_seed (enet_uint32 seed);
+extern enet_uint32 harness_random (void);
+
+extern double harness_seconds (void);
+extern double harness_cpu_seconds (void);
+
+extern void harness_initialize (void);
+extern void harness_loopback (ENetAddress * address, enet_uint16 port);
+extern ENetHost * harness_create_server (size_t peerCount, size_t channelLimit);
+extern size_t harness_connect (ENetHost * client, ENetHost * server, ENetPeer ** peers, size_t peerCount, size_t channelCount);
+extern size_t harness_service (ENetHost ** hosts, size_t hostCount, enet_uint32 duration);
+extern size_t harness_write_connect (enet_uint8 * data, const ENetProtocolCookie * cookie, enet_uint32 connectID);
+
+#endif /* __ENET_TEST_HARNESS_H__ */
+
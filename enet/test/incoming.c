@@ -0,0 +1,315 @@
+/**
+ @file  incoming.c
+ @brief Checks that reliable commands and fragmented packets are dispatched in sequence order
+        however they arrive
+*/
+#include <string.h>
+#include "harness.h"
+
+#define ROUNDS 400
+#define MAXIMUM_BATCH 3000
+#define MAXIMUM_FRAGMENTS 16
+
+enum
+{
+   MODEL_EMPTY    = 0,
+   MODEL_RELIABLE = 1,
+   MODEL_FRAGMENT = 2
+};
+
+/** One command arriving: a reliable command when fragmentCount is 0, else a fragment of the
+    packet whose first sequence number is start. Sequence numbers are offsets from the start
+    of the round's batch. */
+typedef struct _Arrival
+{
+   int start;
+   enet_uint16 fragmentNumber;
+   enet_uint16 fragmentCount;
+} Arrival;
+
+/* The reference model: a table indexed by sequence number offset, with none of the ring's
+   wrapping or masking, and the sequence numbers it has dispatched in order. */
+static enet_uint8 modelQueued [MAXIMUM_BATCH];
+static enet_uint8 modelReceived [MAXIMUM_BATCH];
+static enet_uint16 modelRemaining [MAXIMUM_BATCH];
+static int messageStarts [MAXIMUM_BATCH];
+static enet_uint16 messageCounts [MAXIMUM_BATCH];
+static int modelNext;
+static size_t modelDropped;
+static int expectedDispatches [MAXIMUM_BATCH];
+static size_t expectedHead, expectedTail;
+
+static void
+write_id (enet_uint8 * data, enet_uint16 id)
+{
+    data [0] = (enet_uint8) (id >> 8);
+    data [1] = (enet_uint8) id;
+}
+
+static void
+queue_reliable (ENetPeer * peer, enet_uint16 reliableSequenceNumber)
+{
+    ENetProtocol command;
+    enet_uint8 data [2];
+
+    memset (& command, 0, sizeof (command));
+    command.header.command = ENET_PROTOCOL_COMMAND_SEND_RELIABLE | ENET_PROTOCOL_COMMAND_FLAG_ACKNOWLEDGE;
+    command.header.channelID = 0;
+    command.header.reliableSequenceNumber = reliableSequenceNumber;
+
+    write_id (data, reliableSequenceNumber);
+
+    HARNESS_CHECK (enet_peer_queue_incoming_command (peer, & command, data, sizeof (data), ENET_PACKET_FLAG_RELIABLE, 0) != NULL);
+}
+
+/* Queues a fragment the way enet_protocol_handle_send_fragment() does. Every fragment carries
+   the packet's first sequence number as its two bytes of data. */
+static void
+queue_fragment (ENetPeer * peer, enet_uint16 startSequenceNumber, enet_uint32 fragmentNumber, enet_uint32 fragmentCount)
+{
+    ENetChannel * channel = & peer -> channels [0];
+    enet_uint16 startWindow = startSequenceNumber / ENET_PEER_RELIABLE_WINDOW_SIZE,
+                currentWindow = channel -> incomingReliableSequenceNumber / ENET_PEER_RELIABLE_WINDOW_SIZE;
+    ENetIncomingCommand * startCommand;
+
+    if (startSequenceNumber < channel -> incomingReliableSequenceNumber)
+      startWindow += ENET_PEER_RELIABLE_WINDOWS;
+
+    if (startWindow < currentWindow || startWindow >= currentWindow + ENET_PEER_FREE_RELIABLE_WINDOWS - 1)
+      return;
+
+    startCommand = enet_peer_find_incoming_reliable_command (channel, startSequenceNumber);
+    if (startCommand == NULL)
+    {
+       ENetProtocol command;
+
+       memset (& command, 0, sizeof (command));
+       command.header.command = ENET_PROTOCOL_COMMAND_SEND_FRAGMENT | ENET_PROTOCOL_COMMAND_FLAG_ACKNOWLEDGE;
+       command.header.channelID = 0;
+       command.header.reliableSequenceNumber = startSequenceNumber;
+
+       startCommand = enet_peer_queue_incoming_command (peer, & command, NULL, fragmentCount * 2, ENET_PACKET_FLAG_RELIABLE, fragmentCount);
+       HARNESS_CHECK (startCommand != NULL);
+    }
+
+    HARNESS_CHECK (startCommand -> fragmentCount == fragmentCount);
+
+    if ((startCommand -> fragments [fragmentNumber / 32] & (1 << (fragmentNumber % 32))) == 0)
+    {
+       -- startCommand -> fragmentsRemaining;
+
+       startCommand -> fragments [fragmentNumber / 32] |= (1 << (fragmentNumber % 32));
+
+       write_id (startCommand -> packet -> data + fragmentNumber * 2, startSequenceNumber);
+
+       if (startCommand -> fragmentsRemaining <= 0)
+         enet_peer_dispatch_incoming_reliable_commands (peer, channel);
+    }
+}
+
+/* Applies an arrival to the model, recording what it expects to be dispatched. A fragmented
+   packet takes the sequence numbers of all its fragments, so a reliable command queued on
+   one of them is dropped once the packet is dispatched. */
+static void
+model_arrive (const Arrival * arrival)
+{
+    if (arrival -> start < modelNext)
+      return;
+
+    if (arrival -> fragmentCount == 0)
+    {
+       if (modelQueued [arrival -> start] != MODEL_EMPTY)
+         return;
+
+       modelQueued [arrival -> start] = MODEL_RELIABLE;
+    }
+    else
+    {
+       if (modelQueued [arrival -> start] == MODEL_EMPTY)
+       {
+          modelQueued [arrival -> start] = MODEL_FRAGMENT;
+          modelRemaining [arrival -> start] = arrival -> fragmentCount;
+       }
+
+       if (modelReceived [arrival -> start + arrival -> fragmentNumber])
+         return;
+
+       modelReceived [arrival -> start + arrival -> fragmentNumber] = 1;
+       -- modelRemaining [arrival -> start];
+    }
+
+    while (modelNext < MAXIMUM_BATCH &&
+           modelQueued [modelNext] != MODEL_EMPTY &&
+           (modelQueued [modelNext] != MODEL_FRAGMENT || modelRemaining [modelNext] == 0))
+    {
+       int span = modelQueued [modelNext] == MODEL_FRAGMENT ? messageCounts [modelNext] : 1,
+           offset;
+
+       for (offset = modelNext + 1; offset < modelNext + span; ++ offset)
+         if (modelQueued [offset] != MODEL_EMPTY)
+         {
+            modelQueued [offset] = MODEL_EMPTY;
+            ++ modelDropped;
+         }
+
+       modelQueued [modelNext] = MODEL_EMPTY;
+       expectedDispatches [expectedTail ++] = modelNext;
+       modelNext += span;
+    }
+}
+
+/* Checks that the peer has dispatched exactly what the model expects, in the same order. */
+static void
+check_dispatches (ENetPeer * peer, enet_uint32 base)
+{
+    ENetPacket * packet;
+
+    while ((packet = enet_peer_receive (peer, NULL)) != NULL)
+    {
+       int start, length, offset;
+
+       HARNESS_CHECK (expectedHead < expectedTail);
+
+       start = expectedDispatches [expectedHead ++];
+       length = messageCounts [start] > 0 ? messageCounts [start] * 2 : 2;
+
+       HARNESS_CHECK (packet -> dataLength == (size_t) length);
+       for (offset = 0; offset < length; offset += 2)
+         HARNESS_CHECK (((packet -> data [offset] << 8) | packet -> data [offset + 1]) == (enet_uint16) (base + start));
+
+       enet_packet_destroy (packet);
+    }
+
+    HARNESS_CHECK (expectedHead == expectedTail);
+}
+
+int
+main (int argc, char ** argv)
+{
+    static Arrival arrivals [MAXIMUM_BATCH * 3];
+    ENetAddress address;
+    ENetHost * host;
+    ENetPeer * peer;
+    enet_uint32 base = 1;
+    size_t fragmented = 0, dropped = 0;
+    int round;
+
+    harness_initialize ();
+    harness_seed (argc > 1 ? (enet_uint32) strtoul (argv [1], NULL, 0) : 1);
+
+    host = enet_host_create (NULL, 1, 1, 0, 0);
+    HARNESS_CHECK (host != NULL);
+
+    harness_loopback (& address, 1);
+    peer = enet_host_connect (host, & address, 1, 0);
+    HARNESS_CHECK (peer != NULL);
+    peer -> state = ENET_PEER_STATE_CONNECTED;
+
+    /* Enough rounds for the sequence numbers to wrap several times. */
+    for (round = 0; round < ROUNDS; ++ round)
+    {
+       int batch = 1 + (int) (harness_random () % MAXIMUM_BATCH),
+           offset = 0;
+       size_t arrivalCount = 0, arrival;
+
+       memset (modelQueued, 0, sizeof (modelQueued));
+       memset (modelReceived, 0, sizeof (modelReceived));
+       modelNext = 0;
+       modelDropped = 0;
+       expectedHead = expectedTail = 0;
+
+       /* Split the batch's sequence numbers into reliable commands and fragmented packets. */
+       while (offset < batch)
+       {
+          int count = 0, number;
+
+          if (harness_random () % 4 == 0 && batch - offset >= 2)
+          {
+             count = 2 + (int) (harness_random () % (MAXIMUM_FRAGMENTS - 1));
+             if (count > batch - offset)
+               count = batch - offset;
+
+             ++ fragmented;
+          }
+
+          for (number = 0; number < (count > 0 ? count : 1); ++ number)
+          {
+             messageStarts [offset + number] = offset;
+             messageCounts [offset + number] = (enet_uint16) count;
+          }
+
+          offset += count > 0 ? count : 1;
+       }
+
+       /* Every command and fragment of the batch arrives once and some arrive twice. A few
+          reliable commands repeat ones already dispatched, and others are queued on the
+          sequence numbers a fragmented packet takes, as a misbehaving peer could send them. */
+       for (offset = 0; offset < batch; ++ offset)
+       {
+          int other = (int) (harness_random () % batch);
+
+          arrivals [arrivalCount].start = messageStarts [offset];
+          arrivals [arrivalCount].fragmentNumber = (enet_uint16) (offset - messageStarts [offset]);
+          arrivals [arrivalCount ++].fragmentCount = messageCounts [offset];
+
+          if (harness_random () % 8 == 0)
+          {
+             arrivals [arrivalCount].start = messageStarts [other];
+             arrivals [arrivalCount].fragmentNumber = (enet_uint16) (other - messageStarts [other]);
+             arrivals [arrivalCount ++].fragmentCount = messageCounts [other];
+          }
+          else
+          if (harness_random () % 64 == 0)
+          {
+             arrivals [arrivalCount].start = - 1 - (int) (harness_random () % 100);
+             arrivals [arrivalCount].fragmentNumber = 0;
+             arrivals [arrivalCount ++].fragmentCount = 0;
+          }
+
+          if (messageCounts [offset] > 0 && offset == messageStarts [offset] && harness_random () % 2 == 0)
+          {
+             arrivals [arrivalCount].start = offset + 1 + (int) (harness_random () % (messageCounts [offset] - 1));
+             arrivals [arrivalCount].fragmentNumber = 0;
+             arrivals [arrivalCount ++].fragmentCount = 0;
+          }
+       }
+
+       for (arrival = arrivalCount; arrival > 1; -- arrival)
+       {
+          size_t other = harness_random () % arrival;
+          Arrival swap = arrivals [arrival - 1];
+
+          arrivals [arrival - 1] = arrivals [other];
+          arrivals [other] = swap;
+       }
+
+       for (arrival = 0; arrival < arrivalCount; ++ arrival)
+       {
+          enet_uint16 startSequenceNumber = (enet_uint16) (base + (enet_uint32) arrivals [arrival].start);
+
+          if (arrivals [arrival].fragmentCount == 0)
+            queue_reliable (peer, startSequenceNumber);
+          else
+            queue_fragment (peer, startSequenceNumber, arrivals [arrival].fragmentNumber, arrivals [arrival].fragmentCount);
+
+          model_arrive (& arrivals [arrival]);
+
+          check_dispatches (peer, base);
+       }
+
+       /* Everything was dispatched or dropped, and nothing dropped is still held. */
+       HARNESS_CHECK (modelNext == batch);
+       HARNESS_CHECK (peer -> channels [0].incomingReliableCount == 0);
+       HARNESS_CHECK (peer -> totalWaitingData == 0);
+
+       dropped += modelDropped;
+       base += (enet_uint32) batch;
+    }
+
+    enet_peer_reset (peer);
+    enet_host_destroy (host);
+
+    printf ("%d rounds dispatched in order, with %u fragmented packets and %u commands dropped from their sequence numbers\n",
+            round, (unsigned) fragmented, (unsigned) dropped);
+    return 0;
+}
@@ -0,0 +1,279 @@
+/**
+ @file  link.c
+ @brief An in-process link between a client and a server host with a bottleneck, latency and loss
+
+ The link is a relay socket on loopback. The client connects to the relay's address and the
+ server sees the relay as its peer, so both hosts run unchanged while every datagram between
+ them goes through the model in HarnessLinkDirection. Nothing moves unless the link is
+ serviced, so it should be serviced between the hosts, at least once a millisecond. The link
+ keeps time with the process, so it is only faithful while the process has a processor to
+ itself: one that is made to wait passes on late datagrams all at once.
+*/
+#include <string.h>
+#include "link.h"
+
+#define HARNESS_LINK_SOCKET_BUFFER (4 * 1024 * 1024)
+
+/** Creates a link to server with neither a bottleneck, latency nor loss in either direction. */
+void
+harness_link_create (HarnessLink * link, ENetHost * server)
+{
+    memset (link, 0, sizeof (HarnessLink));
+
+    harness_loopback (& link -> address, 0);
+    harness_loopback (& link -> serverAddress, server -> address.port);
+
+    link -> socket = enet_socket_create (ENET_SOCKET_TYPE_DATAGRAM);
+    if (link -> socket == ENET_SOCKET_NULL ||
+        enet_socket_bind (link -> socket, & link -> address) < 0 ||
+        enet_socket_get_address (link -> socket, & link -> address) < 0)
+    {
+       fprintf (stderr, "failed to create a link\n");
+       exit (1);
+    }
+
+    link -> address.host = link -> serverAddress.host;
+
+    /* ENet's time macros hold for microseconds too, for times less than 86 seconds apart. */
+    link -> toServer.busyTime = link -> toClient.busyTime = enet_time_get_microseconds ();
+
+    enet_socket_set_option (link -> socket, ENET_SOCKOPT_NONBLOCK, 1);
+    enet_socket_set_option (link -> socket, ENET_SOCKOPT_RCVBUF, HARNESS_LINK_SOCKET_BUFFER);
+    enet_socket_set_option (link -> socket, ENET_SOCKOPT_SNDBUF, HARNESS_LINK_SOCKET_BUFFER);
+}
+
+static void
+harness_link_clear (HarnessLinkDirection * direction)
+{
+    HarnessLinkDatagram * datagram;
+
+    while (direction -> head != NULL)
+    {
+       datagram = direction -> head;
+       direction -> head = datagram -> next;
+
+       free (datagram);
+    }
+
+    direction -> tail = NULL;
+}
+
+void
+harness_link_destroy (HarnessLink * link)
+{
+    harness_link_clear (& link -> toServer);
+    harness_link_clear (& link -> toClient);
+
+    enet_socket_destroy (link -> socket);
+}
+
+/** Sets up one direction of a link.
+    @param bandwidth bytes per second the bottleneck sends, or 0 for no bottleneck
+    @param delay one way delay in milliseconds
+    @param bufferSize bytes queued at the bottleneck before it drops datagrams
+    @param lossRate share of datagrams to drop at random, from 0 to 1
+*/
+void
+harness_link_configure (HarnessLinkDirection * direction, enet_uint32 bandwidth, enet_uint32 delay, enet_uint32 bufferSize, double lossRate)
+{
+    direction -> bandwidth = bandwidth;
+    direction -> delay = delay * 1000;
+    direction -> bufferSize = bufferSize;
+    direction -> lossRate = lossRate;
+}
+
+void
+harness_link_reset_statistics (HarnessLink * link)
+{
+    HarnessLinkDirection * directions [2];
+    size_t directionIndex;
+
+    directions [0] = & link -> toServer;
+    directions [1] = & link -> toClient;
+
+    for (directionIndex = 0; directionIndex < 2; ++ directionIndex)
+    {
+       directions [directionIndex] -> queued = 0;
+       directions [directionIndex] -> delivered = 0;
+       directions [directionIndex] -> deliveredBytes = 0;
+       directions [directionIndex] -> lost = 0;
+       directions [directionIndex] -> overflowed = 0;
+       directions [directionIndex] -> queueingDelay = 0.0;
+       directions [directionIndex] -> maximumQueueingDelay = 0.0;
+    }
+}
+
+/* Puts a datagram that reached the link at time into the direction's queue, unless it is lost
+   or the queue is full. */
+static void
+harness_link_enqueue (HarnessLinkDirection * direction, const enet_uint8 * data, size_t dataLength, enet_uint32 time)
+{
+    HarnessLinkDatagram * datagram;
+    enet_uint32 startTime = time, queueingTime;
+
+    if (direction -> lossRate > 0.0 &&
+        harness_random () % 1000000 < (enet_uint32) (direction -> lossRate * 1000000.0))
+    {
+       ++ direction -> lost;
+       return;
+    }
+
+    if (direction -> bandwidth > 0)
+    {
+       if (ENET_TIME_GREATER (direction -> busyTime, time))
+       {
+          startTime = direction -> busyTime;
+
+          if ((double) (startTime - time) * direction -> bandwidth / 1000000.0 + dataLength > direction -> bufferSize)
+          {
+             ++ direction -> overflowed;
+             return;
+          }
+       }
+
+       direction -> busyTime = startTime + (enet_uint32) ((double) dataLength * 1000000.0 / direction -> bandwidth);
+    }
+
+    datagram = (HarnessLinkDatagram *) malloc (sizeof (HarnessLinkDatagram));
+    if (datagram == NULL)
+    {
+       fprintf (stderr, "out of memory\n");
+       exit (1);
+    }
+
+    memcpy (datagram -> data, data, dataLength);
+    datagram -> dataLength = dataLength;
+    datagram -> arrivalTime = (direction -> bandwidth > 0 ? direction -> busyTime : time) + direction -> delay;
+    datagram -> next = NULL;
+
+    if (direction -> tail != NULL)
+      direction -> tail -> next = datagram;
+    else
+      direction -> head = datagram;
+    direction -> tail = datagram;
+
+    ++ direction -> queued;
+
+    queueingTime = startTime - time;
+    direction -> queueingDelay += queueingTime / 1000000.0;
+    if (queueingTime / 1000000.0 > direction -> maximumQueueingDelay)
+      direction -> maximumQueueingDelay = queueingTime / 1000000.0;
+}
+
+static size_t
+harness_link_deliver (HarnessLink * link, HarnessLinkDirection * direction, const ENetAddress * address, enet_uint32 time)
+{
+    HarnessLinkDatagram * datagram;
+    ENetBuffer buffer;
+    size_t delivered = 0;
+
+    while (direction -> head != NULL && ENET_TIME_GREATER_EQUAL (time, direction -> head -> arrivalTime))
+    {
+       datagram = direction -> head;
+       direction -> head = datagram -> next;
+       if (direction -> head == NULL)
+         direction -> tail = NULL;
+
+       buffer.data = datagram -> data;
+       buffer.dataLength = datagram -> dataLength;
+
+       if (enet_socket_send (link -> socket, address, & buffer, 1) == (int) datagram -> dataLength)
+       {
+          ++ direction -> delivered;
+          direction -> deliveredBytes += datagram -> dataLength;
+          ++ delivered;
+       }
+
+       free (datagram);
+    }
+
+    return delivered;
+}
+
+/** Takes in the datagrams either host has sent through the link and passes on those due to
+    arrive.
+    @returns the number of datagrams passed on
+*/
+size_t
+harness_link_service (HarnessLink * link)
+{
+    ENetAddress address;
+    ENetBuffer buffer;
+    enet_uint8 data [ENET_PROTOCOL_MAXIMUM_MTU];
+    enet_uint32 time;
+    size_t delivered = 0;
+    int length;
+
+    for (;;)
+    {
+       buffer.data = data;
+       buffer.dataLength = sizeof (data);
+
+       length = enet_socket_receive (link -> socket, & address, & buffer, 1);
+       if (length <= 0)
+         break;
+
+       time = enet_time_get_microseconds ();
+
+       if (address.host == link -> serverAddress.host && address.port == link -> serverAddress.port)
+         harness_link_enqueue (& link -> toClient, data, (size_t) length, time);
+       else
+       {
+          link -> clientAddress = address;
+
+          harness_link_enqueue (& link -> toServer, data, (size_t) length, time);
+       }
+    }
+
+    time = enet_time_get_microseconds ();
+
+    delivered += harness_link_deliver (link, & link -> toServer, & link -> serverAddress, time);
+    if (link -> clientAddress.port != 0)
+      delivered += harness_link_deliver (link, & link -> toClient, & link -> clientAddress, time);
+
+    return delivered;
+}
+
+/** Waits up to timeout milliseconds for either host to send through the link, so that a loop
+    servicing the hosts and the link need not spin. */
+void
+harness_link_wait (HarnessLink * link, enet_uint32 timeout)
+{
+    enet_uint32 condition = ENET_SOCKET_WAIT_RECEIVE;
+
+    enet_socket_wait (link -> socket, & condition, timeout);
+}
+
+/** Connects client to server through the link, servicing the three until the connection is
+    made or ten seconds pass.
+    @returns the client's peer, or NULL if it did not connect
+*/
+ENetPeer *
+harness_link_connect (HarnessLink * link, ENetHost * client, ENetHost * server, size_t channelCount)
+{
+    ENetPeer * peer = enet_host_connect (client, & link -> address, channelCount, 0);
+    ENetEvent event;
+    int clientConnected = 0, serverConnected = 0;
+    enet_uint32 start = enet_time_get ();
+
+    if (peer == NULL)
+      return NULL;
+
+    while ((! clientConnected || ! serverConnected) &&
+           ENET_TIME_DIFFERENCE (enet_time_get (), start) < 10000)
+    {
+       harness_link_service (link);
+
+       while (enet_host_service (client, & event, 0) > 0)
+         if (event.type == ENET_EVENT_TYPE_CONNECT)
+           clientConnected = 1;
+
+       harness_link_service (link);
+
+       while (enet_host_service (server, & event, 0) > 0)
+         if (event.type == ENET_EVENT_TYPE_CONNECT)
+           serverConnected = 1;
+    }
+
+    return clientConnected && serverConnected ? peer : NULL;
+}
@@ -0,0 +1,60 @@
+/**
+ @file  link.h
+ @brief An in-process link between a client and a server host with a bottleneck, latency and loss
+*/
+#ifndef __ENET_TEST_LINK_H__
+#define __ENET_TEST_LINK_H__
+
+#include "harness.h"
+
+typedef struct _HarnessLinkDatagram
+{
+   struct _HarnessLinkDatagram * next;
+   enet_uint32 arrivalTime;
+   size_t      dataLength;
+   enet_uint8  data [ENET_PROTOCOL_MAXIMUM_MTU];
+} HarnessLinkDatagram;
+
+/** One direction of a link. Datagrams wait in a tail drop queue of bufferSize bytes for the
+    bottleneck to send them at bandwidth, then take delay to arrive. lossRate of them are
+    dropped at random before that, as a noisy path would.
+*/
+typedef struct _HarnessLinkDirection
+{
+   enet_uint32 bandwidth;               /**< bytes per second, or 0 for no bottleneck */
+   enet_uint32 delay;                   /**< one way delay in microseconds */
+   enet_uint32 bufferSize;              /**< bytes the bottleneck queue holds */
+   double      lossRate;                /**< share of datagrams lost at random, from 0 to 1 */
+
+   enet_uint32 busyTime;                /**< enet_time_get_microseconds() when the bottleneck has sent everything queued */
+   HarnessLinkDatagram * head;          /**< datagrams on their way, in the order they arrive */
+   HarnessLinkDatagram * tail;
+
+   size_t      queued;                  /**< datagrams that went into the queue */
+   size_t      delivered;
+   size_t      deliveredBytes;
+   size_t      lost;                    /**< datagrams dropped at random */
+   size_t      overflowed;              /**< datagrams dropped because the queue was full */
+   double      queueingDelay;           /**< seconds the queued datagrams spent in the queue */
+   double      maximumQueueingDelay;
+} HarnessLinkDirection;
+
+typedef struct _HarnessLink
+{
+   ENetSocket  socket;
+   ENetAddress address;                 /**< where the client should connect to reach the server */
+   ENetAddress serverAddress;
+   ENetAddress clientAddress;           /**< learnt from the first datagram that is not the server's */
+   HarnessLinkDirection toServer;
+   HarnessLinkDirection toClient;
+} HarnessLink;
+
+extern void harness_link_create (HarnessLink * link, ENetHost * server);
+extern void harness_link_destroy (HarnessLink * link);
+extern void harness_link_configure (HarnessLinkDirection * direction, enet_uint32 bandwidth, enet_uint32 delay, enet_uint32 bufferSize, double lossRate);
+extern size_t harness_link_service (HarnessLink * link);
+extern void harness_link_wait (HarnessLink * link, enet_uint32 timeout);
+extern ENetPeer * harness_link_connect (HarnessLink * link, ENetHost * client, ENetHost * server, size_t channelCount);
+extern void harness_link_reset_statistics (HarnessLink * link);
+
+#endif /* __ENET_TEST_LINK_H__ */
@@ -0,0 +1,134 @@
+/**
+ @file  pacing.c
+ @brief Checks that a paced peer sends at its pacing rate, in bursts small enough for a short
+        bottleneck queue, whether its host is serviced continually or only every few frames
+*/
+#include <string.h>
+#include "link.h"
+
+#define PACKET_SIZE 1000
+#define QUEUED_PACKETS 64
+#define PACING_RATE 500000
+#define BANDWIDTH 600000
+#define DELAY 5
+#define BUFFER_SIZE 16384
+#define WARM_UP 0.2
+#define DURATION 1.0
+
+static enet_uint32 ENET_CALLBACK
+fixed_pacing_rate (void * context, ENetPeer * peer)
+{
+    return PACING_RATE;
+}
+
+/* Sends bulk reliable packets from a client paced at PACING_RATE through a bottleneck a little
+   faster than that, servicing the client every serviceInterval milliseconds. */
+static void
+check_pacing (enet_uint32 serviceInterval)
+{
+    ENetCongestionControl congestionControl;
+    HarnessLink link;
+    ENetHost * server, * client;
+    ENetPeer * peer;
+    ENetEvent event;
+    enet_uint8 payload [PACKET_SIZE];
+    enet_uint32 sent = 0, received = 0, index, lastService = enet_time_get ();
+    size_t pacedServices = 0;
+    double start, measureStart = 0.0, rate;
+
+    server = harness_create_server (1, 1);
+    client = enet_host_create (NULL, 1, 1, 0, 0);
+    HARNESS_CHECK (client != NULL);
+
+    memset (& congestionControl, 0, sizeof (congestionControl));
+    congestionControl.pacingRate = fixed_pacing_rate;
+    enet_host_congestion_control (client, & congestionControl);
+
+    harness_link_create (& link, server);
+    harness_link_configure (& link.toServer, BANDWIDTH, DELAY, BUFFER_SIZE, 0.0);
+    harness_link_configure (& link.toClient, 0, DELAY, 0, 0.0);
+
+    peer = harness_link_connect (& link, client, server, 1);
+    HARNESS_CHECK (peer != NULL);
+
+    memset (payload, 'x', sizeof (payload));
+
+    start = harness_seconds ();
+
+    while (measureStart == 0.0 || harness_seconds () - measureStart < DURATION)
+    {
+       /* Measure once the window has opened up, so that only pacing holds the peer back. */
+       if (measureStart == 0.0 && harness_seconds () - start >= WARM_UP)
+       {
+          measureStart = harness_seconds ();
+
+          harness_link_reset_statistics (& link);
+       }
+
+       while (enet_list_size (& peer -> outgoingReliableCommands) < QUEUED_PACKETS)
+       {
+          memcpy (payload, & sent, sizeof (sent));
+          ++ sent;
+
+          HARNESS_CHECK (enet_peer_send (peer, 0, enet_packet_create (payload, sizeof (payload), ENET_PACKET_FLAG_RELIABLE)) == 0);
+       }
+
+       harness_link_service (& link);
+
+       if (ENET_TIME_DIFFERENCE (enet_time_get (), lastService) >= serviceInterval)
+       {
+          lastService = enet_time_get ();
+
+          while (enet_host_service (client, & event, 0) > 0)
+            HARNESS_CHECK (event.type != ENET_EVENT_TYPE_DISCONNECT);
+
+          if (peer -> pacingTimer.scheduled)
+            ++ pacedServices;
+       }
+
+       harness_link_service (& link);
+
+       while (enet_host_service (server, & event, 0) > 0)
+       {
+          HARNESS_CHECK (event.type != ENET_EVENT_TYPE_DISCONNECT);
+
+          if (event.type == ENET_EVENT_TYPE_RECEIVE)
+          {
+             memcpy (& index, event.packet -> data, sizeof (index));
+             HARNESS_CHECK (index == received);
+             ++ received;
+
+             enet_packet_destroy (event.packet);
+          }
+       }
+
+       /* Sleep rather than spin, so that tests running alongside do not hold up the link. */
+       harness_link_wait (& link, 1);
+    }
+
+    rate = link.toServer.deliveredBytes / (harness_seconds () - measureStart);
+
+    printf ("serviced every %2u ms: %.0f bytes per second paced at %u, %u of %u datagrams overflowed the bottleneck\n",
+            serviceInterval, rate, PACING_RATE, (unsigned) link.toServer.overflowed,
+            (unsigned) (link.toServer.queued + link.toServer.overflowed));
+
+    HARNESS_CHECK (pacedServices > 0);
+    HARNESS_CHECK (rate > PACING_RATE * 0.8);
+    HARNESS_CHECK (rate < PACING_RATE * 1.1);
+    HARNESS_CHECK (link.toServer.overflowed == 0);
+
+    harness_link_destroy (& link);
+    enet_host_destroy (client);
+    enet_host_destroy (server);
+}
+
+int
+main (int argc, char ** argv)
+{
+    harness_initialize ();
+
+    check_pacing (0);
+    check_pacing (16);
+
+    return 0;
+}
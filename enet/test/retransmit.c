@@ -0,0 +1,228 @@
+/**
+ @file  retransmit.c
+ @brief Checks that a lost reliable command is resent once later sends are acknowledged, without
+        waiting for its retransmit timeout, and that a late acknowledgement does not resend
+        commands that were not lost
+*/
+#include <string.h>
+#include "harness.h"
+
+#define QUIET_INTERVAL 60000
+#define SHORT_ROUND_TRIP_TIME 1000
+#define LONG_ROUND_TRIP_TIME 1000000
+#define DEADLINE 1000
+
+static ENetHost * server, * client;
+static ENetPeer * peer;
+static int dropToServer, holdFromServer;
+static enet_uint8 heldData [ENET_PROTOCOL_MAXIMUM_MTU];
+static size_t heldLength;
+static enet_uint8 received [16];
+static size_t receivedCount;
+
+static int ENET_CALLBACK
+intercept_server (ENetHost * host, ENetEvent * event)
+{
+    return dropToServer;
+}
+
+/* While holding, keeps the first datagram from the server to deliver late and drops the rest. */
+static int ENET_CALLBACK
+intercept_client (ENetHost * host, ENetEvent * event)
+{
+    if (! holdFromServer)
+      return 0;
+
+    if (heldLength == 0)
+    {
+       memcpy (heldData, host -> receivedData, host -> receivedDataLength);
+       heldLength = host -> receivedDataLength;
+    }
+
+    return 1;
+}
+
+static void
+service_server (void)
+{
+    ENetEvent event;
+
+    while (enet_host_service (server, & event, 0) > 0)
+      if (event.type == ENET_EVENT_TYPE_RECEIVE)
+      {
+         HARNESS_CHECK (receivedCount < sizeof (received));
+         received [receivedCount ++] = event.packet -> data [0];
+
+         enet_packet_destroy (event.packet);
+      }
+}
+
+static void
+service_client (enet_uint32 timeout)
+{
+    ENetEvent event;
+
+    while (enet_host_service (client, & event, timeout) > 0)
+      if (event.type == ENET_EVENT_TYPE_RECEIVE)
+        enet_packet_destroy (event.packet);
+}
+
+/* Sends a one-byte reliable message in a datagram of its own. */
+static ENetOutgoingCommand *
+send_message (enet_uint8 id)
+{
+    HARNESS_CHECK (enet_peer_send (peer, 0, enet_packet_create (& id, 1, ENET_PACKET_FLAG_RELIABLE)) == 0);
+
+    enet_host_flush (client);
+
+    return (ENetOutgoingCommand *) enet_list_back (& peer -> sentReliableCommands);
+}
+
+static void
+settle (void)
+{
+    enet_uint32 start = enet_time_get ();
+
+    do
+    {
+       HARNESS_CHECK (ENET_TIME_DIFFERENCE (enet_time_get (), start) < DEADLINE);
+
+       service_client (1);
+       service_server ();
+    } while (! enet_list_empty (& peer -> sentReliableCommands) || ! enet_list_empty (& peer -> outgoingReliableCommands));
+}
+
+static void
+set_round_trip_time (enet_uint32 roundTripTime)
+{
+    peer -> roundTripTimeMicroseconds = roundTripTime;
+    peer -> roundTripTimeVarianceMicroseconds = 0;
+}
+
+/* A command is lost, then three later sends are acknowledged. The first command must be resent
+   and delivered well within its retransmit timeout. */
+static void
+check_fast_retransmit (void)
+{
+    ENetOutgoingCommand * lost;
+    enet_uint32 sentTime, roundTripTimeout;
+    enet_uint8 id;
+
+    set_round_trip_time (LONG_ROUND_TRIP_TIME);
+    receivedCount = 0;
+
+    dropToServer = 1;
+    lost = send_message (1);
+    service_server ();
+    dropToServer = 0;
+
+    sentTime = lost -> sentTime;
+    roundTripTimeout = lost -> roundTripTimeout;
+    HARNESS_CHECK (roundTripTimeout >= LONG_ROUND_TRIP_TIME / 1000);
+
+    for (id = 2; id <= 1 + ENET_PEER_FAST_RETRANSMIT_THRESHOLD; ++ id)
+    {
+       send_message (id);
+       service_server ();
+       service_client (0);
+    }
+
+    HARNESS_CHECK (peer -> packetsLost == 1);
+
+    while (receivedCount == 0)
+    {
+       HARNESS_CHECK (ENET_TIME_DIFFERENCE (enet_time_get (), sentTime) < roundTripTimeout);
+
+       service_client (1);
+       service_server ();
+    }
+
+    settle ();
+
+    HARNESS_CHECK (receivedCount == 1 + ENET_PEER_FAST_RETRANSMIT_THRESHOLD);
+    for (id = 1; id <= receivedCount; ++ id)
+      HARNESS_CHECK (received [id - 1] == id);
+}
+
+/* A command times out and is resent after three later sends that are lost too. The
+   acknowledgement of its first send then arrives late. It acknowledges the command, but says
+   nothing about sends made after the first, so none of the later ones may be resent. */
+static void
+check_late_acknowledgement (void)
+{
+    ENetOutgoingCommand * delayed;
+    ENetAddress address;
+    ENetBuffer buffer;
+    enet_uint32 start, packetsLost = peer -> packetsLost;
+    enet_uint8 id;
+
+    set_round_trip_time (SHORT_ROUND_TRIP_TIME);
+
+    holdFromServer = 1;
+    delayed = send_message (10);
+    service_server ();
+    service_client (0);
+    HARNESS_CHECK (heldLength > 0);
+
+    set_round_trip_time (LONG_ROUND_TRIP_TIME);
+
+    dropToServer = 1;
+    for (id = 11; id < 11 + ENET_PEER_FAST_RETRANSMIT_THRESHOLD; ++ id)
+      send_message (id);
+
+    start = enet_time_get ();
+    while (delayed -> sendAttempts < 2)
+    {
+       HARNESS_CHECK (ENET_TIME_DIFFERENCE (enet_time_get (), start) < DEADLINE);
+
+       service_client (1);
+    }
+
+    HARNESS_CHECK (peer -> packetsLost == packetsLost + 1);
+
+    dropToServer = 0;
+    holdFromServer = 0;
+
+    address = server -> peers [0].address;
+    buffer.data = heldData;
+    buffer.dataLength = heldLength;
+    HARNESS_CHECK (enet_socket_send (server -> socket, & address, & buffer, 1) == (int) heldLength);
+
+    start = enet_time_get ();
+    while (ENET_TIME_DIFFERENCE (enet_time_get (), start) < 20)
+      service_client (1);
+
+    HARNESS_CHECK (peer -> packetsLost == packetsLost + 1);
+    HARNESS_CHECK (enet_list_size (& peer -> sentReliableCommands) == ENET_PEER_FAST_RETRANSMIT_THRESHOLD);
+    HARNESS_CHECK (enet_list_empty (& peer -> outgoingReliableCommands));
+}
+
+int
+main (int argc, char ** argv)
+{
+    harness_initialize ();
+
+    server = harness_create_server (1, 1);
+    client = enet_host_create (NULL, 1, 1, 0, 0);
+    HARNESS_CHECK (client != NULL);
+    HARNESS_CHECK (harness_connect (client, server, & peer, 1, 1) == 1);
+
+    /* No pings, which are reliable commands too. */
+    enet_peer_ping_interval (peer, QUIET_INTERVAL);
+    enet_peer_ping_interval (& server -> peers [0], QUIET_INTERVAL);
+
+    settle ();
+
+    server -> intercept = intercept_server;
+    client -> intercept = intercept_client;
+    peer -> packetsLost = 0;
+
+    check_fast_retransmit ();
+    check_late_acknowledgement ();
+
+    enet_host_destroy (client);
+    enet_host_destroy (server);
+
+    printf ("lost commands resent before their timeouts, and late acknowledgements resent nothing\n");
+    return 0;
+}
@@ -0,0 +1,188 @@
+/**
+ @file  rtt.c
+ @brief Checks that the round trip time, the retransmit timeout and the throttle follow the
+        latency of a link to below a millisecond, while the public statistics stay in milliseconds
+*/
+#include "link.h"
+
+#define QUIET_INTERVAL 60000
+#define THROTTLE_INTERVAL 10
+#define EXCHANGES 200
+#define RECENT_EXCHANGES 64
+#define DEADLINE 1000
+#define SCHEDULING_SLACK 700
+#define ATTEMPTS 3
+
+static HarnessLink relay;
+static ENetHost * server, * client;
+static ENetPeer * peer;
+
+static void
+service (void)
+{
+    ENetEvent event;
+
+    harness_link_service (& relay);
+
+    while (enet_host_service (client, & event, 0) > 0)
+      HARNESS_CHECK (event.type != ENET_EVENT_TYPE_DISCONNECT);
+
+    harness_link_service (& relay);
+
+    while (enet_host_service (server, & event, 0) > 0)
+    {
+       HARNESS_CHECK (event.type != ENET_EVENT_TYPE_DISCONNECT);
+
+       if (event.type == ENET_EVENT_TYPE_RECEIVE)
+         enet_packet_destroy (event.packet);
+    }
+}
+
+/* Sends a reliable message and services everything until it is acknowledged, storing how long
+   that took in microseconds in roundTrip. Returns the retransmit timeout the message was sent
+   with, in milliseconds. */
+static enet_uint32
+exchange (enet_uint32 * roundTrip)
+{
+    ENetOutgoingCommand * outgoingCommand;
+    enet_uint32 start = enet_time_get (), startMicroseconds = enet_time_get_microseconds (), roundTripTimeout;
+    enet_uint8 data = 'x';
+
+    HARNESS_CHECK (enet_peer_send (peer, 0, enet_packet_create (& data, 1, ENET_PACKET_FLAG_RELIABLE)) == 0);
+    enet_host_flush (client);
+
+    HARNESS_CHECK (! enet_list_empty (& peer -> sentReliableCommands));
+    outgoingCommand = (ENetOutgoingCommand *) enet_list_back (& peer -> sentReliableCommands);
+    roundTripTimeout = outgoingCommand -> roundTripTimeout;
+
+    while (! enet_list_empty (& peer -> sentReliableCommands))
+    {
+       HARNESS_CHECK (ENET_TIME_DIFFERENCE (enet_time_get (), start) < DEADLINE);
+
+       service ();
+    }
+
+    * roundTrip = enet_time_get_microseconds () - startMicroseconds;
+
+    return roundTripTimeout;
+}
+
+/* Sets the one way delay of both directions, in microseconds, and exchanges enough messages
+   for the estimates to settle. Stores the retransmit timeout of the last message in
+   roundTripTimeout and returns the slowest of the last RECENT_EXCHANGES round trips, which
+   make up most of the estimates and span more than one throttle epoch. */
+static enet_uint32
+settle_on (enet_uint32 delay, enet_uint32 * roundTripTimeout)
+{
+    enet_uint32 exchangeIndex, roundTrip, slowestRoundTrip = 0;
+
+    relay.toServer.delay = delay;
+    relay.toClient.delay = delay;
+
+    for (exchangeIndex = 0; exchangeIndex < EXCHANGES; ++ exchangeIndex)
+    {
+       * roundTripTimeout = exchange (& roundTrip);
+
+       if (exchangeIndex >= EXCHANGES - RECENT_EXCHANGES && roundTrip > slowestRoundTrip)
+         slowestRoundTrip = roundTrip;
+    }
+
+    return slowestRoundTrip;
+}
+
+/* The link only keeps its latency while the process has a processor to itself. When the round
+   trips the estimates were made from took well over the link's, they cannot be checked against
+   it, so the exchanges are tried again a few times. Returns 0 if they never ran undisturbed. */
+static int
+settle_undisturbed_on (enet_uint32 delay, enet_uint32 * roundTripTimeout)
+{
+    enet_uint32 attempt, slowestRoundTrip = 0;
+
+    for (attempt = 0; attempt < ATTEMPTS; ++ attempt)
+    {
+       slowestRoundTrip = settle_on (delay, roundTripTimeout);
+       if (slowestRoundTrip < 2 * delay + SCHEDULING_SLACK)
+         return 1;
+    }
+
+    printf ("skipped: round trips over a link of %u us took up to %u us, the process is not getting a processor to itself\n",
+            2 * delay, slowestRoundTrip);
+
+    return 0;
+}
+
+static void
+check_public_statistics (void)
+{
+    HARNESS_CHECK (peer -> roundTripTime == (peer -> roundTripTimeMicroseconds + 500) / 1000);
+    HARNESS_CHECK (peer -> roundTripTimeVariance == (peer -> roundTripTimeVarianceMicroseconds + 500) / 1000);
+    HARNESS_CHECK (peer -> lastRoundTripTime == (peer -> lastRoundTripTimeMicroseconds + 500) / 1000);
+    HARNESS_CHECK (peer -> lowestRoundTripTime == (peer -> lowestRoundTripTimeMicroseconds + 500) / 1000);
+}
+
+int
+main (int argc, char ** argv)
+{
+    enet_uint32 lanTimeout, wanTimeout, lanRoundTripTime, wanRoundTripTime, roundTrip, slowestRoundTrip, packetThrottle;
+
+    harness_initialize ();
+
+    server = harness_create_server (1, 1);
+    client = enet_host_create (NULL, 1, 1, 0, 0);
+    HARNESS_CHECK (client != NULL);
+
+    harness_link_create (& relay, server);
+    peer = harness_link_connect (& relay, client, server, 1);
+    HARNESS_CHECK (peer != NULL);
+
+    /* Only the messages sent here give samples, and the throttle starts a new epoch often. */
+    enet_peer_ping_interval (peer, QUIET_INTERVAL);
+    enet_peer_ping_interval (& server -> peers [0], QUIET_INTERVAL);
+    enet_peer_throttle_configure (peer, THROTTLE_INTERVAL, ENET_PEER_PACKET_THROTTLE_ACCELERATION, ENET_PEER_PACKET_THROTTLE_DECELERATION);
+
+    /* A LAN: 300 microseconds there and back. The timeout is as short as the millisecond timers
+       allow, and the throttle's statistics are below a millisecond rather than rounded to 0. */
+    if (! settle_undisturbed_on (150, & lanTimeout))
+      goto done;
+
+    lanRoundTripTime = peer -> roundTripTimeMicroseconds;
+
+    HARNESS_CHECK (lanRoundTripTime >= 300 && lanRoundTripTime < 1000);
+    HARNESS_CHECK (lanTimeout <= 2);
+    HARNESS_CHECK (peer -> lastRoundTripTimeMicroseconds >= 300 && peer -> lastRoundTripTimeMicroseconds < 1000);
+    check_public_statistics ();
+
+    /* The latency jumps to 5 ms. The throttle backs off from the first sample, which it could not
+       tell from a LAN round trip while those rounded to 0 ms, and the estimates follow. */
+    packetThrottle = peer -> packetThrottle;
+
+    relay.toServer.delay = relay.toClient.delay = 2500;
+    exchange (& roundTrip);
+    HARNESS_CHECK (peer -> packetThrottle < packetThrottle);
+
+    /* Being held up only adds to these round trips, so they are bounded by what was seen. */
+    slowestRoundTrip = settle_on (2500, & wanTimeout);
+    wanRoundTripTime = peer -> roundTripTimeMicroseconds;
+
+    HARNESS_CHECK (wanRoundTripTime >= 5000 && wanRoundTripTime <= slowestRoundTrip);
+    HARNESS_CHECK (wanTimeout * 1000 > wanRoundTripTime && wanTimeout * 1000 <= 2 * slowestRoundTrip);
+    check_public_statistics ();
+
+    /* And back down again. */
+    if (! settle_undisturbed_on (150, & lanTimeout))
+      goto done;
+
+    HARNESS_CHECK (peer -> roundTripTimeMicroseconds < 1000);
+    HARNESS_CHECK (lanTimeout <= 2);
+    check_public_statistics ();
+
+    printf ("round trip time %u us, timeout %u ms on a LAN; %u us, timeout %u ms over 5 ms\n",
+            lanRoundTripTime, lanTimeout, wanRoundTripTime, wanTimeout);
+
+done:
+    harness_link_destroy (& relay);
+    enet_host_destroy (client);
+    enet_host_destroy (server);
+
+    return 0;
+}
@@ -0,0 +1,175 @@
+/**
+ @file  sent.c
+ @brief Checks that acknowledgements find the reliable commands in flight through the sent
+        reliable ring however many are in flight and in whatever order they are acknowledged
+*/
+#include <string.h>
+#include "harness.h"
+
+#define IN_FLIGHT 8000
+#define STEPS 200000
+#define CHECK_INTERVAL 4096
+
+/* Stands in for the reliable windows: the oldest command in flight is acknowledged before the
+   commands in flight span this many sequence numbers, as a sender stalls on its windows. */
+#define MAXIMUM_SPAN 24576
+
+static ENetOutgoingCommand commands [0x10000];
+static enet_uint8 inFlight [0x10000];
+static enet_uint32 nextSequenceNumber = 1, oldestSequenceNumber = 1;
+static enet_uint32 flightList [MAXIMUM_SPAN];
+static size_t flightCount;
+static size_t collisions;
+
+static ENetChannel *
+channel_of (ENetPeer * peer)
+{
+    return & peer -> channels [0];
+}
+
+static void
+send_command (ENetPeer * peer)
+{
+    ENetChannel * channel = channel_of (peer);
+    ENetOutgoingCommand * outgoingCommand = & commands [nextSequenceNumber & 0xFFFF];
+    enet_uint16 ringMask = channel -> sentReliableRingMask;
+    int collided;
+
+    HARNESS_CHECK (! inFlight [nextSequenceNumber & 0xFFFF]);
+
+    memset (outgoingCommand, 0, sizeof (ENetOutgoingCommand));
+    outgoingCommand -> reliableSequenceNumber = (enet_uint16) nextSequenceNumber;
+    outgoingCommand -> command.header.command = ENET_PROTOCOL_COMMAND_SEND_RELIABLE | ENET_PROTOCOL_COMMAND_FLAG_ACKNOWLEDGE;
+    outgoingCommand -> command.header.channelID = 0;
+
+    collided = channel -> sentReliableRing != NULL && channel -> sentReliableRing [outgoingCommand -> reliableSequenceNumber & ringMask] != NULL;
+
+    HARNESS_CHECK (enet_peer_index_sent_reliable_command (peer, outgoingCommand) == 0);
+
+    /* The ring grows exactly when the command's slot is taken. */
+    if (collided)
+    {
+       HARNESS_CHECK (channel -> sentReliableRingMask > ringMask);
+       ++ collisions;
+    }
+    else
+      HARNESS_CHECK (channel -> sentReliableRingMask == ringMask || ringMask == 0);
+
+    inFlight [nextSequenceNumber & 0xFFFF] = 1;
+    flightList [flightCount ++] = nextSequenceNumber;
+    ++ nextSequenceNumber;
+}
+
+/* Acknowledges the command at the given index of the flight list, checking that the lookup
+   finds exactly it and that neither a repeated acknowledgement nor one for a sequence number
+   sharing its slot finds anything. */
+static void
+acknowledge (ENetPeer * peer, size_t index)
+{
+    enet_uint32 sequenceNumber = flightList [index];
+    enet_uint16 ringMask = channel_of (peer) -> sentReliableRingMask;
+    enet_uint32 sharer = sequenceNumber + ringMask + 1;
+
+    if (! inFlight [sharer & 0xFFFF])
+      HARNESS_CHECK (enet_peer_unindex_sent_reliable_command (peer, (enet_uint16) sharer, 0) == NULL);
+
+    HARNESS_CHECK (enet_peer_unindex_sent_reliable_command (peer, (enet_uint16) sequenceNumber, 0) == & commands [sequenceNumber & 0xFFFF]);
+    HARNESS_CHECK (enet_peer_unindex_sent_reliable_command (peer, (enet_uint16) sequenceNumber, 0) == NULL);
+
+    inFlight [sequenceNumber & 0xFFFF] = 0;
+    flightList [index] = flightList [-- flightCount];
+
+    while (oldestSequenceNumber < nextSequenceNumber && ! inFlight [oldestSequenceNumber & 0xFFFF])
+      ++ oldestSequenceNumber;
+}
+
+static void
+acknowledge_oldest (ENetPeer * peer)
+{
+    size_t index;
+
+    for (index = 0; flightList [index] != oldestSequenceNumber; ++ index)
+      ;
+
+    acknowledge (peer, index);
+}
+
+/* Checks that every command in flight is in its own slot of the ring. */
+static void
+check_ring (ENetPeer * peer)
+{
+    ENetChannel * channel = channel_of (peer);
+    size_t index, occupied = 0, slot;
+
+    for (index = 0; index < flightCount; ++ index)
+      HARNESS_CHECK (channel -> sentReliableRing [flightList [index] & channel -> sentReliableRingMask] == & commands [flightList [index] & 0xFFFF]);
+
+    for (slot = 0; slot <= channel -> sentReliableRingMask; ++ slot)
+      if (channel -> sentReliableRing [slot] != NULL)
+        ++ occupied;
+
+    HARNESS_CHECK (occupied == flightCount);
+}
+
+int
+main (int argc, char ** argv)
+{
+    ENetAddress address;
+    ENetHost * host;
+    ENetPeer * peer;
+    size_t step;
+
+    harness_initialize ();
+    harness_seed (argc > 1 ? (enet_uint32) strtoul (argv [1], NULL, 0) : 1);
+
+    host = enet_host_create (NULL, 1, 2, 0, 0);
+    HARNESS_CHECK (host != NULL);
+
+    harness_loopback (& address, 1);
+    peer = enet_host_connect (host, & address, 2, 0);
+    HARNESS_CHECK (peer != NULL);
+
+    /* Fill the flight, acknowledging a few commands on the way. */
+    while (flightCount < IN_FLIGHT)
+    {
+       send_command (peer);
+
+       if (harness_random () % 8 == 0)
+         acknowledge (peer, harness_random () % flightCount);
+    }
+
+    check_ring (peer);
+
+    /* Keep the flight full, acknowledging commands in random order. Those left behind collide
+       with later commands, doubling the ring until every command in flight has its own slot. */
+    for (step = 0; step < STEPS; ++ step)
+    {
+       send_command (peer);
+
+       if (nextSequenceNumber - oldestSequenceNumber >= MAXIMUM_SPAN)
+         acknowledge_oldest (peer);
+       else
+         acknowledge (peer, harness_random () % flightCount);
+
+       if (step % CHECK_INTERVAL == 0)
+         check_ring (peer);
+    }
+
+    check_ring (peer);
+
+    while (flightCount > 0)
+      acknowledge (peer, harness_random () % flightCount);
+
+    check_ring (peer);
+
+    HARNESS_CHECK (collisions > 0);
+
+    printf ("%u commands acknowledged with %u in flight, ring of %u slots after %u collisions\n",
+            (unsigned) (nextSequenceNumber - 1), IN_FLIGHT, (unsigned) channel_of (peer) -> sentReliableRingMask + 1,
+            (unsigned) collisions);
+
+    enet_peer_reset (peer);
+    enet_host_destroy (host);
+
+    return 0;
+}
@@ -0,0 +1,87 @@
+/** 
+ @file  timer.c
+ @brief Checks that the timer wheel expires every timer on time, across long gaps between
+        calls and the wrap of the millisecond clock
+*/
+#include "harness.h"
+
+#define TIMER_COUNT 2000
+#define ROUNDS 20000
+
+static ENetTimer timers [TIMER_COUNT];
+
+/* Picks a delay mostly within the first levels of the wheel, sometimes past its span. */
+static enet_uint32
+random_delay (void)
+{
+    switch (harness_random () % 4)
+    {
+    case 0: return harness_random () % ENET_TIMER_WHEEL_SLOTS;
+    case 1: return harness_random () % (ENET_TIMER_WHEEL_SLOTS * ENET_TIMER_WHEEL_SLOTS);
+    case 2: return harness_random () % 1000000;
+    default: return harness_random () % (ENET_TIMER_WHEEL_SPAN * 2);
+    }
+}
+
+/* Picks how far the clock moves between calls: mostly a little, sometimes a long idle gap. */
+static enet_uint32
+random_step (void)
+{
+    switch (harness_random () % 8)
+    {
+    case 0: return harness_random () % 5000000;
+    case 1: return harness_random () % 100000;
+    default: return harness_random () % 50;
+    }
+}
+
+int
+main (int argc, char ** argv)
+{
+    ENetTimerWheel wheel;
+    ENetTimer * timer;
+    enet_uint32 now = 0xFFF00000;
+    size_t timerIndex, expired = 0;
+    int round;
+
+    harness_seed (argc > 1 ? (enet_uint32) strtoul (argv [1], NULL, 0) : 1);
+
+    enet_timer_wheel_clear (& wheel, now);
+
+    for (timerIndex = 0; timerIndex < TIMER_COUNT; ++ timerIndex)
+    {
+       enet_timer_setup (& timers [timerIndex], 0, NULL);
+       enet_timer_wheel_schedule (& wheel, & timers [timerIndex], now + random_delay ());
+    }
+
+    for (round = 0; round < ROUNDS; ++ round)
+    {
+       now += random_step ();
+
+       while ((timer = enet_timer_wheel_expire (& wheel, now)) != NULL)
+       {
+          /* No timer expires early, and none was left behind by an earlier call. */
+          HARNESS_CHECK (! ENET_TIME_LESS (now, timer -> expiry));
+          HARNESS_CHECK (! timer -> scheduled);
+
+          ++ expired;
+
+          enet_timer_wheel_schedule (& wheel, timer, now + random_delay ());
+       }
+
+       for (timerIndex = 0; timerIndex < TIMER_COUNT; ++ timerIndex)
+         HARNESS_CHECK (! timers [timerIndex].scheduled || ENET_TIME_LESS (now, timers [timerIndex].expiry));
+
+       /* Move or cancel a few timers, as acknowledgements and resets do. */
+       timerIndex = harness_random () % TIMER_COUNT;
+       if (harness_random () % 4 == 0)
+         enet_timer_wheel_cancel (& wheel, & timers [timerIndex]);
+       else
+         enet_timer_wheel_schedule (& wheel, & timers [timerIndex], now + random_delay ());
+
+       HARNESS_CHECK (! ENET_TIME_LESS (enet_timer_wheel_next_expiry (& wheel, now + ENET_TIMER_WHEEL_SPAN), now));
+    }
+
+    printf ("%u timers expired on time over %d rounds\n", (unsigned) expired, round);
+    return 0;
+}
@@ -0,0 +1,208 @@
+/**
+ @file timer.c
+ @brief ENet hierarchical timer wheel functions
+*/
+#define ENET_BUILDING_LIB 1
+#include "enet/enet.h"
+#include "enet/time.h"
+
+/**
+    @defgroup timer ENet timer wheel utility functions
+    @ingroup private
+    @{
+*/
+void
+enet_timer_setup (ENetTimer * timer, int type, void * data)
+{
+   timer -> expiry = 0;
+   timer -> scheduled = 0;
+   timer -> type = type;
+   timer -> data = data;
+}
+
+void
+enet_timer_wheel_clear (ENetTimerWheel * wheel, enet_uint32 time)
+{
+   int level, slot;
+
+   for (level = 0; level < ENET_TIMER_WHEEL_LEVELS; ++ level)
+     for (slot = 0; slot < ENET_TIMER_WHEEL_SLOTS; ++ slot)
+       enet_list_clear (& wheel -> slots [level] [slot]);
+
+   wheel -> time = time;
+   wheel -> timerCount = 0;
+}
+
+static void
+enet_timer_wheel_insert (ENetTimerWheel * wheel, ENetTimer * timer)
+{
+   enet_uint32 expiry = timer -> expiry, delta;
+   int level = 0;
+
+   if (ENET_TIME_LESS (expiry, wheel -> time))
+     expiry = wheel -> time;
+
+   delta = expiry - wheel -> time;
+   if (delta >= ENET_TIMER_WHEEL_SPAN)
+   {
+      /* Park the timer in the last slot it can reach; it is placed again when that slot cascades. */
+      delta = ENET_TIMER_WHEEL_SPAN - 1;
+      expiry = wheel -> time + delta;
+   }
+
+   while (level < ENET_TIMER_WHEEL_LEVELS - 1 &&
+          delta >= ((enet_uint32) 1 << (ENET_TIMER_WHEEL_SLOT_BITS * (level + 1))))
+     ++ level;
+
+   enet_list_insert (enet_list_end (& wheel -> slots [level] [(expiry >> (ENET_TIMER_WHEEL_SLOT_BITS * level)) & (ENET_TIMER_WHEEL_SLOTS - 1)]),
+                     & timer -> timerList);
+}
+
+static void
+enet_timer_wheel_cascade (ENetTimerWheel * wheel, ENetList * slot)
+{
+   ENetList timers;
+
+   if (enet_list_empty (slot))
+     return;
+
+   enet_list_clear (& timers);
+   enet_list_move (enet_list_end (& timers), enet_list_begin (slot), enet_list_previous (enet_list_end (slot)));
+
+   while (! enet_list_empty (& timers))
+     enet_timer_wheel_insert (wheel, (ENetTimer *) enet_list_remove (enet_list_begin (& timers)));
+}
+
+/** Schedules a timer to expire at the given time, rescheduling it if it was already pending.
+    Timers whose time has already passed expire on the next call to enet_timer_wheel_expire().
+*/
+void
+enet_timer_wheel_schedule (ENetTimerWheel * wheel, ENetTimer * timer, enet_uint32 expiry)
+{
+   if (timer -> scheduled)
+     enet_list_remove (& timer -> timerList);
+   else
+   {
+      timer -> scheduled = 1;
+
+      ++ wheel -> timerCount;
+   }
+
+   timer -> expiry = expiry;
+
+   enet_timer_wheel_insert (wheel, timer);
+}
+
+void
+enet_timer_wheel_cancel (ENetTimerWheel * wheel, ENetTimer * timer)
+{
+   if (! timer -> scheduled)
+     return;
+
+   enet_list_remove (& timer -> timerList);
+
+   timer -> scheduled = 0;
+
+   -- wheel -> timerCount;
+}
+
+/** Advances the wheel up to the given time and removes the next timer that has expired.
+    @returns the expired timer, or NULL once no more timers are due
+*/
+ENetTimer *
+enet_timer_wheel_expire (ENetTimerWheel * wheel, enet_uint32 time)
+{
+   if (wheel -> timerCount == 0)
+   {
+      if (ENET_TIME_LESS (wheel -> time, time))
+        wheel -> time = time;
+
+      return NULL;
+   }
+
+   for (;;)
+   {
+      ENetList * slot = & wheel -> slots [0] [wheel -> time & (ENET_TIMER_WHEEL_SLOTS - 1)];
+      int level;
+
+      if (! enet_list_empty (slot))
+      {
+         ENetTimer * timer = (ENetTimer *) enet_list_remove (enet_list_begin (slot));
+
+         timer -> scheduled = 0;
+
+         -- wheel -> timerCount;
+
+         return timer;
+      }
+
+      if (! ENET_TIME_LESS (wheel -> time, time))
+        return NULL;
+
+      /* Skip the empty ticks before the next timer or cascade, so a long gap between calls
+         costs one scan of the wheel rather than a step per millisecond. */
+      if (ENET_TIME_LESS (wheel -> time + 1, time))
+      {
+         enet_uint32 next = enet_timer_wheel_next_expiry (wheel, time);
+
+         if (ENET_TIME_LESS (wheel -> time + 1, next))
+           wheel -> time = next - 1;
+      }
+
+      ++ wheel -> time;
+
+      for (level = 1; level < ENET_TIMER_WHEEL_LEVELS; ++ level)
+      {
+         if (wheel -> time & (((enet_uint32) 1 << (ENET_TIMER_WHEEL_SLOT_BITS * level)) - 1))
+           break;
+
+         enet_timer_wheel_cascade (wheel, & wheel -> slots [level] [(wheel -> time >> (ENET_TIMER_WHEEL_SLOT_BITS * level)) & (ENET_TIMER_WHEEL_SLOTS - 1)]);
+      }
+   }
+}
+
+/** Returns a time no later than the earliest pending timer, or the given limit if that is earlier.
+    Timers above level 0 are reported at the time their slot cascades.
+*/
+enet_uint32
+enet_timer_wheel_next_expiry (ENetTimerWheel * wheel, enet_uint32 limit)
+{
+   enet_uint32 expiry = limit;
+   int level, slot;
+
+   if (wheel -> timerCount == 0)
+     return limit;
+
+   for (slot = 0; slot < ENET_TIMER_WHEEL_SLOTS; ++ slot)
+   {
+      if (! enet_list_empty (& wheel -> slots [0] [(wheel -> time + slot) & (ENET_TIMER_WHEEL_SLOTS - 1)]))
+      {
+         if (ENET_TIME_LESS (wheel -> time + slot, expiry))
+           expiry = wheel -> time + slot;
+
+         break;
+      }
+   }
+
+   for (level = 1; level < ENET_TIMER_WHEEL_LEVELS; ++ level)
+   {
+      int shift = ENET_TIMER_WHEEL_SLOT_BITS * level;
+
+      for (slot = 1; slot <= ENET_TIMER_WHEEL_SLOTS; ++ slot)
+      {
+         enet_uint32 block = (wheel -> time >> shift) + slot;
+
+         if (! enet_list_empty (& wheel -> slots [level] [block & (ENET_TIMER_WHEEL_SLOTS - 1)]))
+         {
+            if (ENET_TIME_LESS (block << shift, expiry))
+              expiry = block << shift;
+
+            break;
+         }
+      }
+   }
+
+   return expiry;
+}
+
+/** @} */
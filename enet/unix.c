@@ -4,6 +4,10 @@
 */
 #ifndef _WIN32
 
+#if (defined(HAS_RECVMMSG) || defined(HAS_SENDMMSG)) && !defined(_GNU_SOURCE)
+#define _GNU_SOURCE
+#endif
+
 #include <sys/types.h>
 #include <sys/socket.h>
 #include <sys/ioctl.h>
@@ -56,6 +60,25 @@ typedef int socklen_t;
 #define MSG_NOSIGNAL 0
 #endif
 
+#ifdef __linux__
+#include <netinet/udp.h>
+#ifndef SOL_UDP
+#define SOL_UDP 17
+#endif
+#ifndef UDP_SEGMENT
+#define UDP_SEGMENT 103
+#endif
+#ifndef UDP_GRO
+#define UDP_GRO 104
+#endif
+#endif
+
+typedef union _ENetSocketControl
+{
+    struct cmsghdr header;
+    char data [CMSG_SPACE (sizeof (int))];
+} ENetSocketControl;
+
 static enet_uint32 timeBase = 0;
 
 int
@@ -75,24 +98,56 @@ enet_host_random_seed (void)
     return (enet_uint32) time (NULL);
 }
 
-enet_uint32
-enet_time_get (void)
+/* Reads the monotonic clock where there is one, so that the time does not jump when the
+   system clock is set. */
+static void
+enet_time_read (enet_uint32 * seconds, enet_uint32 * microseconds)
 {
+#ifdef CLOCK_MONOTONIC
+    struct timespec timeSpec;
+
+    clock_gettime (CLOCK_MONOTONIC, & timeSpec);
+
+    * seconds = (enet_uint32) timeSpec.tv_sec;
+    * microseconds = (enet_uint32) timeSpec.tv_nsec / 1000;
+#else
     struct timeval timeVal;
 
     gettimeofday (& timeVal, NULL);
 
-    return timeVal.tv_sec * 1000 + timeVal.tv_usec / 1000 - timeBase;
+    * seconds = (enet_uint32) timeVal.tv_sec;
+    * microseconds = (enet_uint32) timeVal.tv_usec;
+#endif
+}
+
+enet_uint32
+enet_time_get (void)
+{
+    enet_uint32 seconds, microseconds;
+
+    enet_time_read (& seconds, & microseconds);
+
+    return seconds * 1000 + microseconds / 1000 - timeBase;
 }
 
 void
 enet_time_set (enet_uint32 newTimeBase)
 {
-    struct timeval timeVal;
+    enet_uint32 seconds, microseconds;
 
-    gettimeofday (& timeVal, NULL);
+    enet_time_read (& seconds, & microseconds);
     
-    timeBase = timeVal.tv_sec * 1000 + timeVal.tv_usec / 1000 - newTimeBase;
+    timeBase = seconds * 1000 + microseconds / 1000 - newTimeBase;
+}
+
+enet_uint32
+enet_time_get_microseconds (void)
+{
+    enet_uint32 seconds, microseconds;
+
+    enet_time_read (& seconds, & microseconds);
+
+    return seconds * 1000000 + microseconds;
 }
 
 int
@@ -266,6 +321,26 @@ enet_socket_set_option (ENetSocket socket, ENetSocketOption option, int value)
             result = setsockopt (socket, IPPROTO_TCP, TCP_NODELAY, (char *) & value, sizeof (int));
             break;
 
+#ifdef UDP_GRO
+        case ENET_SOCKOPT_UDP_GRO:
+            result = setsockopt (socket, SOL_UDP, UDP_GRO, (char *) & value, sizeof (int));
+            break;
+#endif
+
+        case ENET_SOCKOPT_MULTICAST_TTL:
+        {
+            unsigned char ttl = (unsigned char) value;
+            result = setsockopt (socket, IPPROTO_IP, IP_MULTICAST_TTL, (char *) & ttl, sizeof (ttl));
+            break;
+        }
+
+        case ENET_SOCKOPT_MULTICAST_LOOP:
+        {
+            unsigned char loop = value ? 1 : 0;
+            result = setsockopt (socket, IPPROTO_IP, IP_MULTICAST_LOOP, (char *) & loop, sizeof (loop));
+            break;
+        }
+
         default:
             break;
     }
@@ -332,6 +407,40 @@ enet_socket_accept (ENetSocket socket, ENetAddress * address)
     return result;
 } 
     
+static int
+enet_socket_set_multicast_membership (ENetSocket socket, const ENetAddress * group, int option)
+{
+    struct ip_mreq request;
+
+    memset (& request, 0, sizeof (struct ip_mreq));
+    request.imr_multiaddr.s_addr = group -> host;
+    request.imr_interface.s_addr = INADDR_ANY;
+
+    return setsockopt (socket, IPPROTO_IP, option, (char *) & request, sizeof (struct ip_mreq)) == -1 ? -1 : 0;
+}
+
+/** Makes the socket receive datagrams sent to a multicast group, on the default interface.
+    @param socket socket to join the group with
+    @param group address of the group; its port is ignored
+    @returns 0 on success, -1 on failure
+*/
+int
+enet_socket_join_multicast (ENetSocket socket, const ENetAddress * group)
+{
+    return enet_socket_set_multicast_membership (socket, group, IP_ADD_MEMBERSHIP);
+}
+
+/** Stops the socket receiving datagrams sent to a multicast group it joined with enet_socket_join_multicast().
+    @param socket socket to leave the group with
+    @param group address of the group; its port is ignored
+    @returns 0 on success, -1 on failure
+*/
+int
+enet_socket_leave_multicast (ENetSocket socket, const ENetAddress * group)
+{
+    return enet_socket_set_multicast_membership (socket, group, IP_DROP_MEMBERSHIP);
+}
+
 int
 enet_socket_shutdown (ENetSocket socket, ENetSocketShutdown how)
 {
@@ -430,6 +539,269 @@ enet_socket_receive (ENetSocket socket,
     return recvLength;
 }
 
+static void
+enet_socket_setup_send_message (struct msghdr * msgHdr, struct sockaddr_in * sin, ENetSocketControl * control, const ENetDatagram * datagram)
+{
+    memset (msgHdr, 0, sizeof (struct msghdr));
+    memset (sin, 0, sizeof (struct sockaddr_in));
+
+    sin -> sin_family = AF_INET;
+    sin -> sin_port = ENET_HOST_TO_NET_16 (datagram -> address.port);
+    sin -> sin_addr.s_addr = datagram -> address.host;
+
+    msgHdr -> msg_name = sin;
+    msgHdr -> msg_namelen = sizeof (struct sockaddr_in);
+    msgHdr -> msg_iov = (struct iovec *) datagram -> buffers;
+    msgHdr -> msg_iovlen = datagram -> bufferCount;
+
+#ifdef UDP_SEGMENT
+    if (datagram -> segmentSize > 0)
+    {
+        struct cmsghdr * cmsg;
+        enet_uint16 segmentSize = (enet_uint16) datagram -> segmentSize;
+
+        memset (control, 0, sizeof (ENetSocketControl));
+
+        msgHdr -> msg_control = control -> data;
+        msgHdr -> msg_controllen = CMSG_SPACE (sizeof (enet_uint16));
+
+        cmsg = CMSG_FIRSTHDR (msgHdr);
+        cmsg -> cmsg_level = SOL_UDP;
+        cmsg -> cmsg_type = UDP_SEGMENT;
+        cmsg -> cmsg_len = CMSG_LEN (sizeof (enet_uint16));
+        memcpy (CMSG_DATA (cmsg), & segmentSize, sizeof (enet_uint16));
+    }
+#else
+    (void) control;
+#endif
+}
+
+static void
+enet_socket_setup_receive_message (struct msghdr * msgHdr, struct sockaddr_in * sin, ENetSocketControl * control, const ENetDatagram * datagram)
+{
+    memset (msgHdr, 0, sizeof (struct msghdr));
+
+    msgHdr -> msg_name = sin;
+    msgHdr -> msg_namelen = sizeof (struct sockaddr_in);
+    msgHdr -> msg_iov = (struct iovec *) datagram -> buffers;
+    msgHdr -> msg_iovlen = datagram -> bufferCount;
+
+#ifdef UDP_GRO
+    msgHdr -> msg_control = control -> data;
+    msgHdr -> msg_controllen = sizeof (control -> data);
+#else
+    (void) control;
+#endif
+}
+
+static int
+enet_socket_finish_receive_message (struct msghdr * msgHdr, const struct sockaddr_in * sin, ENetDatagram * datagram, size_t recvLength)
+{
+#ifdef UDP_GRO
+    struct cmsghdr * cmsg;
+#endif
+
+#ifdef HAS_MSGHDR_FLAGS
+    if (msgHdr -> msg_flags & MSG_TRUNC)
+      return -1;
+#endif
+
+    datagram -> address.host = (enet_uint32) sin -> sin_addr.s_addr;
+    datagram -> address.port = ENET_NET_TO_HOST_16 (sin -> sin_port);
+    datagram -> dataLength = recvLength;
+    datagram -> segmentSize = 0;
+
+#ifdef UDP_GRO
+    for (cmsg = CMSG_FIRSTHDR (msgHdr); cmsg != NULL; cmsg = CMSG_NXTHDR (msgHdr, cmsg))
+    {
+        if (cmsg -> cmsg_level == SOL_UDP && cmsg -> cmsg_type == UDP_GRO)
+        {
+            int segmentSize;
+
+            memcpy (& segmentSize, CMSG_DATA (cmsg), sizeof (int));
+
+            if (segmentSize > 0 && (size_t) segmentSize < recvLength)
+              datagram -> segmentSize = segmentSize;
+        }
+    }
+#endif
+
+    return 0;
+}
+
+/* Errors that only concern the datagram being sent, such as a full send buffer or a destination
+   that cannot be reached, rather than the socket. Unlike enet_socket_send, which reports all but
+   a full send buffer as failures, a batch drops only such a datagram and still sends the rest, so
+   one unreachable peer does not make the host's service call fail for all the others. */
+static int
+enet_socket_send_error_is_per_datagram (int error)
+{
+    switch (error)
+    {
+    case EWOULDBLOCK:
+#if defined(EAGAIN) && EAGAIN != EWOULDBLOCK
+    case EAGAIN:
+#endif
+    case EHOSTUNREACH:
+    case ENETUNREACH:
+    case EACCES:
+    case EPERM:
+       return 1;
+
+    default:
+       return 0;
+    }
+}
+
+int
+enet_socket_send_batch (ENetSocket socket,
+                        ENetDatagram * datagrams,
+                        size_t datagramCount,
+                        enet_uint32 * sendCalls)
+{
+#ifdef HAS_SENDMMSG
+    struct mmsghdr msgHdrs [ENET_HOST_SEND_BATCH_SIZE];
+    struct sockaddr_in sins [ENET_HOST_SEND_BATCH_SIZE];
+    ENetSocketControl controls [ENET_HOST_SEND_BATCH_SIZE];
+    int sentCount = 0, i;
+
+    if (datagramCount > ENET_HOST_SEND_BATCH_SIZE)
+      datagramCount = ENET_HOST_SEND_BATCH_SIZE;
+
+    for (i = 0; i < (int) datagramCount; ++ i)
+    {
+        enet_socket_setup_send_message (& msgHdrs [i].msg_hdr, & sins [i], & controls [i], & datagrams [i]);
+        msgHdrs [i].msg_len = 0;
+
+        datagrams [i].dataLength = 0;
+    }
+
+    while (sentCount < (int) datagramCount)
+    {
+        int result = sendmmsg (socket, & msgHdrs [sentCount], datagramCount - sentCount, MSG_NOSIGNAL);
+
+        if (sendCalls != NULL)
+          ++ * sendCalls;
+
+        if (result == -1)
+        {
+           /* sendmmsg only fails on the first datagram it is given; drop just that one and send the rest. */
+           if (! enet_socket_send_error_is_per_datagram (errno))
+             return -1;
+
+           ++ sentCount;
+           continue;
+        }
+
+        for (i = sentCount; i < sentCount + result; ++ i)
+          datagrams [i].dataLength = msgHdrs [i].msg_len;
+
+        sentCount += result;
+    }
+
+    return (int) datagramCount;
+#else
+    struct msghdr msgHdr;
+    struct sockaddr_in sin;
+    ENetSocketControl control;
+    size_t i;
+
+    for (i = 0; i < datagramCount; ++ i)
+      datagrams [i].dataLength = 0;
+
+    for (i = 0; i < datagramCount; ++ i)
+    {
+        int sentLength;
+
+        enet_socket_setup_send_message (& msgHdr, & sin, & control, & datagrams [i]);
+
+        sentLength = sendmsg (socket, & msgHdr, MSG_NOSIGNAL);
+
+        if (sendCalls != NULL)
+          ++ * sendCalls;
+
+        if (sentLength == -1)
+        {
+           if (! enet_socket_send_error_is_per_datagram (errno))
+             return -1;
+
+           sentLength = 0;
+        }
+
+        datagrams [i].dataLength = sentLength;
+    }
+
+    return (int) datagramCount;
+#endif
+}
+
+int
+enet_socket_receive_batch (ENetSocket socket,
+                           ENetDatagram * datagrams,
+                           size_t datagramCount)
+{
+#ifdef HAS_RECVMMSG
+    struct mmsghdr msgHdrs [ENET_HOST_RECEIVE_BATCH_SIZE];
+    struct sockaddr_in sins [ENET_HOST_RECEIVE_BATCH_SIZE];
+    ENetSocketControl controls [ENET_HOST_RECEIVE_BATCH_SIZE];
+    int recvCount, i;
+
+    if (datagramCount > ENET_HOST_RECEIVE_BATCH_SIZE)
+      datagramCount = ENET_HOST_RECEIVE_BATCH_SIZE;
+
+    for (i = 0; i < (int) datagramCount; ++ i)
+    {
+        enet_socket_setup_receive_message (& msgHdrs [i].msg_hdr, & sins [i], & controls [i], & datagrams [i]);
+        msgHdrs [i].msg_len = 0;
+    }
+
+    recvCount = recvmmsg (socket, msgHdrs, datagramCount, MSG_NOSIGNAL, NULL);
+
+    if (recvCount == -1)
+    {
+       if (errno == EWOULDBLOCK)
+         return 0;
+
+       return -1;
+    }
+
+    for (i = 0; i < recvCount; ++ i)
+    {
+        /* A truncated datagram is an error as with enet_socket_receive, but
+           only once the datagrams that precede it have been delivered. */
+        if (enet_socket_finish_receive_message (& msgHdrs [i].msg_hdr, & sins [i], & datagrams [i], msgHdrs [i].msg_len) < 0)
+          return i > 0 ? i : -1;
+    }
+
+    return recvCount;
+#else
+    struct msghdr msgHdr;
+    struct sockaddr_in sin;
+    ENetSocketControl control;
+    int recvLength;
+
+    if (datagramCount <= 0)
+      return 0;
+
+    enet_socket_setup_receive_message (& msgHdr, & sin, & control, datagrams);
+
+    recvLength = recvmsg (socket, & msgHdr, MSG_NOSIGNAL);
+
+    if (recvLength == -1)
+    {
+       if (errno == EWOULDBLOCK)
+         return 0;
+
+       return -1;
+    }
+
+    if (enet_socket_finish_receive_message (& msgHdr, & sin, datagrams, recvLength) < 0)
+      return -1;
+
+    return 1;
+#endif
+}
+
 int
 enet_socketset_select (ENetSocket maxSocket, ENetSocketSet * readSet, ENetSocketSet * writeSet, enet_uint32 timeout)
 {
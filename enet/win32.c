@@ -10,6 +10,7 @@
 #include <Ws2tcpip.h>
 
 static enet_uint32 timeBase = 0;
+static LARGE_INTEGER performanceFrequency;
 
 int
 enet_initialize (void)
@@ -30,6 +31,8 @@ enet_initialize (void)
 
     timeBeginPeriod (1);
 
+    QueryPerformanceFrequency (& performanceFrequency);
+
     return 0;
 }
 
@@ -59,6 +62,17 @@ enet_time_set (enet_uint32 newTimeBase)
     timeBase = (enet_uint32) timeGetTime () - newTimeBase;
 }
 
+enet_uint32
+enet_time_get_microseconds (void)
+{
+    LARGE_INTEGER counter;
+
+    QueryPerformanceCounter (& counter);
+
+    return (enet_uint32) ((counter.QuadPart / performanceFrequency.QuadPart) * 1000000 +
+                          (counter.QuadPart % performanceFrequency.QuadPart) * 1000000 / performanceFrequency.QuadPart);
+}
+
 int
 enet_address_set_host (ENetAddress * address, const char * name)
 {
@@ -211,6 +225,14 @@ enet_socket_set_option (ENetSocket socket, ENetSocketOption option, int value)
             result = setsockopt (socket, IPPROTO_TCP, TCP_NODELAY, (char *) & value, sizeof (int));
             break;
 
+        case ENET_SOCKOPT_MULTICAST_TTL:
+            result = setsockopt (socket, IPPROTO_IP, IP_MULTICAST_TTL, (char *) & value, sizeof (int));
+            break;
+
+        case ENET_SOCKOPT_MULTICAST_LOOP:
+            result = setsockopt (socket, IPPROTO_IP, IP_MULTICAST_LOOP, (char *) & value, sizeof (int));
+            break;
+
         default:
             break;
     }
@@ -277,6 +299,40 @@ enet_socket_accept (ENetSocket socket, ENetAddress * address)
     return result;
 }
 
+static int
+enet_socket_set_multicast_membership (ENetSocket socket, const ENetAddress * group, int option)
+{
+    struct ip_mreq request;
+
+    memset (& request, 0, sizeof (struct ip_mreq));
+    request.imr_multiaddr.s_addr = group -> host;
+    request.imr_interface.s_addr = INADDR_ANY;
+
+    return setsockopt (socket, IPPROTO_IP, option, (char *) & request, sizeof (struct ip_mreq)) == SOCKET_ERROR ? -1 : 0;
+}
+
+/** Makes the socket receive datagrams sent to a multicast group, on the default interface.
+    @param socket socket to join the group with
+    @param group address of the group; its port is ignored
+    @returns 0 on success, -1 on failure
+*/
+int
+enet_socket_join_multicast (ENetSocket socket, const ENetAddress * group)
+{
+    return enet_socket_set_multicast_membership (socket, group, IP_ADD_MEMBERSHIP);
+}
+
+/** Stops the socket receiving datagrams sent to a multicast group it joined with enet_socket_join_multicast().
+    @param socket socket to leave the group with
+    @param group address of the group; its port is ignored
+    @returns 0 on success, -1 on failure
+*/
+int
+enet_socket_leave_multicast (ENetSocket socket, const ENetAddress * group)
+{
+    return enet_socket_set_multicast_membership (socket, group, IP_DROP_MEMBERSHIP);
+}
+
 int
 enet_socket_shutdown (ENetSocket socket, ENetSocketShutdown how)
 {
@@ -371,6 +427,65 @@ enet_socket_receive (ENetSocket socket,
     return (int) recvLength;
 }
 
+int
+enet_socket_send_batch (ENetSocket socket,
+                        ENetDatagram * datagrams,
+                        size_t datagramCount,
+                        enet_uint32 * sendCalls)
+{
+    size_t i;
+
+    for (i = 0; i < datagramCount; ++ i)
+      datagrams [i].dataLength = 0;
+
+    for (i = 0; i < datagramCount; ++ i)
+    {
+        int sentLength = enet_socket_send (socket, & datagrams [i].address, datagrams [i].buffers, datagrams [i].bufferCount);
+
+        if (sendCalls != NULL)
+          ++ * sendCalls;
+        if (sentLength < 0)
+        {
+           /* A destination that cannot be reached only loses its own datagram. */
+           switch (WSAGetLastError ())
+           {
+           case WSAEHOSTUNREACH:
+           case WSAENETUNREACH:
+           case WSAEACCES:
+              sentLength = 0;
+              break;
+
+           default:
+              return -1;
+           }
+        }
+
+        datagrams [i].dataLength = sentLength;
+    }
+
+    return (int) datagramCount;
+}
+
+int
+enet_socket_receive_batch (ENetSocket socket,
+                           ENetDatagram * datagrams,
+                           size_t datagramCount)
+{
+    int recvLength;
+
+    if (datagramCount <= 0)
+      return 0;
+
+    recvLength = enet_socket_receive (socket, & datagrams -> address, datagrams -> buffers, datagrams -> bufferCount);
+    if (recvLength <= 0)
+      return recvLength;
+
+    datagrams -> dataLength = recvLength;
+    datagrams -> segmentSize = 0;
+
+    return 1;
+}
+
 int
 enet_socketset_select (ENetSocket maxSocket, ENetSocketSet * readSet, ENetSocketSet * writeSet, enet_uint32 timeout)
 {
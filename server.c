@@ -1,44 +1,112 @@
+#include <stdarg.h>
 #include <stdbool.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <signal.h>
+#include <time.h>
 
 #include <enet/enet.h>
+#include <enet/time.h>
 #include "common.h"
 
 
 // Simple LAN chat server
 // Clients can send simple string messages to the server, which simply
-// gets broadcast to all connected clients.
+// gets broadcast to all clients in the same room.
+// Clients start in the lobby and can move with "/join <room>".
+// Lines for a room are held for a short window and sent together as one
+// packet of null-terminated strings; the window in milliseconds can be
+// given as the first argument (default 0, i.e. once per loop iteration).
 
 
 #ifdef _WINDOWS
 #include <windows.h>
 #else
+#include <errno.h>
 #include <unistd.h>
-#define Sleep(x) usleep((x)*1000)
+#endif
+#ifdef __linux__
+#include <sys/epoll.h>
 #endif
 volatile sig_atomic_t stop = 0;
+// Set by SIGHUP to rebuild the scan reply straight away
+volatile sig_atomic_t refresh_info = 0;
 void sigint_handle(int signum);
+void sighup_handle(int signum);
+#define MAX_CLIENTS 16
+#define MAX_ROOMS 16
+#define ROOM_NAME_SIZE 32
+#define LOBBY "lobby"
+// Held lines are sent once they would outgrow this, which keeps the packet
+// within a single datagram
+#define COALESCE_SIZE 1024
+// Scans answered per loop iteration, so a flood of them cannot hold up chat
+#define MAX_SCANS_PER_LOOP 64
+typedef struct
+{
+	char name[ROOM_NAME_SIZE];
+	// Messages are only sent to the members of a room
+	ENetGroup *group;
+	// Lines waiting to be sent together, written straight into the packet
+	ENetPacket *pending;
+	size_t pendingLength;
+} Room;
 typedef struct
 {
 	// The chat server host
 	ENetHost *host;
 	// The socket for listening and responding to client scans
 	ENetSocket listen;
+#ifdef __linux__
+	// Waits on both the listen socket and the host socket
+	int epoll;
+#endif
+	// Rooms are created when first joined and freed once their last client
+	// leaves, except the lobby; a freed room has no group and its slot is
+	// reused by the next new room
+	Room rooms[MAX_ROOMS];
+	int roomCount;
+	// How long lines are held before being sent, in milliseconds
+	enet_uint32 coalesceWindow;
+	// Whether any room has lines held, and when they must be sent
+	bool pending;
+	enet_uint32 flushTime;
+	// The reply to scans, built at startup and on SIGHUP only, since looking
+	// up our hostname can block the event loop
+	ServerInfo info;
+	// The reply as sent, updated whenever the number of clients changes
+	enet_uint8 reply[SERVER_INFO_MAX_SIZE];
+	size_t replyLength;
 } ENetLANServer;
+void random_secret(enet_uint8 *secret, size_t size);
 bool start_server(ENetLANServer *server);
+enet_uint32 next_service_timeout(ENetLANServer *server);
+void wait_for_events(ENetLANServer *server, enet_uint32 timeout);
+void update_server_info(ENetLANServer *server);
+void encode_server_info(ENetLANServer *server);
 void listen_for_clients(ENetLANServer *server);
-void send_string(ENetHost *host, char *s);
+void handle_event(ENetLANServer *server, ENetEvent *event);
+bool join_room(ENetLANServer *server, ENetPeer *peer, const char *name);
+void leave_room(ENetPeer *peer);
+void handle_command(ENetLANServer *server, ENetPeer *peer, ENetPacket *packet);
+void queue_line(ENetLANServer *server, Room *room, const char *fmt, ...);
+void flush_room(Room *room);
+void flush_rooms(ENetLANServer *server);
+void send_string(ENetLANServer *server, char *s);
+void send_string_to_peer(ENetPeer *peer, char *s);
+void send_message(ENetLANServer *server, ENetPeer *peer, ENetPacket *message);
 void stop_server(ENetLANServer *server);
-#define MAX_CLIENTS 16
 
 
 int main(int argc, char *argv[])
 {
-	(void)argc;
-	(void)argv;
 	// Stop server on interrupt
 	signal(SIGINT, sigint_handle);
+#ifdef SIGHUP
+	// Rebuild the scan reply on hangup, e.g. after the hostname changes
+	signal(SIGHUP, sighup_handle);
+#endif
 
 	// Start server
 	ENetLANServer server;
@@ -46,49 +114,37 @@ int main(int argc, char *argv[])
 	{
 		return 1;
 	}
+	server.coalesceWindow = argc > 1 ? (enet_uint32)atoi(argv[1]) : 0;
 
 	// Loop and process events
 	int check;
 	do
 	{
+		// Sleep until a socket has traffic, ENet next needs servicing
+		// or held lines are due
+		wait_for_events(&server, next_service_timeout(&server));
+
 		// Check our listening socket for scanning clients
 		listen_for_clients(&server);
 
+		// Handle every event that is ready before waiting again
 		ENetEvent event;
-		check = enet_host_service(server.host, &event, 0);
-		if (check > 0)
+		while ((check = enet_host_service(server.host, &event, 0)) > 0)
 		{
-			// Whenever a client connects or disconnects, broadcast a message
-			// Whenever a client says something, broadcast it including
-			// which client it was from
-			char buf[256];
-			switch (event.type)
-			{
-				case ENET_EVENT_TYPE_CONNECT:
-					sprintf(buf, "New client connected: id %d", event.peer->incomingPeerID);
-					send_string(server.host, buf);
-					printf("%s\n", buf);
-					break;
-				case ENET_EVENT_TYPE_RECEIVE:
-					sprintf(buf, "Client %d says: %s", event.peer->incomingPeerID, event.packet->data);
-					send_string(server.host, buf);
-					printf("%s\n", buf);
-					break;
-				case ENET_EVENT_TYPE_DISCONNECT:
-					sprintf(buf, "Client %d disconnected", event.peer->incomingPeerID);
-					send_string(server.host, buf);
-					printf("%s\n", buf);
-					break;
-				default:
-					break;
-			}
+			handle_event(&server, &event);
 		}
-		else if (check < 0)
+		if (check < 0)
 		{
 			fprintf(stderr, "Error servicing host\n");
 		}
-		// Sleep a bit so we don't consume 100% CPU
-		Sleep(1);
+
+		// Send the lines held from these events once the window has passed
+		if (server.pending &&
+			ENET_TIME_LESS_EQUAL(server.flushTime, enet_time_get()))
+		{
+			flush_rooms(&server);
+			enet_host_flush(server.host);
+		}
 	} while (!stop && check >= 0);
 
 	// Shut down server
@@ -104,8 +160,40 @@ void sigint_handle(int signum)
 	}
 }
 
+void sighup_handle(int signum)
+{
+	(void)signum;
+	refresh_info = 1;
+}
+
+// Fill secret with random bytes, from the system's random source if there is
+// one; otherwise fall back to the C library, which is only hard to guess
+void random_secret(enet_uint8 *secret, size_t size)
+{
+	FILE *f = fopen("/dev/urandom", "rb");
+	if (f != NULL)
+	{
+		const size_t read = fread(secret, 1, size, f);
+		fclose(f);
+		if (read == size)
+		{
+			return;
+		}
+	}
+	srand((unsigned)time(NULL) ^ (unsigned)enet_time_get() ^
+		(unsigned)(size_t)secret);
+	for (size_t i = 0; i < size; i++)
+	{
+		secret[i] = (enet_uint8)(rand() >> 4);
+	}
+}
+
 bool start_server(ENetLANServer *server)
 {
+	server->roomCount = 0;
+	server->coalesceWindow = 0;
+	server->pending = false;
+
 	// Start server
 	if (enet_initialize() != 0)
 	{
@@ -139,6 +227,14 @@ bool start_server(ENetLANServer *server)
 		return false;
 	}
 	printf("Listening for scans on port %d\n", listenaddr.port);
+	// Also hear scans sent to the discovery group; broadcast scans
+	// still work if the network has no multicast
+	ENetAddress group;
+	if (enet_address_set_host(&group, DISCOVERY_GROUP) != 0 ||
+		enet_socket_join_multicast(server->listen, &group) != 0)
+	{
+		fprintf(stderr, "Failed to join discovery group %s\n", DISCOVERY_GROUP);
+	}
 
 	ENetAddress addr;
 	addr.host = ENET_HOST_ANY;
@@ -151,19 +247,125 @@ bool start_server(ENetLANServer *server)
 	}
 	printf("ENet host started on port %d (press ctrl-C to exit)\n",
 		server->host->address.port);
+	update_server_info(server);
+
+	// Every chat message is relayed to all clients, so keep enough commands
+	// around for a burst to each of them without going through malloc
+	if (enet_host_reserve_commands(server->host, MAX_CLIENTS * 64) != 0)
+	{
+		fprintf(stderr, "Failed to reserve ENet commands\n");
+		return false;
+	}
+
+	// Chat messages are only read once before being relayed, so there is
+	// no need for ENet to copy them out of the datagrams they arrived in
+	if (enet_host_zero_copy_receive(server->host, 1) != 0)
+	{
+		fprintf(stderr, "Failed to enable zero-copy receive\n");
+		return false;
+	}
+
+	// Only give a client a slot once it has shown it receives at its
+	// address, so a flood of spoofed connects cannot fill up the server
+	enet_uint8 secret[ENET_HOST_COOKIE_SECRET_SIZE];
+	random_secret(secret, sizeof secret);
+	enet_host_connect_cookies(server->host, secret);
+
+	// Scans are drained in a loop once the socket is readable,
+	// so the listen socket must not block
+	if (enet_socket_set_option(server->listen, ENET_SOCKOPT_NONBLOCK, 1) != 0)
+	{
+		fprintf(stderr, "Failed to make listen socket non-blocking\n");
+		return false;
+	}
+
+#ifdef __linux__
+	server->epoll = epoll_create1(0);
+	if (server->epoll < 0)
+	{
+		fprintf(stderr, "Failed to create epoll instance\n");
+		return false;
+	}
+	struct epoll_event ev;
+	memset(&ev, 0, sizeof ev);
+	ev.events = EPOLLIN;
+	ev.data.fd = server->listen;
+	if (epoll_ctl(server->epoll, EPOLL_CTL_ADD, server->listen, &ev) != 0)
+	{
+		fprintf(stderr, "Failed to watch listen socket\n");
+		return false;
+	}
+	ev.data.fd = server->host->socket;
+	if (epoll_ctl(server->epoll, EPOLL_CTL_ADD, server->host->socket, &ev) != 0)
+	{
+		fprintf(stderr, "Failed to watch host socket\n");
+		return false;
+	}
+#endif
 
 	return true;
 }
 
-void listen_for_clients(ENetLANServer *server)
+// Milliseconds until ENet next needs servicing or held lines are due
+enet_uint32 next_service_timeout(ENetLANServer *server)
 {
-	// Check for data to recv
+	const enet_uint32 now = enet_time_get();
+	enet_uint32 deadline = enet_host_next_deadline(server->host);
+	if (server->pending && ENET_TIME_LESS(server->flushTime, deadline))
+	{
+		deadline = server->flushTime;
+	}
+	return ENET_TIME_LESS_EQUAL(deadline, now) ? 0 : deadline - now;
+}
+
+void wait_for_events(ENetLANServer *server, enet_uint32 timeout)
+{
+#ifdef __linux__
+	// Which socket woke us does not matter; both are drained afterwards
+	struct epoll_event events[2];
+	if (epoll_wait(server->epoll, events, 2, (int)timeout) < 0 &&
+		errno != EINTR)
+	{
+		fprintf(stderr, "Failed to wait for events\n");
+	}
+#else
 	ENetSocketSet set;
 	ENET_SOCKETSET_EMPTY(set);
 	ENET_SOCKETSET_ADD(set, server->listen);
-	if (enet_socketset_select(server->listen, &set, NULL, 0) <= 0)
+	ENET_SOCKETSET_ADD(set, server->host->socket);
+	const ENetSocket maxSocket = server->listen > server->host->socket ?
+		server->listen : server->host->socket;
+	enet_socketset_select(maxSocket, &set, NULL, timeout);
+#endif
+}
+
+// Build the reply sent to scanning clients
+void update_server_info(ENetLANServer *server)
+{
+	memset(&server->info, 0, sizeof server->info);
+	if (enet_address_get_host(&server->host->address, server->info.hostname, sizeof server->info.hostname) != 0 &&
+		enet_address_get_host_ip(&server->host->address, server->info.hostname, sizeof server->info.hostname) != 0)
 	{
-		return;
+		fprintf(stderr, "Failed to get hostname\n");
+	}
+	server->info.port = server->host->address.port;
+	refresh_info = 0;
+	encode_server_info(server);
+}
+
+void encode_server_info(ENetLANServer *server)
+{
+	server->info.clients = (enet_uint16)server->host->connectedPeers;
+	server->info.maxClients = (enet_uint16)server->host->peerCount;
+	server->info.load = (enet_uint8)(server->info.clients * 100 / server->info.maxClients);
+	server->replyLength = server_info_write(&server->info, server->reply, sizeof server->reply);
+}
+
+void listen_for_clients(ENetLANServer *server)
+{
+	if (refresh_info)
+	{
+		update_server_info(server);
 	}
 
 	ENetAddress recvaddr;
@@ -171,36 +373,293 @@ void listen_for_clients(ENetLANServer *server)
 	ENetBuffer recvbuf;
 	recvbuf.data = &buf;
 	recvbuf.dataLength = 1;
-	const int recvlen = enet_socket_receive(server->listen, &recvaddr, &recvbuf, 1);
-	if (recvlen <= 0)
+	ENetBuffer replybuf;
+	replybuf.data = server->reply;
+	replybuf.dataLength = server->replyLength;
+	// Reply to the scans that have arrived; any left over are still
+	// readable and get answered on the next loop
+	for (int i = 0; i < MAX_SCANS_PER_LOOP &&
+		enet_socket_receive(server->listen, &recvaddr, &recvbuf, 1) > 0; i++)
+	{
+		char addrbuf[256];
+		enet_address_get_host_ip(&recvaddr, addrbuf, sizeof addrbuf);
+		printf("Listen port: received (%d) from %s:%d\n",
+			buf, addrbuf, recvaddr.port);
+		// Reply to scanner client with our info
+		if (enet_socket_send(server->listen, &recvaddr, &replybuf, 1) != (int)replybuf.dataLength)
+		{
+			fprintf(stderr, "Failed to reply to scanner\n");
+		}
+	}
+}
+
+void handle_event(ENetLANServer *server, ENetEvent *event)
+{
+	// Whenever a client connects or disconnects, broadcast a message
+	// Whenever a client says something, broadcast it including
+	// which client it was from
+	char buf[256];
+	switch (event->type)
+	{
+		case ENET_EVENT_TYPE_CONNECT:
+			event->peer->data = NULL;
+			encode_server_info(server);
+			// Every client must be in a room to hear anything, including
+			// the notice of its own arrival
+			if (!join_room(server, event->peer, LOBBY))
+			{
+				enet_peer_disconnect(event->peer, 0);
+			}
+			sprintf(buf, "New client connected: id %d", event->peer->incomingPeerID);
+			send_string(server, buf);
+			printf("%s\n", buf);
+			break;
+		case ENET_EVENT_TYPE_RECEIVE:
+			if (event->packet->dataLength > 0 && event->packet->data[0] == '/')
+			{
+				handle_command(server, event->peer, event->packet);
+			}
+			else
+			{
+				send_message(server, event->peer, event->packet);
+			}
+			// Release the receive buffer the message points into
+			enet_packet_destroy(event->packet);
+			break;
+		case ENET_EVENT_TYPE_DISCONNECT:
+			leave_room(event->peer);
+			encode_server_info(server);
+			sprintf(buf, "Client %d disconnected", event->peer->incomingPeerID);
+			send_string(server, buf);
+			printf("%s\n", buf);
+			break;
+		default:
+			break;
+	}
+}
+
+// Move a client into the named room, creating the room if needed
+bool join_room(ENetLANServer *server, ENetPeer *peer, const char *name)
+{
+	Room *room = NULL;
+	Room *freeRoom = NULL;
+	bool created = false;
+	for (int i = 0; i < server->roomCount; i++)
+	{
+		if (server->rooms[i].group == NULL)
+		{
+			if (freeRoom == NULL)
+			{
+				freeRoom = &server->rooms[i];
+			}
+		}
+		else if (strcmp(server->rooms[i].name, name) == 0)
+		{
+			room = &server->rooms[i];
+			break;
+		}
+	}
+	if (room == NULL)
+	{
+		if (freeRoom == NULL && server->roomCount == MAX_ROOMS)
+		{
+			fprintf(stderr, "Too many rooms to create %s\n", name);
+			return false;
+		}
+		room = freeRoom != NULL ? freeRoom : &server->rooms[server->roomCount];
+		room->pending = NULL;
+		room->pendingLength = 0;
+		room->group = enet_group_create(server->host);
+		if (room->group == NULL)
+		{
+			fprintf(stderr, "Failed to create room %s\n", name);
+			return false;
+		}
+		snprintf(room->name, sizeof room->name, "%s", name);
+		if (room == &server->rooms[server->roomCount])
+		{
+			server->roomCount++;
+		}
+		created = true;
+	}
+	if (enet_group_add_peer(room->group, peer) != 0)
+	{
+		fprintf(stderr, "Failed to join room %s\n", name);
+		// Don't leave behind an empty room that nobody will ever leave
+		if (created)
+		{
+			enet_group_destroy(room->group);
+			room->group = NULL;
+			room->name[0] = '\0';
+		}
+		return false;
+	}
+	if (peer->data != NULL && peer->data != room)
+	{
+		// Let the client hear what was said before it left
+		flush_room(peer->data);
+		leave_room(peer);
+	}
+	peer->data = room;
+
+	queue_line(server, room, "Client %d joined %s",
+		peer->incomingPeerID, room->name);
+	printf("Client %d joined %s\n", peer->incomingPeerID, room->name);
+	return true;
+}
+
+void leave_room(ENetPeer *peer)
+{
+	Room *room = peer->data;
+	if (room == NULL)
 	{
 		return;
 	}
-	char addrbuf[256];
-	enet_address_get_host_ip(&recvaddr, addrbuf, sizeof addrbuf);
-	printf("Listen port: received (%d) from %s:%d\n",
-		*(char *)recvbuf.data, addrbuf, recvaddr.port);
-	// Reply to scanner client with our info
-	ServerInfo sinfo;
-	if (enet_address_get_host(&server->host->address, sinfo.hostname, sizeof sinfo.hostname) != 0)
+	enet_group_remove_peer(room->group, peer);
+	peer->data = NULL;
+
+	// Free an empty room so its slot can hold another; the lobby stays so
+	// new clients always have somewhere to go
+	if (room->group->memberCount == 0 && strcmp(room->name, LOBBY) != 0)
+	{
+		flush_room(room);
+		enet_group_destroy(room->group);
+		room->group = NULL;
+		printf("Room %s closed\n", room->name);
+		room->name[0] = '\0';
+	}
+}
+
+void handle_command(ENetLANServer *server, ENetPeer *peer, ENetPacket *packet)
+{
+	// Commands are not null-terminated when they fill the packet
+	char cmd[256];
+	size_t len = packet->dataLength < sizeof cmd - 1 ?
+		packet->dataLength : sizeof cmd - 1;
+	memcpy(cmd, packet->data, len);
+	cmd[len] = '\0';
+
+	char name[ROOM_NAME_SIZE];
+	if (sscanf(cmd, "/join %31s", name) == 1)
+	{
+		if (!join_room(server, peer, name))
+		{
+			send_string_to_peer(peer, "Cannot join that room");
+		}
+	}
+	else
+	{
+		send_string_to_peer(peer, "Unknown command; try /join <room>");
+	}
+}
+
+// Hold a line for a room, to be sent with the others in its window
+void queue_line(ENetLANServer *server, Room *room, const char *fmt, ...)
+{
+	va_list args;
+	va_start(args, fmt);
+	va_list sizeArgs;
+	va_copy(sizeArgs, args);
+	const int len = vsnprintf(NULL, 0, fmt, sizeArgs);
+	va_end(sizeArgs);
+	if (len < 0)
+	{
+		va_end(args);
+		return;
+	}
+	const size_t size = (size_t)len + 1;
+
+	// Start a new packet once the line no longer fits
+	if (room->pending != NULL && room->pendingLength + size > COALESCE_SIZE)
+	{
+		flush_room(room);
+	}
+	if (room->pending == NULL)
+	{
+		room->pending = enet_packet_create(
+			NULL, size > COALESCE_SIZE ? size : COALESCE_SIZE,
+			ENET_PACKET_FLAG_RELIABLE);
+		if (room->pending == NULL)
+		{
+			fprintf(stderr, "Failed to create packet\n");
+			va_end(args);
+			return;
+		}
+		room->pendingLength = 0;
+	}
+	vsnprintf((char *)room->pending->data + room->pendingLength, size, fmt, args);
+	va_end(args);
+	room->pendingLength += size;
+
+	if (!server->pending)
+	{
+		server->pending = true;
+		server->flushTime = enet_time_get() + server->coalesceWindow;
+	}
+}
+
+// Send the lines held for a room as a single packet
+void flush_room(Room *room)
+{
+	if (room->pending == NULL)
 	{
-		fprintf(stderr, "Failed to get hostname\n");
 		return;
 	}
-	sinfo.port = server->host->address.port;
-	recvbuf.data = &sinfo;
-	recvbuf.dataLength = sizeof sinfo;
-	if (enet_socket_send(server->listen, &recvaddr, &recvbuf, 1) != (int)recvbuf.dataLength)
+	room->pending->dataLength = room->pendingLength;
+	enet_group_broadcast(room->group, 0, room->pending);
+	room->pending = NULL;
+	room->pendingLength = 0;
+}
+
+void flush_rooms(ENetLANServer *server)
+{
+	for (int i = 0; i < server->roomCount; i++)
+	{
+		flush_room(&server->rooms[i]);
+	}
+	server->pending = false;
+}
+
+// Every client is in a room, so a line for everyone goes to every room
+void send_string(ENetLANServer *server, char *s)
+{
+	for (int i = 0; i < server->roomCount; i++)
 	{
-		fprintf(stderr, "Failed to reply to scanner\n");
+		if (server->rooms[i].group != NULL)
+		{
+			queue_line(server, &server->rooms[i], "%s", s);
+		}
 	}
 }
 
-void send_string(ENetHost *host, char *s)
+void send_string_to_peer(ENetPeer *peer, char *s)
 {
 	ENetPacket *packet = enet_packet_create(
 		s, strlen(s) + 1, ENET_PACKET_FLAG_RELIABLE);
-	enet_host_broadcast(host, 0, packet);
+	if (packet == NULL)
+	{
+		fprintf(stderr, "Failed to create packet\n");
+		return;
+	}
+	if (enet_peer_send(peer, 0, packet) != 0)
+	{
+		enet_packet_destroy(packet);
+	}
+}
+
+// Relay a client's message to its room, formatting it straight into the
+// packet the room's lines are held in
+void send_message(ENetLANServer *server, ENetPeer *peer, ENetPacket *message)
+{
+	Room *room = peer->data;
+	if (room == NULL)
+	{
+		return;
+	}
+	queue_line(server, room, "Client %d says: %.*s",
+		peer->incomingPeerID, (int)message->dataLength, (char *)message->data);
+	printf("Client %d says: %.*s\n",
+		peer->incomingPeerID, (int)message->dataLength, (char *)message->data);
 }
 
 void stop_server(ENetLANServer *server)
@@ -211,6 +670,15 @@ void stop_server(ENetLANServer *server)
 		fprintf(stderr, "Failed to shutdown listen socket\n");
 	}
 	enet_socket_destroy(server->listen);
+#ifdef __linux__
+	close(server->epoll);
+#endif
+	flush_rooms(server);
+	enet_host_flush(server->host);
+	for (int i = 0; i < server->roomCount; i++)
+	{
+		enet_group_destroy(server->rooms[i].group);
+	}
 	enet_host_destroy(server->host);
 	enet_deinitialize();
 }